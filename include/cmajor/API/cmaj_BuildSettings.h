@@ -43,6 +43,15 @@ struct BuildSettings
     bool         isDebugFlagSet() const                    { return getWithDefault (debugMember, false); }
     bool         shouldUseFastMaths() const                { return getOptimisationLevel() >= 4; }
     std::string  getMainProcessor() const                  { return getWithDefault (mainProcessorMember, ""); }
+    bool         shouldCacheObjectCode() const             { return getWithDefault (cacheObjectCodeMember, false); }
+    uint32_t     getNumInstanceLanes() const               { return getWithRangeCheck (instanceLanesMember, 1u, 256u, 1u); }
+    bool         shouldUseTieredCompilation() const        { return getWithDefault (tieredCompilationMember, false); }
+    uint32_t     getProfileWarmUpFrames() const            { return getWithRangeCheck (profileWarmUpFramesMember, 0u, 0x7fffffffu, 0u); }
+    bool         shouldProfileCompilation() const          { return getWithDefault (profileCompilationMember, false); }
+    std::string  getCompileTraceFile() const               { return getWithDefault (compileTraceFileMember, ""); }
+    bool         shouldCompactAST() const                  { return getWithDefault (compactASTMember, false); }
+    bool         shouldUseSparseStreams() const            { return getWithDefault (sparseStreamsMember, false); }
+    bool         shouldRenderNodesInBlocks() const         { return getWithDefault (renderNodesInBlocksMember, false); }
 
     BuildSettings& setMaxFrequency (double f)              { setProperty (maxFrequencyMember, f); return *this; }
     BuildSettings& setFrequency (double f)                 { setProperty (frequencyMember, f); return *this; }
@@ -55,6 +64,15 @@ struct BuildSettings
     BuildSettings& setSessionID (int32_t id)               { setProperty (sessionIDMember, id); return *this; }
     BuildSettings& setDebugFlag (bool b)                   { setProperty (debugMember, b); return *this; }
     BuildSettings& setMainProcessor (std::string_view s)   { setProperty (mainProcessorMember, s); return *this; }
+    BuildSettings& setCacheObjectCode (bool b)             { setProperty (cacheObjectCodeMember, b); return *this; }
+    BuildSettings& setNumInstanceLanes (uint32_t num)      { setProperty (instanceLanesMember, static_cast<int32_t> (num)); return *this; }
+    BuildSettings& setTieredCompilation (bool b)           { setProperty (tieredCompilationMember, b); return *this; }
+    BuildSettings& setProfileWarmUpFrames (uint32_t num)   { setProperty (profileWarmUpFramesMember, static_cast<int32_t> (num)); return *this; }
+    BuildSettings& setProfileCompilation (bool b)          { setProperty (profileCompilationMember, b); return *this; }
+    BuildSettings& setCompileTraceFile (std::string_view f) { setProperty (compileTraceFileMember, f); return *this; }
+    BuildSettings& setCompactAST (bool b)                  { setProperty (compactASTMember, b); return *this; }
+    BuildSettings& setSparseStreams (bool b)               { setProperty (sparseStreamsMember, b); return *this; }
+    BuildSettings& setRenderNodesInBlocks (bool b)         { setProperty (renderNodesInBlocksMember, b); return *this; }
 
     void reset()                                           { settings = choc::value::Value(); }
 
@@ -105,6 +123,30 @@ struct BuildSettings
         }
     }
 
+    /// Returns a copy without the settings that only affect diagnostics or the compiler's
+    /// internals, so that it can be used as part of a key for caching the generated code.
+    BuildSettings withoutDiagnosticSettings() const
+    {
+        BuildSettings result;
+
+        if (settings.isObject())
+        {
+            for (uint32_t i = 0; i < settings.size(); ++i)
+            {
+                auto member = settings.getObjectMemberAt (i);
+                std::string_view name (member.name);
+
+                if (name != sessionIDMember
+                     && name != profileCompilationMember
+                     && name != compileTraceFileMember
+                     && name != compactASTMember)
+                    result.setProperty (name, member.value);
+            }
+        }
+
+        return result;
+    }
+
     static constexpr double   defaultMaxFrequency    = 192000.0;
     static constexpr uint64_t defaultMaxStateSize    = 20 * 1024 * 1024;
     static constexpr uint64_t defaultMaxStackSize    = 5 * 1024 * 1024;
@@ -127,6 +169,15 @@ private:
     static constexpr auto ignoreWarningsMember     = "ignoreWarnings";
     static constexpr auto debugMember              = "debug";
     static constexpr auto mainProcessorMember      = "mainProcessor";
+    static constexpr auto cacheObjectCodeMember    = "cacheObjectCode";
+    static constexpr auto instanceLanesMember      = "instanceLanes";
+    static constexpr auto tieredCompilationMember  = "tieredCompilation";
+    static constexpr auto profileWarmUpFramesMember = "profileWarmUpFrames";
+    static constexpr auto profileCompilationMember = "profileCompilation";
+    static constexpr auto compileTraceFileMember   = "compileTraceFile";
+    static constexpr auto compactASTMember         = "compactAST";
+    static constexpr auto sparseStreamsMember      = "sparseStreams";
+    static constexpr auto renderNodesInBlocksMember = "renderNodesInBlocks";
 
     template <typename Type>
     Type getWithDefault (std::string_view name, Type defaultValue) const
@@ -98,6 +98,10 @@ struct EndpointID
     static EndpointID create (std::string_view s)       { return create (std::string (s)); }
 
     const std::string& toString() const                 { return ID; }
+
+    /// When a program is built with BuildSettings::setNumInstanceLanes(), each endpoint of the
+    /// main processor is duplicated for each lane, and this returns the ID of a lane's copy.
+    EndpointID getInstanceLaneID (uint32_t lane) const  { return create (ID + "_lane" + std::to_string (lane)); }
     operator const char*() const                        { return ID.c_str(); }
 
     operator bool() const                               { return ! ID.empty(); }
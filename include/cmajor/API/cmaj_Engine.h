@@ -90,10 +90,13 @@ struct Engine
     /// The ExternalVariableProviderFn and ExternalFunctionProviderFn are used to resolve
     /// any external variables or functions that the program may contain. If your program
     /// doesn't have any externals, you can pass null functors for these parameters.
+    /// If you provide a cache, it may be used to store the resolved program, so that
+    /// loading the same code again can skip the parsing and resolution stages.
     bool load (DiagnosticMessageList& messages,
                const Program& programToLoad,
                ExternalVariableProviderFn getExternalVariable,
-               ExternalFunctionProviderFn getExternalFunction);
+               ExternalFunctionProviderFn getExternalFunction,
+               CacheDatabaseInterface* optionalCache = nullptr);
 
     /// Unloads the current program and completely resets the state of the engine.
     void unload();
@@ -226,7 +229,8 @@ inline void Engine::setBuildSettings (const BuildSettings& newSettings)
 
 inline bool Engine::load (DiagnosticMessageList& messages, const Program& programToLoad,
                           ExternalVariableProviderFn getExternalVariable,
-                          ExternalFunctionProviderFn getExternalFunction)
+                          ExternalFunctionProviderFn getExternalFunction,
+                          CacheDatabaseInterface* cache)
 {
     struct ExternalResolver
     {
@@ -307,9 +311,10 @@ inline bool Engine::load (DiagnosticMessageList& messages, const Program& progra
 
     ExternalResolver externalResolver { *engine, std::move (getExternalVariable), std::move (getExternalFunction) };
 
-    if (auto result = choc::com::StringPtr (engine->load (programToLoad.program.get(),
-                                                          std::addressof (externalResolver), ExternalResolver::resolveVariable,
-                                                          std::addressof (externalResolver), ExternalResolver::resolveFunction)))
+    if (auto result = choc::com::StringPtr (engine->loadWithCache (programToLoad.program.get(),
+                                                                   std::addressof (externalResolver), ExternalResolver::resolveVariable,
+                                                                   std::addressof (externalResolver), ExternalResolver::resolveFunction,
+                                                                   cache)))
         return messages.addFromJSONString (result);
 
     return true;
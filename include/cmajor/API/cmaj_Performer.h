@@ -159,6 +159,46 @@ struct Performer
     /// The number of frames rendered will be the number that was last specified by a call to setBlockSize().
     void advance();
 
+    //==============================================================================
+    /// Holds the lists of endpoint I/O that processBlock() should perform. The usual
+    /// pattern is to create one of these when setting up the performer, adding an entry
+    /// for each endpoint with a pointer to the buffer that the host will use for it, and
+    /// then to just update the list of input events before each block.
+    struct BlockIO
+    {
+        std::vector<PerformerInterface::InputStream>   inputStreams;
+        std::vector<PerformerInterface::InputValue>    inputValues;
+        std::vector<PerformerInterface::InputEvent>    inputEvents;
+        std::vector<PerformerInterface::OutputStream>  outputStreams;
+        std::vector<PerformerInterface::OutputValue>   outputValues;
+        std::vector<PerformerInterface::OutputEvents>  outputEvents;
+
+        /// Returns a descriptor which refers to the contents of these lists, so it
+        /// becomes invalid if any of the lists are modified.
+        PerformerInterface::BlockDescriptor getDescriptor (uint32_t numFrames) const;
+    };
+
+    /// Renders a complete block in a single call, performing all of the endpoint
+    /// I/O described by the BlockIO object.
+    /// This is equivalent to calling setBlockSize(), then setting all the inputs, then
+    /// calling advance(), then reading all the outputs, but avoids the overhead of
+    /// making a separate call for each endpoint.
+    /// This function must only be called on the rendering thread.
+    void processBlock (const BlockIO&, uint32_t numFrames);
+
+    /// Renders a complete block in a single call. See PerformerInterface::processBlock()
+    /// for details.
+    void processBlock (const PerformerInterface::BlockDescriptor&);
+
+    /// Returns a JSON array describing the variables in the performer's internal state, or
+    /// a void value if the performer can't provide this. See PerformerInterface::getStateLayout()
+    /// for details of its format.
+    choc::value::Value getStateLayout() const;
+
+    /// Returns the address of the performer's internal state memory, or nullptr if it isn't
+    /// available. See PerformerInterface::getStateMemory().
+    void* getStateMemory() const;
+
     /// Retrieves the string from a handle used in the current program, or an empty string if not found.
     std::string_view getStringForHandle (uint32_t handle) const;
 
@@ -346,6 +386,49 @@ inline void Performer::advance()
     performer->advance();
 }
 
+inline PerformerInterface::BlockDescriptor Performer::BlockIO::getDescriptor (uint32_t numFrames) const
+{
+    return { numFrames,
+             inputStreams.data(),   static_cast<uint32_t> (inputStreams.size()),
+             inputValues.data(),    static_cast<uint32_t> (inputValues.size()),
+             inputEvents.data(),    static_cast<uint32_t> (inputEvents.size()),
+             outputStreams.data(),  static_cast<uint32_t> (outputStreams.size()),
+             outputValues.data(),   static_cast<uint32_t> (outputValues.size()),
+             outputEvents.data(),   static_cast<uint32_t> (outputEvents.size()) };
+}
+
+inline void Performer::processBlock (const BlockIO& io, uint32_t numFrames)
+{
+    performer->processBlock (io.getDescriptor (numFrames));
+}
+
+inline void Performer::processBlock (const PerformerInterface::BlockDescriptor& block)
+{
+    performer->processBlock (block);
+}
+
+inline choc::value::Value Performer::getStateLayout() const
+{
+    if (performer != nullptr)
+    {
+        if (auto layout = choc::com::StringPtr (performer->getStateLayout()))
+        {
+            try
+            {
+                return choc::json::parse (layout);
+            }
+            catch (...) {}
+        }
+    }
+
+    return {};
+}
+
+inline void* Performer::getStateMemory() const
+{
+    return performer != nullptr ? performer->getStateMemory() : nullptr;
+}
+
 inline std::string_view Performer::getStringForHandle (uint32_t handle) const
 {
     size_t length;
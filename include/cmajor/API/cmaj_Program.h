@@ -53,6 +53,18 @@ struct Program
                 const std::string& filename,
                 const std::string& fileContent);
 
+    /// Parses a set of files, supplied as pairs of filename and content. This has the
+    /// same effect as calling parse() for each of them in turn, but is quicker for
+    /// larger numbers of files, as they get parsed in parallel.
+    bool parse (DiagnosticMessageList& messages,
+                const std::vector<std::pair<std::string, std::string>>& filesAndContent);
+
+    /// Parses a set of files from disk. Rather than the caller loading them, the compiler
+    /// reads each file once, directly into memory that the program owns, which avoids
+    /// copying the text again. The files aren't needed after this returns.
+    bool parseFiles (DiagnosticMessageList& messages,
+                     const std::vector<std::string>& filePaths);
+
     /// Returns a JSON version of the current syntax tree.
     std::string getSyntaxTree (const SyntaxTreeOptions&) const;
 
@@ -101,6 +113,48 @@ inline bool Program::parse (DiagnosticMessageList& messages,
     return true;
 }
 
+inline bool Program::parse (DiagnosticMessageList& messages,
+                            const std::vector<std::pair<std::string, std::string>>& filesAndContent)
+{
+    if (program == nullptr)
+    {
+        program = Library::createProgram();
+        library = Library::getSharedLibraryPtr();
+    }
+
+    std::vector<SourceFileToParse> files;
+    files.reserve (filesAndContent.size());
+
+    for (auto& f : filesAndContent)
+        files.push_back ({ f.first.c_str(), f.second.data(), f.second.length() });
+
+    if (auto result = choc::com::StringPtr (program->parseFiles (files.data(), files.size())))
+        return messages.addFromJSONString (result);
+
+    return true;
+}
+
+inline bool Program::parseFiles (DiagnosticMessageList& messages,
+                                 const std::vector<std::string>& filePaths)
+{
+    if (program == nullptr)
+    {
+        program = Library::createProgram();
+        library = Library::getSharedLibraryPtr();
+    }
+
+    std::vector<SourceFileToParse> files;
+    files.reserve (filePaths.size());
+
+    for (auto& path : filePaths)
+        files.push_back ({ path.c_str(), nullptr, 0, true });
+
+    if (auto result = choc::com::StringPtr (program->parseFiles (files.data(), files.size())))
+        return messages.addFromJSONString (result);
+
+    return true;
+}
+
 inline std::string Program::getSyntaxTree (const SyntaxTreeOptions& options) const
 {
     if (program == nullptr)
@@ -69,7 +69,7 @@ struct SourceFile
     CodeLocation getCodeLocation() const         { return { getUTF8() }; }
 
     /// Returns the content of this file as UTF8
-    choc::text::UTF8Pointer getUTF8() const      { return choc::text::UTF8Pointer (content.c_str()); }
+    choc::text::UTF8Pointer getUTF8() const      { return choc::text::UTF8Pointer (content.data()); }
 
     /// Returns true if this file actually contains the given CodeLocation
     bool contains (CodeLocation l) const
@@ -100,8 +100,18 @@ struct SourceFile
     }
 
     SourceFileList& ownerList;
-    std::string filename, content;
+    std::string filename;
+
+    /// The text of the file, which is always followed by a null terminator. This
+    /// points into memory that belongs to some other object (e.g. a string holding the
+    /// text, which may be shared with another list) that is kept alive along with it.
+    std::string_view content;
     bool isSystem = false;
+
+private:
+    friend struct SourceFileList;
+
+    std::shared_ptr<const void> contentOwner;
 };
 
 //==============================================================================
@@ -113,14 +123,37 @@ struct SourceFileList
                      std::string content,
                      bool isSystem)
     {
+        auto contentCopy = std::make_shared<const std::string> (std::move (content));
+        std::string_view text (*contentCopy);
+        return add (std::move (filename), text, std::move (contentCopy), isSystem);
+    }
+
+    /// Adds a file without copying its content, which must be followed by a null
+    /// terminator. The contentOwner object is whatever holds the memory that the
+    /// content points to, and it'll be kept alive for as long as the file is.
+    SourceFile& add (std::string filename,
+                     std::string_view content,
+                     std::shared_ptr<const void> contentOwner,
+                     bool isSystem)
+    {
+        CMAJ_ASSERT (content.data() != nullptr && content.data()[content.length()] == 0);
+
         sourceFiles.push_back (std::make_unique<SourceFile> (*this));
         auto& f = *sourceFiles.back();
         f.filename = std::move (filename);
-        f.content = std::move (content);
+        f.content = content;
+        f.contentOwner = std::move (contentOwner);
         f.isSystem = isSystem;
         return f;
     }
 
+    /// Adds a file which shares the content of a file from another list, so that code
+    /// locations that point into the original will also be found in this list.
+    SourceFile& add (const SourceFile& fileToShare)
+    {
+        return add (fileToShare.filename, fileToShare.content, fileToShare.contentOwner, fileToShare.isSystem);
+    }
+
     /// Adds a file to the list from a JSON container
     void add (const choc::value::ValueView& json)
     {
@@ -150,6 +150,15 @@ struct EngineInterface   : public choc::com::Object
 
     /// Returns a space-separated list of available code-gen targets
     virtual const char* getAvailableCodeGenTargetTypes() = 0;
+
+    //==============================================================================
+    /// Does the same job as load(), but if a non-null CacheDatabaseInterface object is
+    /// supplied, it may be used to save and restore the resolved program, so that loading
+    /// the same code again can skip parsing and resolution.
+    [[nodiscard]] virtual choc::com::String* loadWithCache (ProgramInterface*,
+                                                            void* requestVariableContext, RequestExternalVariableFn,
+                                                            void* requestFunctionContext, RequestExternalFunctionFn,
+                                                            CacheDatabaseInterface*) = 0;
 };
 
 using EnginePtr = choc::com::Ptr<EngineInterface>;
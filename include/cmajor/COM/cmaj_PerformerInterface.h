@@ -143,10 +143,99 @@ struct PerformerInterface   : public choc::com::Object
 
     /// If there has been a runtime error, this returns the message, or nullptr if there isn't one.
     virtual const char* getRuntimeError() = 0;
+
+    //==============================================================================
+    /// These structures are used by processBlock() to describe all the endpoint I/O
+    /// for a block, so that it can be rendered with a single call instead of one call
+    /// per endpoint. The handles must have been obtained by calling getEndpointHandle()
+    /// before the program is linked.
+    struct InputStream    { EndpointHandle handle; const void* frameData; };
+    struct InputValue     { EndpointHandle handle; const void* valueData; uint32_t numFramesToReachValue; };
+    struct InputEvent     { EndpointHandle handle; uint32_t typeIndex; const void* eventData; };
+    struct OutputStream   { EndpointHandle handle; void* dest; };
+    struct OutputValue    { EndpointHandle handle; void* dest; };
+    struct OutputEvents   { EndpointHandle handle; void* context; HandleOutputEventCallback callback; };
+
+    /// Describes a complete block for processBlock(). The arrays and the data they
+    /// point to are owned by the caller, and only need to stay valid for the duration
+    /// of the processBlock() call. A host will typically build one of these once, and
+    /// then just update the frame count and list of input events for each block.
+    struct BlockDescriptor
+    {
+        uint32_t numFrames;
+
+        const InputStream*   inputStreams;    uint32_t numInputStreams;
+        const InputValue*    inputValues;     uint32_t numInputValues;
+        const InputEvent*    inputEvents;     uint32_t numInputEvents;
+        const OutputStream*  outputStreams;   uint32_t numOutputStreams;
+        const OutputValue*   outputValues;    uint32_t numOutputValues;
+        const OutputEvents*  outputEvents;    uint32_t numOutputEvents;
+    };
+
+    /// Renders a complete block in a single call.
+    /// This is equivalent to calling setBlockSize() with the block's frame count, then
+    /// setInputFrames(), setInputValue() and addInputEvent() for each of the inputs in the
+    /// descriptor, then advance(), and then copyOutputFrames(), copyOutputValue() and
+    /// iterateOutputEvents() for each of the outputs.
+    /// Each of the input streams must provide exactly numFrames frames of data, and the
+    /// output stream destinations must have space for numFrames frames.
+    /// The performers that an Engine creates will render a block which is bigger than
+    /// getMaximumBlockSize() as a series of smaller ones, applying the input values and
+    /// events before the first, reading the output values after the last, and giving the
+    /// output events frame offsets relative to the start of the whole block. Other
+    /// implementations, such as processBlockUsingIndividualCalls(), may require numFrames
+    /// to be no more than getMaximumBlockSize().
+    /// This function must only be called on the rendering thread.
+    virtual void processBlock (const BlockDescriptor&) = 0;
+
+    //==============================================================================
+    /// Returns a JSON array describing the variables that make up the performer's internal
+    /// state, or nullptr if the performer can't provide this information.
+    /// Each element is an object with the properties "name", "type", "offset" and "size",
+    /// where the offset and size are in bytes, relative to the address returned by
+    /// getStateMemory(). Two variables will have the same "type" string if their data has
+    /// an identical memory layout.
+    /// This lets a host carry the state of a running performer over into a new build of
+    /// the same program, for any variables which weren't changed.
+    virtual choc::com::String* getStateLayout() = 0;
+
+    /// Returns the address of the performer's internal state, whose contents are
+    /// described by getStateLayout(), or nullptr if it isn't available.
+    /// The state must only be modified on the rendering thread, between calls to advance().
+    virtual void* getStateMemory() = 0;
 };
 
 using PerformerPtr = choc::com::Ptr<PerformerInterface>;
 
+/// Implements PerformerInterface::processBlock() by making the equivalent sequence of
+/// individual calls on the performer. This is handy for performer implementations which
+/// have no faster way of doing it. The block must be no bigger than the performer's
+/// maximum block size.
+inline void processBlockUsingIndividualCalls (PerformerInterface& performer, const PerformerInterface::BlockDescriptor& block)
+{
+    performer.setBlockSize (block.numFrames);
+
+    for (uint32_t i = 0; i < block.numInputStreams; ++i)
+        performer.setInputFrames (block.inputStreams[i].handle, block.inputStreams[i].frameData, block.numFrames);
+
+    for (uint32_t i = 0; i < block.numInputValues; ++i)
+        performer.setInputValue (block.inputValues[i].handle, block.inputValues[i].valueData, block.inputValues[i].numFramesToReachValue);
+
+    for (uint32_t i = 0; i < block.numInputEvents; ++i)
+        performer.addInputEvent (block.inputEvents[i].handle, block.inputEvents[i].typeIndex, block.inputEvents[i].eventData);
+
+    performer.advance();
+
+    for (uint32_t i = 0; i < block.numOutputStreams; ++i)
+        performer.copyOutputFrames (block.outputStreams[i].handle, block.outputStreams[i].dest, block.numFrames);
+
+    for (uint32_t i = 0; i < block.numOutputValues; ++i)
+        performer.copyOutputValue (block.outputValues[i].handle, block.outputValues[i].dest);
+
+    for (uint32_t i = 0; i < block.numOutputEvents; ++i)
+        performer.iterateOutputEvents (block.outputEvents[i].handle, block.outputEvents[i].context, block.outputEvents[i].callback);
+}
+
 } // namespace cmaj
 
 #ifdef __clang__
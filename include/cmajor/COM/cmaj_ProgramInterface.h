@@ -42,6 +42,21 @@ struct SyntaxTreeOptions
     bool includeFunctionContents   = false;
 };
 
+/// Describes one of the files passed to ProgramInterface::parseFiles(). This was
+/// added along with parseFiles() in the V10 entry point, so its layout is part of
+/// that version of the interface.
+struct SourceFileToParse
+{
+    const char* filename = nullptr;
+    const char* content = nullptr;
+    size_t contentSize = 0;
+
+    /// If this is true, the content is ignored, and the filename is used as the path
+    /// of a file which the compiler will load and parse. The file is read once, directly
+    /// into memory that the program owns, so it isn't needed after parseFiles() returns.
+    bool loadFromFile = false;
+};
+
 //==============================================================================
 /**
     The basic COM API class for a program.
@@ -65,6 +80,12 @@ struct ProgramInterface  : public choc::com::Object
 
     /// Returns a JSON version of the current syntax tree.
     [[nodiscard]] virtual choc::com::String* getSyntaxTree (const SyntaxTreeOptions&) = 0;
+
+    /// Parses a set of files, which may be done in parallel, and adds them to the
+    /// program in the order given. Returns either a nullptr or a JSON-encoded error in
+    /// the same format as parse().
+    [[nodiscard]] virtual choc::com::String* parseFiles (const SourceFileToParse* files,
+                                                         size_t numFiles) = 0;
 };
 
 using ProgramPtr = choc::com::Ptr<ProgramInterface>;
@@ -18,124 +18,409 @@
 
 #pragma once
 
+#include <shared_mutex>
+#include <limits>
+#include <fstream>
 #include "../../choc/threading/choc_ThreadSafeFunctor.h"
+#include "../../choc/threading/choc_TaskThread.h"
+#include "../../choc/text/choc_Files.h"
 #include "../COM/cmaj_CacheDatabaseInterface.h"
 
 namespace cmaj
 {
 
 //==============================================================================
-/// A simple implementation of CacheDatabaseInterface that saves the data as
-/// files in a given folder, and deletes the oldest files when a maximum
-/// number exist
+/// An implementation of CacheDatabaseInterface that saves the data as files in a
+/// given folder, and deletes the least-recently-used files when their total size
+/// or number goes over a limit.
+///
+/// The keys are split across a set of shards, each with its own reader/writer lock,
+/// so many engines can store and reload items at the same time. The index of items,
+/// their sizes and usage order is kept in memory and saved to a single index file,
+/// so that lookups don't need to touch the filesystem.
+///
+/// Because CacheDatabaseInterface::reload() copies the data into the caller's
+/// buffer, each item is read straight into that buffer with a single read.
 struct FileBasedCacheDatabase   : public choc::com::ObjectWithAtomicRefCount<CacheDatabaseInterface, FileBasedCacheDatabase>
 {
-    FileBasedCacheDatabase (std::filesystem::path parentFolder, size_t maxNumFilesAllowed)
-       : folder (std::move (parentFolder)), maxNumFiles (maxNumFilesAllowed)
+    struct Limits
     {
-        purgeThread.start (0, [this] { removeOldFiles(); });
+        uint64_t maxTotalSizeInBytes = 512 * 1024 * 1024;
+        uint32_t numShards = 16;
+        /// If this is non-zero, the least-recently-used files are also deleted when there are more than this
+        size_t maxNumFiles = 0;
+    };
+
+    FileBasedCacheDatabase (std::filesystem::path parentFolder, Limits);
+
+    /// Creates a cache which only limits the number of files, and not their total size.
+    FileBasedCacheDatabase (std::filesystem::path parentFolder, size_t maxNumFilesAllowed);
+    virtual ~FileBasedCacheDatabase();
+
+    void store (const char* key, const void* dataToSave, uint64_t dataSize) override;
+    uint64_t reload (const char* key, void* destAddress, uint64_t destSize) override;
+
+    /// Returns the total size of all the items that are currently stored.
+    uint64_t getTotalSize() const       { return totalSize.load(); }
+
+    /// Writes the index of items to its file. This happens automatically after files
+    /// have been purged and when the object is deleted.
+    void saveIndex();
+
+private:
+    //==============================================================================
+    struct Entry
+    {
+        uint64_t size = 0;
+        std::atomic<uint64_t> lastAccess { 0 };
+    };
+
+    struct Shard
+    {
+        std::shared_mutex lock;
+        std::unordered_map<std::string, Entry> entries;
+    };
+
+    std::filesystem::path folder;
+    Limits limits;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<uint64_t> totalSize { 0 }, numEntries { 0 }, accessCounter { 1 }, nextTempFileID { 0 };
+    std::mutex indexFileLock;
+    choc::threading::TaskThread purgeThread;
+
+    static std::string getFileNamePrefix()      { return "cmajor_cache_"; }
+    static std::string getIndexFileName()       { return "cmajor_cacheindex"; }
+
+    std::filesystem::path getCacheFile (std::string_view key) const    { return folder / (getFileNamePrefix() + std::string (key)); }
+    Shard& getShard (std::string_view key)                             { return *shards[std::hash<std::string_view>() (key) % shards.size()]; }
+
+    bool isOverLimits() const;
+    static Limits createFileCountLimits (size_t maxNumFiles);
+    void updateEntry (std::string_view key, uint64_t size, uint64_t lastAccess);
+    void removeEntry (std::string_view key);
+    void loadIndex();
+    void scanFolder();
+    void removeOldFiles();
+    static uint64_t readFile (const std::filesystem::path&, void* destAddress, uint64_t destSize);
+};
+
+
+
+//==============================================================================
+//        _        _           _  _
+//     __| |  ___ | |_   __ _ (_)| | ___
+//    / _` | / _ \| __| / _` || || |/ __|
+//   | (_| ||  __/| |_ | (_| || || |\__ \ _  _  _
+//    \__,_| \___| \__| \__,_||_||_||___/(_)(_)(_)
+//
+//   Code beyond this point is implementation detail...
+//
+//==============================================================================
+
+inline FileBasedCacheDatabase::FileBasedCacheDatabase (std::filesystem::path parentFolder, Limits l)
+   : folder (std::move (parentFolder)), limits (l)
+{
+    for (uint32_t i = 0; i < std::max (1u, limits.numShards); ++i)
+        shards.push_back (std::make_unique<Shard>());
+
+    try
+    {
+        if (std::filesystem::exists (folder / getIndexFileName()))
+            loadIndex();
+        else
+            scanFolder();
     }
+    catch (...) {}
+
+    purgeThread.start (0, [this] { removeOldFiles(); });
 
-    virtual ~FileBasedCacheDatabase() = default;
+    if (isOverLimits())
+        purgeThread.trigger();
+}
+
+inline FileBasedCacheDatabase::FileBasedCacheDatabase (std::filesystem::path parentFolder, size_t maxNumFilesAllowed)
+   : FileBasedCacheDatabase (std::move (parentFolder), createFileCountLimits (maxNumFilesAllowed))
+{
+}
+
+inline FileBasedCacheDatabase::Limits FileBasedCacheDatabase::createFileCountLimits (size_t maxNumFiles)
+{
+    Limits l;
+    l.maxTotalSizeInBytes = std::numeric_limits<uint64_t>::max();
+    l.maxNumFiles = std::max (static_cast<size_t> (1), maxNumFiles);
+    return l;
+}
+
+inline bool FileBasedCacheDatabase::isOverLimits() const
+{
+    return totalSize > limits.maxTotalSizeInBytes
+            || (limits.maxNumFiles != 0 && numEntries > limits.maxNumFiles);
+}
 
-    void store (const char* key, const void* dataToSave, uint64_t dataSize) override
+inline FileBasedCacheDatabase::~FileBasedCacheDatabase()
+{
+    purgeThread.stop();
+    saveIndex();
+}
+
+inline void FileBasedCacheDatabase::store (const char* key, const void* dataToSave, uint64_t dataSize)
+{
+    // The data is written to a temporary file which then replaces the real one, so that
+    // any readers which are part-way through reading the old version aren't affected
+    auto file = getCacheFile (key);
+    auto tempFile = file;
+    tempFile += "_" + std::to_string (nextTempFileID++) + ".tmp";
+
+    try
     {
-        try
+        choc::file::replaceFileWithContent (tempFile.string(),
+                                            std::string_view (static_cast<const char*> (dataToSave),
+                                                              static_cast<std::string_view::size_type> (dataSize)));
+        std::error_code error;
+
         {
-            std::lock_guard<decltype(lock)> l (lock);
-            choc::file::replaceFileWithContent (getCacheFile (key).string(),
-                                                std::string_view (static_cast<const char*> (dataToSave),
-                                                                  static_cast<std::string_view::size_type> (dataSize)));
+            auto& shard = getShard (key);
+            std::unique_lock<std::shared_mutex> l (shard.lock);
+            std::filesystem::rename (tempFile, file, error);
+
+            // On Windows, this fails if another process has the old file open. It's then
+            // left in place, and as its entry hasn't changed, the index still matches it.
+            if (! error)
+                updateEntry (key, dataSize, accessCounter++);
         }
-        catch (...) {}
 
-        purgeThread.trigger();
+        if (error)
+            std::filesystem::remove (tempFile, error);
     }
+    catch (...)
+    {
+        std::error_code error;
+        std::filesystem::remove (tempFile, error);
+    }
+
+    if (isOverLimits())
+        purgeThread.trigger();
+}
 
-    uint64_t reload (const char* key, void* destAddress, uint64_t destSize) override
+inline uint64_t FileBasedCacheDatabase::reload (const char* key, void* destAddress, uint64_t destSize)
+{
+    try
     {
-        std::lock_guard<decltype(lock)> l (lock);
+        auto& shard = getShard (key);
+        bool isInIndex = false;
 
-        try
         {
-            auto file = getCacheFile (key);
-            auto size = file_size (file);
+            std::shared_lock<std::shared_mutex> l (shard.lock);
 
-            if (size == 0)
-                return 0;
+            if (auto found = shard.entries.find (key); found != shard.entries.end())
+            {
+                // A caller will often just want the size first, which the index can provide
+                if (destAddress == nullptr || destSize < found->second.size)
+                    return found->second.size;
 
-            if (destAddress == nullptr || destSize < size)
-                return size;
+                found->second.lastAccess = accessCounter++;
+                isInIndex = true;
+            }
+        }
 
-            std::fstream stream (file);
-            stream.read (static_cast<char*> (destAddress), static_cast<std::streamsize> (size));
+        // The file is read outside the lock: if it gets replaced or purged in the meantime,
+        // the old version remains readable until we're finished with it
+        auto size = readFile (getCacheFile (key), destAddress, destSize);
 
-            if (stream.gcount() != static_cast<std::streamsize> (size))
-                return 0;
+        if (size == 0 && isInIndex)
+        {
+            std::unique_lock<std::shared_mutex> l (shard.lock);
+            removeEntry (key);
+        }
+        else if (size != 0 && ! isInIndex)
+        {
+            // Another process sharing this folder may have added the file
+            std::unique_lock<std::shared_mutex> l (shard.lock);
+            updateEntry (key, size, accessCounter++);
+        }
 
-            // write a byte at the end and then erase it to update the file's modification time
-            stream.put (0);
-            stream.sync();
-            resize_file (file, size);
+        return size;
+    }
+    catch (...) {}
 
-            return size;
-        }
-        catch (...) {}
+    return 0;
+}
 
+inline uint64_t FileBasedCacheDatabase::readFile (const std::filesystem::path& file, void* destAddress, uint64_t destSize)
+{
+    std::ifstream stream (file, std::ios::binary | std::ios::ate);
+
+    if (! stream)
         return 0;
+
+    auto size = static_cast<uint64_t> (stream.tellg());
+
+    if (destAddress == nullptr || destSize < size || size == 0)
+        return size;
+
+    stream.seekg (0);
+    stream.read (static_cast<char*> (destAddress), static_cast<std::streamsize> (size));
+
+    return stream.gcount() == static_cast<std::streamsize> (size) ? size : 0;
+}
+
+inline void FileBasedCacheDatabase::updateEntry (std::string_view key, uint64_t size, uint64_t lastAccess)
+{
+    auto [found, isNew] = getShard (key).entries.try_emplace (std::string (key));
+    auto& entry = found->second;
+
+    if (isNew)
+        ++numEntries;
+
+    totalSize += size;
+    totalSize -= entry.size;
+    entry.size = size;
+    entry.lastAccess = lastAccess;
+}
+
+inline void FileBasedCacheDatabase::removeEntry (std::string_view key)
+{
+    auto& entries = getShard (key).entries;
+
+    if (auto found = entries.find (std::string (key)); found != entries.end())
+    {
+        totalSize -= found->second.size;
+        --numEntries;
+        entries.erase (found);
     }
+}
 
-private:
-    std::filesystem::path folder;
-    size_t maxNumFiles = 0;
-    std::mutex lock;
-    choc::threading::TaskThread purgeThread;
+inline void FileBasedCacheDatabase::saveIndex()
+{
+    std::string content;
 
-    static std::string getFileNamePrefix()   { return "cmajor_cache_"; }
+    for (auto& shard : shards)
+    {
+        std::shared_lock<std::shared_mutex> l (shard->lock);
 
-    std::filesystem::path getCacheFile (const std::string& key)    { return folder / (getFileNamePrefix() + key); }
+        for (auto& e : shard->entries)
+            content += std::to_string (e.second.size) + " " + std::to_string (e.second.lastAccess.load()) + " " + e.first + "\n";
+    }
 
-    void removeOldFiles()
+    std::lock_guard<std::mutex> l (indexFileLock);
+    auto tempFile = folder / (getIndexFileName() + ".tmp");
+    std::error_code error;
+
+    try
+    {
+        choc::file::replaceFileWithContent (tempFile.string(), content);
+        std::filesystem::rename (tempFile, folder / getIndexFileName(), error);
+    }
+    catch (...)
     {
-        std::lock_guard<decltype(lock)> l (lock);
+        error = std::make_error_code (std::errc::io_error);
+    }
 
-        struct File
-        {
-            std::filesystem::path file;
-            std::filesystem::file_time_type time;
+    if (error)
+        std::filesystem::remove (tempFile, error);
+}
 
-            bool operator< (const File& other) const     { return time < other.time; }
-        };
+inline void FileBasedCacheDatabase::loadIndex()
+{
+    std::ifstream stream (folder / getIndexFileName());
+    uint64_t size, lastAccess;
+    std::string key;
 
-        std::vector<File> files;
+    while (stream >> size >> lastAccess && std::getline (stream >> std::ws, key))
+    {
+        auto& shard = getShard (key);
+        std::unique_lock<std::shared_mutex> l (shard.lock);
+        updateEntry (key, size, lastAccess);
 
-        for (auto& f : std::filesystem::directory_iterator { folder })
+        if (lastAccess >= accessCounter)
+            accessCounter = lastAccess + 1;
+    }
+}
+
+inline void FileBasedCacheDatabase::scanFolder()
+{
+    // Without an index, the files' modification times are used to give them an initial order
+    struct File
+    {
+        std::string key;
+        uint64_t size;
+        std::filesystem::file_time_type time;
+
+        bool operator< (const File& other) const     { return time < other.time; }
+    };
+
+    std::vector<File> files;
+    auto prefix = getFileNamePrefix();
+
+    for (auto& f : std::filesystem::directory_iterator { folder })
+    {
+        auto name = f.path().filename().string();
+
+        if (choc::text::startsWith (name, prefix) && ! choc::text::endsWith (name, ".tmp"))
         {
-            if (choc::text::startsWith (f.path().stem().string(), getFileNamePrefix()))
+            try
             {
-                try
-                {
-                    auto time = last_write_time (f.path());
-                    files.push_back ({ f.path(), time });
-                }
-                catch (...) {}
+                files.push_back ({ name.substr (prefix.length()), f.file_size(), f.last_write_time() });
             }
+            catch (...) {}
         }
+    }
+
+    std::sort (files.begin(), files.end());
+
+    for (auto& f : files)
+    {
+        auto& shard = getShard (f.key);
+        std::unique_lock<std::shared_mutex> l (shard.lock);
+        updateEntry (f.key, f.size, accessCounter++);
+    }
+}
+
+inline void FileBasedCacheDatabase::removeOldFiles()
+{
+    struct Item
+    {
+        std::string key;
+        uint64_t size, lastAccess;
 
-        std::sort (files.begin(), files.end());
+        bool operator< (const Item& other) const     { return lastAccess < other.lastAccess; }
+    };
 
-        if (files.size() > maxNumFiles)
+    std::vector<Item> items;
+
+    for (auto& shard : shards)
+    {
+        std::shared_lock<std::shared_mutex> l (shard->lock);
+
+        for (auto& e : shard->entries)
+            items.push_back ({ e.first, e.second.size, e.second.lastAccess.load() });
+    }
+
+    std::sort (items.begin(), items.end());
+
+    for (auto& item : items)
+    {
+        if (! isOverLimits())
+            break;
+
+        auto& shard = getShard (item.key);
+        std::unique_lock<std::shared_mutex> l (shard.lock);
+
+        // Skip anything that has been used or replaced since the list was made
+        if (auto found = shard.entries.find (item.key);
+            found != shard.entries.end() && found->second.lastAccess == item.lastAccess)
         {
-            for (size_t i = 0; i < files.size() - maxNumFiles; ++i)
-            {
-                try
-                {
-                    remove (files[i].file);
-                }
-                catch (...) {}
-            }
+            // On Windows, a file can't be deleted while another process has it open. The
+            // entry is then kept, so that the size and LRU order still account for it.
+            std::error_code error;
+            std::filesystem::remove (getCacheFile (item.key), error);
+
+            if (! error)
+                removeEntry (item.key);
         }
     }
-};
+
+    saveIndex();
+}
 
 } // namespace cmaj
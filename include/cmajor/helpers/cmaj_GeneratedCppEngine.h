@@ -80,6 +80,10 @@ struct GeneratedCppEngine  : public choc::com::ObjectWithAtomicRefCount<EngineIn
     choc::com::String* load (ProgramInterface*,
                              void*, EngineInterface::RequestExternalVariableFn,
                              void*, EngineInterface::RequestExternalFunctionFn) override   { loaded = true; linked = false; return {}; }
+    choc::com::String* loadWithCache (ProgramInterface*,
+                                      void*, EngineInterface::RequestExternalVariableFn,
+                                      void*, EngineInterface::RequestExternalFunctionFn,
+                                      CacheDatabaseInterface*) override                    { loaded = true; linked = false; return {}; }
     choc::com::String* link (CacheDatabaseInterface*) override                             { loaded = linked = true; return {}; }
     choc::com::String* getLastBuildLog() override                                          { return {}; }
 
@@ -198,6 +202,15 @@ private:
             }
         }
 
+        void processBlock (const BlockDescriptor& block) override
+        {
+            processBlockUsingIndividualCalls (*this, block);
+        }
+
+        // The generated class doesn't expose its state layout
+        choc::com::String* getStateLayout() override    { return {}; }
+        void* getStateMemory() override                 { return {}; }
+
         const char* getStringForHandle (uint32_t handle, size_t& stringLength) override
         {
             return generatedObject.getStringForHandle (handle, stringLength);
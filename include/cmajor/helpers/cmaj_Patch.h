@@ -20,11 +20,13 @@
 
 #include "cmaj_PatchHelpers.h"
 #include "cmaj_AudioMIDIPerformer.h"
+#include "cmaj_PerformerStateTransfer.h"
 
 #include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <chrono>
+#include <thread>
 
 namespace cmaj
 {
@@ -68,6 +70,14 @@ struct Patch
     /// or playback parameters change.
     void rebuild();
 
+    /// When enabled, if a rebuild produces a patch with the same endpoints as the one
+    /// that is playing, it replaces it without stopping playback. The new version takes
+    /// over at the start of the next block, and any state variables whose names and types
+    /// are unchanged are carried over to it, so that live code edits don't cause a glitch.
+    /// Engines which can't provide their state layout will still be swapped, but will
+    /// start from their initial state.
+    void setHotSwapEnabled (bool);
+
     /// Unloads any currently loaded patch
     void unload();
 
@@ -317,8 +327,18 @@ private:
     std::unique_ptr<BuildThread> buildThread;
     std::atomic<uint16_t> nextViewID { 0 };
 
+    // The audio thread only uses audioThreadRenderer, which it switches to the pending
+    // renderer at the start of a block when a hot-swap happens. Until the message thread
+    // knows that the swap has been made, the old one is kept alive in previousRenderer.
+    bool hotSwapEnabled = false;
+    std::shared_ptr<PatchRenderer> previousRenderer;
+    std::atomic<PatchRenderer*> audioThreadRenderer { nullptr }, pendingRenderer { nullptr };
+
     void sendPatchChange();
     void setNewRenderer (std::shared_ptr<PatchRenderer>);
+    bool hotSwapRenderer (std::shared_ptr<PatchRenderer>&);
+    void releaseAudioThreadRenderer();
+    void sendBuildStatus();
     void sendOutputEventToViews (uint64_t frame, std::string_view endpointID, const choc::value::ValueView&);
     PatchView* findViewForID (uint16_t) const;
     void startCheckingForChanges();
@@ -1040,6 +1060,31 @@ struct Patch::PatchRenderer  : public std::enable_shared_from_this<PatchRenderer
         return true;
     }
 
+    //==============================================================================
+    /// Returns true if this renderer can take over from another one without the host
+    /// needing to stop playback, which means that its endpoints must be unchanged.
+    bool canReplace (const PatchRenderer& current) const
+    {
+        auto getSignature = [] (const EndpointDetailsList& endpoints)
+        {
+            return choc::json::toString (endpoints.toJSON (false));
+        };
+
+        return isPlayable() && current.isPlayable()
+                && manifest.ID == current.manifest.ID
+                && sampleRate == current.sampleRate
+                && framesLatency == current.framesLatency
+                && getSignature (inputEndpoints) == getSignature (current.inputEndpoints)
+                && getSignature (outputEndpoints) == getSignature (current.outputEndpoints);
+    }
+
+    /// Works out which state variables can be carried over from the renderer that this one
+    /// is replacing. The copying itself is done by the audio thread when the swap happens.
+    void prepareToReplace (PatchRenderer& current)
+    {
+        stateTransfer = PerformerStateTransfer (current.getPerformer().performer, getPerformer().performer);
+    }
+
     //==============================================================================
     struct DataListener  : public AudioMIDIPerformer::AudioDataListener
     {
@@ -1107,7 +1152,7 @@ struct Patch::PatchRenderer  : public std::enable_shared_from_this<PatchRenderer
         {
             manifest = std::move (loadParams.manifest);
 
-            if (! loadProgram (engine, playbackParams, shouldResolveExternals, checkForStopSignal))
+            if (! loadProgram (engine, playbackParams, shouldResolveExternals, c.get(), checkForStopSignal))
                 return;
 
             if (! shouldResolveExternals)
@@ -1148,20 +1193,35 @@ struct Patch::PatchRenderer  : public std::enable_shared_from_this<PatchRenderer
     bool loadProgram (cmaj::Engine& engine,
                       const PlaybackParams& playbackParams,
                       bool shouldResolveExternals,
+                      cmaj::CacheDatabaseInterface* cache,
                       const std::function<void()>& checkForStopSignal)
     {
         cmaj::Program program;
 
-        if (manifest.needsToBuildSource)
+        if (manifest.needsToBuildSource && manifest.usesFileSystem)
+        {
+            // The compiler can read files on disk itself, straight into memory that the program owns
+            std::vector<std::string> paths;
+
+            for (auto& file : manifest.sourceFiles)
+                paths.push_back (manifest.getFullPathForFile (file));
+
+            checkForStopSignal();
+
+            if (! program.parseFiles (errors, paths))
+                return false;
+        }
+        else if (manifest.needsToBuildSource)
         {
+            std::vector<std::pair<std::string, std::string>> filesAndContent;
+
             for (auto& file : manifest.sourceFiles)
             {
                 checkForStopSignal();
 
                 if (auto content = manifest.readFileContent (file))
                 {
-                    if (! program.parse (errors, manifest.getFullPathForFile (file), std::move (*content)))
-                        return false;
+                    filesAndContent.push_back ({ manifest.getFullPathForFile (file), std::move (*content) });
                 }
                 else
                 {
@@ -1169,6 +1229,11 @@ struct Patch::PatchRenderer  : public std::enable_shared_from_this<PatchRenderer
                     return false;
                 }
             }
+
+            checkForStopSignal();
+
+            if (! program.parse (errors, filesAndContent))
+                return false;
         }
 
         engine.setBuildSettings (engine.getBuildSettings()
@@ -1181,7 +1246,7 @@ struct Patch::PatchRenderer  : public std::enable_shared_from_this<PatchRenderer
         if (engine.load (errors, program,
                          shouldResolveExternals ? manifest.createExternalResolverFunction()
                                                 : [] (const cmaj::ExternalVariable&) -> choc::value::Value { return {}; },
-                         {}))
+                         {}, cache))
         {
             programDetails = engine.getProgramDetails();
             inputEndpoints = engine.getInputEndpoints();
@@ -1607,6 +1672,7 @@ struct Patch::PatchRenderer  : public std::enable_shared_from_this<PatchRenderer
     bool hasMIDIInputs = false;
     bool hasMIDIOutputs = false;
     bool hasTimecodeInputs = false;
+    PerformerStateTransfer stateTransfer;
 
     std::unique_ptr<PatchWorker> patchWorker;
 
@@ -1987,6 +2053,11 @@ inline Engine::CodeGenOutput Patch::generateCode (const LoadParams& params, cons
     return engine.generateCode (target, options);
 }
 
+inline void Patch::setHotSwapEnabled (bool shouldHotSwap)
+{
+    hotSwapEnabled = shouldHotSwap;
+}
+
 inline void Patch::unload()
 {
     clientEventQueue->stop();
@@ -1996,6 +2067,7 @@ inline void Patch::unload()
         if (stopPlayback)
             stopPlayback();
 
+        releaseAudioThreadRenderer();
         renderer.reset();
         sendPatchChange();
         setStatus ({});
@@ -2204,8 +2276,8 @@ inline void Patch::addMIDIMessage (int frameIndex, const void* data, uint32_t le
         midiMessages.push_back (message);
         midiMessageTimes.push_back (frameIndex);
 
-        if (renderer != nullptr)
-            renderer->processMIDIMessage (message);
+        if (auto r = audioThreadRenderer.load())
+            r->processMIDIMessage (message);
     }
 }
 
@@ -2213,7 +2285,7 @@ inline void Patch::process (float* const* audioChannels, uint32_t numFrames,
                             const choc::audio::AudioMIDIBlockDispatcher::HandleMIDIMessageFn& handleMIDIOut)
 {
     beginChunkedProcess();
-    renderer->getPerformer().processWithTimeStampedMIDI (choc::buffer::createChannelArrayView (audioChannels, currentPlaybackParams.numInputChannels, numFrames),
+    audioThreadRenderer.load()->getPerformer().processWithTimeStampedMIDI (choc::buffer::createChannelArrayView (audioChannels, currentPlaybackParams.numInputChannels, numFrames),
                                                          choc::buffer::createChannelArrayView (audioChannels, currentPlaybackParams.numOutputChannels, numFrames),
                                                          midiMessages.data(), midiMessageTimes.data(), static_cast<uint32_t> (midiMessages.size()),
                                                          handleMIDIOut, true);
@@ -2231,21 +2303,29 @@ inline void Patch::process (const choc::audio::AudioMIDIBlockDispatcher::Block&
 
 inline void Patch::beginChunkedProcess()
 {
+    // If a hot-swap is waiting, this block boundary is where the new renderer takes over
+    if (auto newRenderer = pendingRenderer.exchange (nullptr))
+    {
+        newRenderer->stateTransfer.apply();
+        audioThreadRenderer = newRenderer;
+    }
+
     clientEventQueue->startOfProcessCallback();
-    renderer->beginProcessBlock();
+    audioThreadRenderer.load()->beginProcessBlock();
 }
 
 inline void Patch::processChunk (const choc::audio::AudioMIDIBlockDispatcher::Block& block, bool replaceOutput)
 {
-    renderer->getPerformer().process (block, replaceOutput);
+    auto r = audioThreadRenderer.load();
+    r->getPerformer().process (block, replaceOutput);
     clientEventQueue->postProcessChunk (block);
-    renderer->processMIDIBlock (block);
+    r->processMIDIBlock (block);
 }
 
 inline void Patch::endChunkedProcess()
 {
     clientEventQueue->endOfProcessCallback();
-    renderer->endProcessBlock();
+    audioThreadRenderer.load()->endProcessBlock();
 }
 
 inline void Patch::failedToPushToPatch()
@@ -2256,22 +2336,26 @@ inline void Patch::failedToPushToPatch()
 
 inline void Patch::sendTimeSig (int numerator, int denominator, uint32_t timeoutMilliseconds)
 {
-    renderer->sendTimeSig (numerator, denominator, timeoutMilliseconds);
+    if (auto r = audioThreadRenderer.load())
+        r->sendTimeSig (numerator, denominator, timeoutMilliseconds);
 }
 
 inline void Patch::sendBPM (float bpm, uint32_t timeoutMilliseconds)
 {
-    renderer->sendBPM (bpm, timeoutMilliseconds);
+    if (auto r = audioThreadRenderer.load())
+        r->sendBPM (bpm, timeoutMilliseconds);
 }
 
 inline void Patch::sendTransportState (bool isRecording, bool isPlaying, bool isLooping, uint32_t timeoutMilliseconds)
 {
-    renderer->sendTransportState (isRecording, isPlaying, isLooping, timeoutMilliseconds);
+    if (auto r = audioThreadRenderer.load())
+        r->sendTransportState (isRecording, isPlaying, isLooping, timeoutMilliseconds);
 }
 
 inline void Patch::sendPosition (int64_t currentFrame, double ppq, double ppqBar, uint32_t timeoutMilliseconds)
 {
-    renderer->sendPosition (currentFrame, ppq, ppqBar, timeoutMilliseconds);
+    if (auto r = audioThreadRenderer.load())
+        r->sendPosition (currentFrame, ppq, ppqBar, timeoutMilliseconds);
 }
 
 inline void Patch::sendMessageToView (PatchView& view, std::string_view type, const choc::value::ValueView& message) const
@@ -2443,9 +2527,13 @@ inline void Patch::setNewRenderer (std::shared_ptr<PatchRenderer> newRenderer)
     if (renderer == nullptr && newRenderer == nullptr)
         return;
 
+    if (hotSwapRenderer (newRenderer))
+        return;
+
     if (stopPlayback)
         stopPlayback();
 
+    releaseAudioThreadRenderer();
     fileChangeChecker.reset();
     renderer.reset();
     sendPatchChange();
@@ -2459,6 +2547,7 @@ inline void Patch::setNewRenderer (std::shared_ptr<PatchRenderer> newRenderer)
         {
             clientEventQueue->prepare (renderer->sampleRate);
             renderer->startPatchWorker();
+            audioThreadRenderer = renderer.get();
 
             if (startPlayback)
                 startPlayback();
@@ -2467,21 +2556,74 @@ inline void Patch::setNewRenderer (std::shared_ptr<PatchRenderer> newRenderer)
                 renderer->startInfiniteLoopCheck (handleInfiniteLoop);
         }
 
-        if (statusChanged)
-        {
-            Status s;
+        sendBuildStatus();
+    }
 
-            if (renderer->errors.hasErrors())
-                s.statusMessage = renderer->errors.toString();
-            else
-                s.statusMessage = getName().empty() ? std::string() : "Loaded: " + getName();
+    startCheckingForChanges();
+}
 
-            s.messageList = renderer->errors;
-            statusChanged (s);
-        }
+inline bool Patch::hotSwapRenderer (std::shared_ptr<PatchRenderer>& newRenderer)
+{
+    if (! hotSwapEnabled || renderer == nullptr || newRenderer == nullptr
+         || audioThreadRenderer == nullptr || ! newRenderer->canReplace (*renderer))
+        return false;
+
+    // Before starting a new swap, we need to be sure that the audio thread is
+    // using the current renderer, and nothing else
+    if (pendingRenderer.exchange (nullptr) != nullptr)
+    {
+        // The last swap never happened, so the previous renderer is still the one playing
+        renderer = std::move (previousRenderer);
+    }
+    else
+    {
+        // The audio thread may have only just picked up the last swap, so might
+        // still be copying the state out of the previous renderer
+        while (audioThreadRenderer.load() != renderer.get())
+            std::this_thread::yield();
     }
 
+    previousRenderer.reset();
+
+    newRenderer->prepareToReplace (*renderer);
+    newRenderer->startPatchWorker();
+
+    if (handleInfiniteLoop)
+        newRenderer->startInfiniteLoopCheck (handleInfiniteLoop);
+
+    fileChangeChecker.reset();
+    previousRenderer = std::move (renderer);
+    renderer = std::move (newRenderer);
+    pendingRenderer = renderer.get();
+
+    sendPatchChange();
+    sendBuildStatus();
     startCheckingForChanges();
+    return true;
+}
+
+inline void Patch::releaseAudioThreadRenderer()
+{
+    // Must only be called while the audio thread is stopped
+    pendingRenderer = nullptr;
+    audioThreadRenderer = nullptr;
+    previousRenderer.reset();
+}
+
+inline void Patch::sendBuildStatus()
+{
+    if (statusChanged)
+    {
+        Status s;
+
+        if (renderer->errors.hasErrors())
+            s.statusMessage = renderer->errors.toString();
+        else
+            s.statusMessage = getName().empty() ? std::string() : "Loaded: " + getName();
+
+        s.messageList = renderer->errors;
+        statusChanged (s);
+    }
 }
 
 inline void Patch::addActiveView (PatchView& v)
@@ -131,6 +131,9 @@ struct PatchManifest
     /// This attempts to find the last modification time of a file within the patch
     /// If that's not possible, it returns an empty time object.
     std::function<std::filesystem::file_time_type(const std::string&)> getFileModificationTime;
+    /// This is true if the functors read from the real filesystem, so that the paths
+    /// returned by getFullPathForFile() can be opened directly.
+    bool usesFileSystem = false;
 
     /// Represents one of the GUI views in the patch
     struct View
@@ -372,6 +375,7 @@ inline void PatchManifest::initialiseWithVirtualFile (std::string patchFileLocat
     getFullPathForFile = std::move (getFullPathForFileFn);
     getFileModificationTime = std::move (getFileModificationTimeFn);
     fileExists = std::move (fileExistsFn);
+    usesFileSystem = false;
     CHOC_ASSERT (createFileReader && getFullPathForFile && getFileModificationTime && fileExists);
 
     manifestFile = std::move (patchFileLocation);
@@ -419,6 +423,7 @@ inline void PatchManifest::createFileReaderFunctions (const std::filesystem::pat
     };
 
     fileExists = [getFullPath] (const std::string& f) { return exists (getFullPath (f)); };
+    usesFileSystem = true;
 }
 
 inline void PatchManifest::initialiseWithFile (std::filesystem::path file)
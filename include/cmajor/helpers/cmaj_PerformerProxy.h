@@ -38,6 +38,9 @@ struct PerformerProxy  : public PerformerInterface
     void copyOutputFrames (EndpointHandle e, void* dest, uint32_t num) override                     { target->copyOutputFrames (e, dest, num); }
     void iterateOutputEvents (EndpointHandle e, void* c, HandleOutputEventCallback h) override      { return target->iterateOutputEvents (e, c, h); }
     void advance() override                                                                         { target->advance(); }
+    void processBlock (const BlockDescriptor& block) override                                       { target->processBlock (block); }
+    choc::com::String* getStateLayout() override                                                    { return target->getStateLayout(); }
+    void* getStateMemory() override                                                                 { return target->getStateMemory(); }
     const char* getStringForHandle (uint32_t h, size_t& len) override                               { return target->getStringForHandle (h, len); }
     uint32_t getXRuns() override                                                                    { return target->getXRuns(); }
     uint32_t getMaximumBlockSize() override                                                         { return target->getMaximumBlockSize(); }
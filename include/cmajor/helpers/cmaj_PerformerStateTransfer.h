@@ -0,0 +1,148 @@
+//
+//     ,ad888ba,                              88
+//    d8"'    "8b
+//   d8            88,dba,,adba,   ,aPP8A.A8  88     The Cmajor Toolkit
+//   Y8,           88    88    88  88     88  88
+//    Y8a.   .a8P  88    88    88  88,   ,88  88     (C)2024 Cmajor Software Ltd
+//     '"Y888Y"'   88    88    88  '"8bbP"Y8  88     https://cmajor.dev
+//                                           ,88
+//                                        888P"
+//
+//  The Cmajor project is subject to commercial or open-source licensing.
+//  You may use it under the terms of the GPLv3 (see www.gnu.org/licenses), or
+//  visit https://cmajor.dev to learn about our commercial licence options.
+//
+//  CMAJOR IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+//  EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+//  DISCLAIMED.
+
+#pragma once
+
+#include <cstring>
+#include <unordered_map>
+#include "../API/cmaj_Performer.h"
+
+namespace cmaj
+{
+
+//==============================================================================
+/**
+    Copies the state of a running performer into a performer for a newly-built
+    version of the same program, so that a live code edit doesn't reset everything.
+
+    Creating one of these does all the work of matching up the variables that the two
+    programs have in common (i.e. ones whose names and types are unchanged), so it
+    should be done on a non-realtime thread. Calling apply() then just performs a few
+    memcpys, so can be done on the audio thread between two blocks, just before the
+    new performer starts rendering.
+
+    Both performers must stay alive for as long as this object may be applied.
+*/
+struct PerformerStateTransfer
+{
+    PerformerStateTransfer() = default;
+    PerformerStateTransfer (const Performer& source, const Performer& dest);
+
+    /// Returns true if there's nothing to copy, which will be the case if the
+    /// performers share no variables, or if either of them can't provide its layout.
+    bool isEmpty() const                { return chunks.empty(); }
+
+    /// Returns the number of state variables that will be copied.
+    uint32_t getNumVariables() const    { return numVariables; }
+
+    /// Copies the matching variables from the source to the destination performer.
+    /// This doesn't allocate or lock, and must only be called on the rendering thread.
+    void apply() const;
+
+private:
+    struct Chunk
+    {
+        const uint8_t* source;
+        uint8_t* dest;
+        size_t size;
+    };
+
+    std::vector<Chunk> chunks;
+    uint32_t numVariables = 0;
+};
+
+
+
+//==============================================================================
+//        _        _           _  _
+//     __| |  ___ | |_   __ _ (_)| | ___
+//    / _` | / _ \| __| / _` || || |/ __|
+//   | (_| ||  __/| |_ | (_| || || |\__ \ _  _  _
+//    \__,_| \___| \__| \__,_||_||_||___/(_)(_)(_)
+//
+//   Code beyond this point is implementation detail...
+//
+//==============================================================================
+
+inline PerformerStateTransfer::PerformerStateTransfer (const Performer& source, const Performer& dest)
+{
+    auto sourceMemory = static_cast<const uint8_t*> (source.getStateMemory());
+    auto destMemory = static_cast<uint8_t*> (dest.getStateMemory());
+
+    if (sourceMemory == nullptr || destMemory == nullptr)
+        return;
+
+    auto sourceLayout = source.getStateLayout();
+    auto destLayout = dest.getStateLayout();
+
+    if (! (sourceLayout.isArray() && destLayout.isArray()))
+        return;
+
+    struct Variable
+    {
+        std::string type;
+        size_t offset, size;
+    };
+
+    std::unordered_map<std::string, Variable> sourceVariables;
+
+    for (auto v : sourceLayout)
+        sourceVariables[v["name"].toString()] = { v["type"].toString(),
+                                                  static_cast<size_t> (v["offset"].getWithDefault<int64_t> (0)),
+                                                  static_cast<size_t> (v["size"].getWithDefault<int64_t> (0)) };
+
+    for (auto v : destLayout)
+    {
+        auto found = sourceVariables.find (v["name"].toString());
+
+        if (found == sourceVariables.end())
+            continue;
+
+        auto& sourceVariable = found->second;
+        auto size = static_cast<size_t> (v["size"].getWithDefault<int64_t> (0));
+
+        if (sourceVariable.type != v["type"].toString() || sourceVariable.size != size || size == 0)
+            continue;
+
+        auto sourceAddress = sourceMemory + sourceVariable.offset;
+        auto destAddress = destMemory + static_cast<size_t> (v["offset"].getWithDefault<int64_t> (0));
+        ++numVariables;
+
+        // When a run of variables is laid out identically in both programs, a single copy will do
+        if (! chunks.empty())
+        {
+            auto& last = chunks.back();
+
+            if (last.source + last.size == sourceAddress && last.dest + last.size == destAddress)
+            {
+                last.size += size;
+                continue;
+            }
+        }
+
+        chunks.push_back ({ sourceAddress, destAddress, size });
+    }
+}
+
+inline void PerformerStateTransfer::apply() const
+{
+    for (auto& chunk : chunks)
+        std::memcpy (chunk.dest, chunk.source, chunk.size);
+}
+
+} // namespace cmaj
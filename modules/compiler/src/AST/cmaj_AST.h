@@ -18,6 +18,10 @@
 
 #pragma once
 
+#include <atomic>
+#include <charconv>
+#include <cerrno>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 #include <sstream>
@@ -266,6 +270,15 @@ template <> inline const AST::Object* castObject <const AST::Object, const AST::
 template <> inline const AST::Object* castObject <const AST::Object, AST::Object>       (const AST::Object& o)   { return std::addressof (o); }
 template <> inline const AST::Object* castObject <const AST::Object, AST::Object>       (AST::Object& o)         { return std::addressof (o); }
 
+//==============================================================================
+inline bool AST::Function::isIdleFunction() const
+{
+    if (auto a = castTo<Annotation> (annotation))
+        return a->getBoolFlag ("idleCheck");
+
+    return false;
+}
+
 //==============================================================================
 template <typename ObjectOrContext>
 inline DiagnosticMessage DiagnosticMessage::withContext (const ObjectOrContext& c) const
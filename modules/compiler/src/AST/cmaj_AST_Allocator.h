@@ -35,7 +35,18 @@ struct Allocator
     }
 
     template <typename Type, typename... Args>
-    Type& allocate (Args&&... args)   { return pool.allocate<Type> (std::forward<Args> (args)...); }
+    Type& allocate (Args&&... args)
+    {
+        ++numObjectsAllocated;
+        auto& o = pool.allocate<Type> (std::forward<Args> (args)...);
+
+        if constexpr (std::is_base_of_v<Object, Type>)
+            addObjectTypeAllocation (getObjectTypeIndex<Type>(), o, sizeof (Type));
+        else
+            numOtherBytesAllocated += sizeof (Type);
+
+        return o;
+    }
 
     ObjectContext getContext (CodeLocation location, ptr<Object> parentScope)      { return { *this, location, parentScope }; }
     ObjectContext getContextWithoutLocation (ptr<Object> parentScope)              { return getContext ({}, parentScope); }
@@ -118,8 +129,22 @@ struct Allocator
         return ns;
     }
 
+    /// The number and size of the objects of one AST class that have been allocated
+    struct ObjectTypeAllocations
+    {
+        std::string_view objectType;
+        size_t objectSize = 0, numAllocated = 0;
+    };
+
     choc::memory::Pool pool;
     SourceFileList sourceFileList;
+    size_t numObjectsAllocated = 0;
+
+    // These must be declared before the primitive types below, which are allocated
+    // by the constructor. Anything that isn't an AST object (e.g. the properties in
+    // lists) just gets added to numOtherBytesAllocated.
+    std::vector<ObjectTypeAllocations> objectTypeAllocations;
+    size_t numOtherBytesAllocated = 0;
 
     Strings strings { pool };
 
@@ -137,6 +162,35 @@ struct Allocator
 
     uint16_t nextVisitorNumber = 0;
     uint32_t visitorStackDepth = 0;
+
+    // incremented whenever a string property changes, so that any cached name lookups can tell
+    // when an object that they refer to may have been renamed
+    uint64_t stringChangeCount = 0;
+
+private:
+    // Each class gets an index into objectTypeAllocations, shared by all allocators
+    static inline std::atomic<size_t> nextObjectTypeIndex { 0 };
+
+    template <typename Type>
+    static size_t getObjectTypeIndex()
+    {
+        static const size_t index = nextObjectTypeIndex++;
+        return index;
+    }
+
+    void addObjectTypeAllocation (size_t typeIndex, const Object& o, size_t size)
+    {
+        if (typeIndex >= objectTypeAllocations.size())
+            objectTypeAllocations.resize (typeIndex + 1);
+
+        auto& allocations = objectTypeAllocations[typeIndex];
+
+        if (allocations.numAllocated++ == 0)
+        {
+            allocations.objectType = o.getObjectType();
+            allocations.objectSize = size;
+        }
+    }
 };
 
 static Allocator& getAllocator (Object&);
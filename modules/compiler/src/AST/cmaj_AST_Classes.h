@@ -185,6 +185,7 @@ struct Function  : public Object
     bool isSystemAdvanceFunction() const            { return name == getStrings().systemAdvanceFunctionName; }
     bool isUserInitFunction() const                 { return name == getStrings().userInitFunctionName; }
     bool isResetFunction() const                    { return name == getStrings().resetFunctionName && getNumNonInternalParameters() == 0; }
+    bool isIdleFunction() const;
     bool isExportedFunction() const                 { return isExported || isEventHandler || isSystemInitFunction() || isSystemAdvanceFunction() || isMainFunction() || isUserInitFunction(); }
     bool isGenericOrParameterised() const override  { return ! genericWildcards.empty(); }
     bool isSpecialisedGeneric() const               { return originalGenericFunction != nullptr; }
@@ -340,6 +341,10 @@ struct Function  : public Object
 
     // non-persistent scratch variables to help with some algorithms
     void* tempStorage = nullptr;
+
+    // set for functions from the pre-resolved standard library image, which the resolution
+    // passes can skip until the program starts being transformed for code-gen
+    bool isPreResolved = false;
 };
 
 //==============================================================================
@@ -45,6 +45,14 @@ struct ModuleBase  : public Object
 
     bool isGenericOrParameterised() const override                { return ! specialisationParams.empty(); }
 
+    void objectPropertyChanged() override
+    {
+        // An item in one of the lists may have been replaced, so their name indexes can't be trusted
+        for (auto p : getPropertyList())
+            if (auto list = p->getAsListProperty())
+                list->invalidateNameIndex();
+    }
+
     bool isAnyParentParameterised() const
     {
         if (isGenericOrParameterised())
@@ -77,14 +85,23 @@ struct ModuleBase  : public Object
 
     ptr<Function> findFunction (PooledString functionName, size_t numParameters) const
     {
-        for (auto& f : functions)
-            if (auto o = f->getObject().get())
-                if (o->hasName (functionName))
-                    if (auto fn = o->getAsFunction())
-                        if (fn->parameters.size() == numParameters)
-                            return *fn;
+        ptr<Function> result;
 
-        return {};
+        functions.findObjectsWithName (functionName, [&] (Object& o)
+        {
+            if (auto fn = o.getAsFunction())
+            {
+                if (fn->parameters.size() == numParameters)
+                {
+                    result = *fn;
+                    return false;
+                }
+            }
+
+            return true;
+        });
+
+        return result;
     }
 
     ptr<Function> findFunction (std::string_view functionName, size_t numParameters) const
@@ -173,21 +190,20 @@ struct ModuleBase  : public Object
 
         if (search.findNamespaces || search.findProcessors || search.findTypes)
         {
-            for (auto& a : aliases)
+            aliases.findObjectsWithName (targetName, [&] (Object& o)
             {
-                if (a->hasName (targetName))
+                auto& alias = castToRef<Alias> (o);
+                auto aliasType = alias.aliasType.get();
+
+                if ((search.findNamespaces     && aliasType == AliasTypeEnum::Enum::namespaceAlias)
+                     || (search.findProcessors && aliasType == AliasTypeEnum::Enum::processorAlias)
+                     || (search.findTypes      && aliasType == AliasTypeEnum::Enum::typeAlias))
                 {
-                    auto& alias = castToRef<Alias> (a);
-                    auto aliasType = alias.aliasType.get();
-
-                    if ((search.findNamespaces     && aliasType == AliasTypeEnum::Enum::namespaceAlias)
-                         || (search.findProcessors && aliasType == AliasTypeEnum::Enum::processorAlias)
-                         || (search.findTypes      && aliasType == AliasTypeEnum::Enum::typeAlias))
-                    {
-                        search.addResult (alias);
-                    }
+                    search.addResult (alias);
                 }
-            }
+
+                return true;
+            });
         }
 
         if (search.findVariables)
@@ -195,13 +211,18 @@ struct ModuleBase  : public Object
                 search.addResult (*v);
 
         if (search.findFunctions)
-            for (auto& f : functions) // don't call findFunction here, as we want to find multiple fns
-                if (auto o = f->getObject())
-                    if (o->hasName (targetName))
-                        if (auto fn = o->getAsFunction())
-                            if (search.requiredNumFunctionParams < 0
-                                 || fn->parameters.size() == static_cast<uint32_t> (search.requiredNumFunctionParams))
-                                search.addResult (*fn);
+        {
+            // don't call findFunction here, as we want to find multiple fns
+            functions.findObjectsWithName (targetName, [&] (Object& o)
+            {
+                if (auto fn = o.getAsFunction())
+                    if (search.requiredNumFunctionParams < 0
+                         || fn->parameters.size() == static_cast<uint32_t> (search.requiredNumFunctionParams))
+                        search.addResult (*fn);
+
+                return true;
+            });
+        }
     }
 
     void visitObjectsInScope (ObjectVisitor visit) override
@@ -243,6 +264,7 @@ struct ProcessorBase  : public ModuleBase
     ptr<Function> findSystemInitFunction() const              { return findFunction ([] (const Function& f) { return f.isSystemInitFunction(); }); }
     ptr<Function> findSystemAdvanceFunction() const           { return findFunction ([] (const Function& f) { return f.isSystemAdvanceFunction(); }); }
     ptr<Function> findResetFunction() const                   { return findFunction ([] (const Function& f) { return f.isResetFunction(); }); }
+    ptr<Function> findIsIdleFunction() const                  { return findFunction ([] (const Function& f) { return f.isIdleFunction(); }); }
 
     ptr<VariableDeclaration> findVariable (PooledString variableName) override
     {
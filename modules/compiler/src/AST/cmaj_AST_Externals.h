@@ -62,6 +62,36 @@ struct ExternalVariableManager
         return false;
     }
 
+    bool isEmpty() const        { return externals.empty(); }
+
+    /// Adds the names and current values of all the externals to a hash, so that
+    /// code which has these values baked into it can be cached correctly.
+    void addToHash (choc::hash::xxHash64& hash) const
+    {
+        struct HashOutput
+        {
+            void write (const void* data, size_t size)    { hash.addInput (data, size); }
+            choc::hash::xxHash64& hash;
+        };
+
+        HashOutput output { hash };
+        std::vector<const decltype (externals)::value_type*> sortedExternals;
+
+        for (auto& e : externals)
+            sortedExternals.push_back (std::addressof (e));
+
+        std::sort (sortedExternals.begin(), sortedExternals.end(),
+                   [] (auto a, auto b) { return a->first < b->first; });
+
+        for (auto e : sortedExternals)
+        {
+            hash.addInput (e->first);
+
+            if (e->second.has_value())
+                e->second->serialise (output);
+        }
+    }
+
 private:
     std::unordered_map<std::string, std::optional<choc::value::Value>> externals;
 
@@ -381,6 +411,48 @@ struct ExternalFunctionManager
         return {};
     }
 
+    bool isEmpty() const        { return functionPointers.empty(); }
+
+    /// Copies another manager's functions, for a program whose AST was cloned from the
+    /// other one's. Returns false if any of the functions weren't cloned.
+    bool copyFrom (const ExternalFunctionManager& source, const RemappedObjects& clonedObjects)
+    {
+        requestExternalFunction = source.requestExternalFunction;
+        context = source.context;
+        functionPointers.clear();
+
+        for (auto& f : source.functionPointers)
+        {
+            auto clone = clonedObjects.find (f.first);
+
+            if (clone == clonedObjects.end())
+                return false;
+
+            functionPointers[clone->second->getAsFunction()] = f.second;
+        }
+
+        return true;
+    }
+
+    /// Adds the names and addresses of the resolved functions to a hash. Because the
+    /// addresses are only meaningful in this process, this mustn't be used for anything
+    /// that gets persisted.
+    void addToHash (choc::hash::xxHash64& hash) const
+    {
+        std::vector<std::pair<std::string, void*>> functions;
+
+        for (auto& f : functionPointers)
+            functions.push_back ({ f.first->getFullyQualifiedReadableName(), f.second });
+
+        std::sort (functions.begin(), functions.end());
+
+        for (auto& f : functions)
+        {
+            hash.addInput (f.first);
+            hash.addInput (std::addressof (f.second), sizeof (f.second));
+        }
+    }
+
 private:
     std::unordered_map<const Function*, void*> functionPointers;
     EngineInterface::RequestExternalFunctionFn requestExternalFunction = nullptr;
@@ -124,6 +124,7 @@ struct Object
     virtual uint8_t getPropertyID (uint32_t) const                      { CMAJ_ASSERT_FALSE; return 0; }
     virtual Property* findPropertyForID (uint32_t)                      { CMAJ_ASSERT_FALSE; return {}; }
     virtual bool canConstantFoldProperty (const Property&)              { return true; }
+    virtual void objectPropertyChanged()                                { }
     virtual bool isDummyStatement() const                               { return false; }
     virtual ptr<const Comment> getComment() const                       { return {}; }
     virtual bool isIdentical (const Object&) const = 0;
@@ -436,6 +437,7 @@ private:
     //==============================================================================
     friend struct ObjectProperty;
     friend struct ChildObject;
+    friend struct Program;
 
     Object& createDeepClone (Allocator& newContext, RemappedObjects& objectMap) const
     {
@@ -17,6 +17,190 @@
 //  DISCLAIMED.
 
 
+//==============================================================================
+/// Keeps count of the work done by the resolution passes, so that it can be
+/// added to the build log
+struct ResolutionStatistics
+{
+    struct PassCounts
+    {
+        std::string_view name;
+        size_t numRuns = 0, numModulesVisited = 0, numObjectsVisited = 0, numChanges = 0;
+    };
+
+    std::vector<PassCounts> passes;
+    size_t numRounds = 0, numModulesVisited = 0, numModulesSkipped = 0;
+
+    void reset()
+    {
+        passes.clear();
+        numRounds = numModulesVisited = numModulesSkipped = 0;
+    }
+
+    PassCounts& getPass (std::string_view name)
+    {
+        for (auto& p : passes)
+            if (p.name == name)
+                return p;
+
+        passes.push_back ({ name });
+        return passes.back();
+    }
+
+    std::string getSummary() const
+    {
+        if (numRounds == 0)
+            return {};
+
+        std::string result = "Resolution: " + std::to_string (numRounds) + " rounds, "
+                               + std::to_string (numModulesVisited) + " module visits, "
+                               + std::to_string (numModulesSkipped) + " skipped";
+
+        for (auto& p : passes)
+            result += "\n  " + std::string (p.name) + ": " + std::to_string (p.numRuns) + " runs, "
+                        + std::to_string (p.numModulesVisited) + " modules, "
+                        + std::to_string (p.numObjectsVisited) + " objects visited, "
+                        + std::to_string (p.numChanges) + " changes";
+
+        return result;
+    }
+};
+
+//==============================================================================
+/// Records how long each pass, transformation and code-generation stage of a build
+/// takes, and how many AST objects it allocates. Stages can be nested, and the
+/// results are available as a JSON summary or as a Chrome trace.
+struct CompileProfile
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Stage
+    {
+        std::string_view category, name;
+        Clock::time_point start;
+        Clock::duration duration {};
+        size_t numAllocations = 0;
+        uint32_t depth = 0;
+    };
+
+    std::vector<Stage> stages;
+
+    void reset()
+    {
+        stages.clear();
+        currentDepth = 0;
+    }
+
+    struct Timer
+    {
+        Timer (CompileProfile& p, size_t index, const Allocator& a)
+            : profile (p), stageIndex (index), allocator (a), allocationsAtStart (a.numObjectsAllocated)
+        {}
+
+        ~Timer()
+        {
+            auto& stage = profile.stages[stageIndex];
+            stage.duration = Clock::now() - stage.start;
+            stage.numAllocations = allocator.numObjectsAllocated - allocationsAtStart;
+            --profile.currentDepth;
+        }
+
+        CompileProfile& profile;
+        size_t stageIndex;
+        const Allocator& allocator;
+        size_t allocationsAtStart;
+    };
+
+    /// The category and name must be string literals. The stage ends when the
+    /// returned object is deleted.
+    [[nodiscard]] Timer measure (std::string_view category, std::string_view name, const Allocator& allocator)
+    {
+        stages.push_back ({ category, name, Clock::now(), {}, 0, currentDepth++ });
+        return Timer (*this, stages.size() - 1, allocator);
+    }
+
+    /// Returns the total and self times for each distinct stage, where the self time
+    /// excludes any stages that were nested inside it.
+    choc::value::Value getSummary() const
+    {
+        struct Totals
+        {
+            std::string_view category, name;
+            size_t numRuns = 0, numAllocations = 0;
+            Clock::duration total {}, self {};
+        };
+
+        std::vector<Totals> totals;
+
+        for (size_t i = 0; i < stages.size(); ++i)
+        {
+            auto& stage = stages[i];
+            auto self = stage.duration;
+
+            for (size_t j = i + 1; j < stages.size() && stages[j].depth > stage.depth; ++j)
+                if (stages[j].depth == stage.depth + 1)
+                    self -= stages[j].duration;
+
+            auto found = std::find_if (totals.begin(), totals.end(),
+                                       [&] (const Totals& t) { return t.category == stage.category && t.name == stage.name; });
+
+            if (found == totals.end())
+                found = totals.insert (totals.end(), { stage.category, stage.name });
+
+            ++found->numRuns;
+            found->numAllocations += stage.numAllocations;
+            found->total += stage.duration;
+            found->self += self;
+        }
+
+        auto toMilliseconds = [] (Clock::duration d)  { return std::chrono::duration<double, std::milli> (d).count(); };
+        auto result = choc::value::createEmptyArray();
+
+        for (auto& t : totals)
+            result.addArrayElement (choc::value::createObject ("Stage",
+                                                               "category", std::string (t.category),
+                                                               "name", std::string (t.name),
+                                                               "runs", static_cast<int64_t> (t.numRuns),
+                                                               "totalMilliseconds", toMilliseconds (t.total),
+                                                               "selfMilliseconds", toMilliseconds (t.self),
+                                                               "allocations", static_cast<int64_t> (t.numAllocations)));
+
+        return result;
+    }
+
+    /// Returns the stages in the Trace Event format, which can be loaded into
+    /// chrome://tracing or Perfetto.
+    std::string toChromeTrace() const
+    {
+        auto events = choc::value::createEmptyArray();
+
+        if (! stages.empty())
+        {
+            auto startTime = stages.front().start;
+            auto toMicroseconds = [] (Clock::duration d)  { return std::chrono::duration<double, std::micro> (d).count(); };
+
+            for (auto& stage : stages)
+                events.addArrayElement (choc::value::createObject ({},
+                                                                   "name", std::string (stage.name),
+                                                                   "cat", std::string (stage.category),
+                                                                   "ph", "X",
+                                                                   "ts", toMicroseconds (stage.start - startTime),
+                                                                   "dur", toMicroseconds (stage.duration),
+                                                                   "pid", 1,
+                                                                   "tid", 1,
+                                                                   "args", choc::value::createObject ({}, "allocations", static_cast<int64_t> (stage.numAllocations))));
+        }
+
+        return choc::json::toString (choc::value::createObject ({},
+                                                                "traceEvents", events,
+                                                                "displayTimeUnit", "ms"));
+    }
+
+private:
+    uint32_t currentDepth = 0;
+};
+
+//==============================================================================
 struct Program  : public choc::com::ObjectWithAtomicRefCount<cmaj::ProgramInterface, Program>
 {
     Program (bool parseComments = false)
@@ -34,15 +218,22 @@ struct Program  : public choc::com::ObjectWithAtomicRefCount<cmaj::ProgramInterf
     {
         return catchAllErrorsAsJSON (false, [&]
         {
-            auto& code = allocator.sourceFileList.add (filename != nullptr ? std::string (filename) : std::string(),
-                                                       fileContent != nullptr && fileContentSize != 0 ? std::string (fileContent, fileContentSize) : std::string(),
-                                                       false);
+            auto& code = addSourceFile ({ filename, fileContent, fileContentSize });
             parse (code, false);
             codeHash.addInput (code.content);
 
         });
     }
 
+    choc::com::String* parseFiles (const SourceFileToParse* files, size_t numFiles) override
+    {
+        return catchAllErrorsAsJSON (false, [&]
+        {
+            for (auto f : parseSourceFiles (files, numFiles))
+                codeHash.addInput (f->content);
+        });
+    }
+
     /// Adds the standard library, and if the program has already been loaded and is
     /// mashed-up, reparses it from the original source files
     bool prepareForLoading()
@@ -56,6 +247,10 @@ struct Program  : public choc::com::ObjectWithAtomicRefCount<cmaj::ProgramInterf
         return true;
     }
 
+    /// Called when the program's modules have been replaced by something other than the
+    /// result of parsing its source files, e.g. a resolved version loaded from a cache
+    void markAsNeedingReparsing()           { needsReparsing = true; }
+
     auto getTopLevelModules() const         { return rootNamespace.getSubModules(); }
 
     std::vector<ref<AST::ProcessorBase>> getAllProcessors() const
@@ -151,6 +346,19 @@ struct Program  : public choc::com::ObjectWithAtomicRefCount<cmaj::ProgramInterf
         return choc::com::createRawString (choc::json::toString (mod->toSyntaxTree (opts), true));
     }
 
+    /// Returns the number and size of the AST objects of each class that this program's
+    /// allocator has created, along with how many of them can still be reached from the
+    /// root namespace. Everything else is dead, but stays in the allocator's pool until
+    /// the program is deleted.
+    choc::value::Value getMemoryUsage() const;
+
+    /// Creates a copy of this program in a new allocator, containing only the objects that
+    /// can be reached from the root namespace, so that the memory used by all the dead ones
+    /// can be freed by deleting this program. The copy shares this program's source files.
+    /// This must only be called between transformations, and it returns nullptr if any part
+    /// of the AST refers to an object that the copy can't include.
+    choc::com::Ptr<Program> createCompactedCopy() const;
+
     bool reparse()
     {
         needsReparsing = false;
@@ -162,8 +370,12 @@ struct Program  : public choc::com::ObjectWithAtomicRefCount<cmaj::ProgramInterf
 
         cmaj::catchAllErrors (messageList, [&]
         {
+            std::vector<const SourceFile*> sourceFiles;
+
             for (auto& sourceFile : allocator.sourceFileList.sourceFiles)
-                parse (*sourceFile, false);
+                sourceFiles.push_back (sourceFile.get());
+
+            parse (sourceFiles);
         });
 
         return ! messageList.hasErrors();
@@ -236,12 +448,37 @@ struct Program  : public choc::com::ObjectWithAtomicRefCount<cmaj::ProgramInterf
     bool parsingComments;
     AST::ExternalVariableManager externalVariableManager;
     AST::ExternalFunctionManager externalFunctionManager;
+    ResolutionStatistics resolutionStatistics;
+
+    /// This is mutable so that the code generators, which only get a const program,
+    /// can add their own stages to it.
+    mutable CompileProfile compileProfile;
+
+    /// True while the standard library functions that were marked as pre-resolved when it
+    /// was added can be skipped by the resolution passes. This gets cleared when the program
+    /// starts being transformed for code-gen, because that can modify any function.
+    bool canSkipPreResolvedFunctions = false;
 
 
 private:
     mutable ptr<AST::ProcessorBase> mainProcessor;
     bool needsReparsing = false;
 
+    /// Parses a set of files, in parallel if there's more than one, and adds their
+    /// modules to the program in the order given.
+    void parse (const std::vector<const SourceFile*>&);
+
+    /// Copies the modules that were parsed into another allocator into this program,
+    /// including everything they refer to, so that the other allocator can be deleted.
+    void copyParsedModules (const Namespace& parsedRootNamespace, const Allocator& parsedAllocator);
+
+    /// Adds a file to the source file list, copying its content.
+    const SourceFile& addSourceFile (const SourceFileToParse&);
+
+    /// Adds and parses the files passed to parseFiles(). Any that are loaded from disk
+    /// are read into memory which the source file list owns.
+    std::vector<const SourceFile*> parseSourceFiles (const SourceFileToParse*, size_t numFiles);
+
     void addStandardLibraryCode();
 };
 
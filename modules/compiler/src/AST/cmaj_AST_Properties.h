@@ -129,7 +129,7 @@ struct StringProperty   : public Property
     static constexpr uint8_t typeID = 1;
     static constexpr bool isObjectProperty = false;
 
-    void reset() override                                               { value = {}; }
+    void reset() override                                               { set ({}); }
     bool hasDefaultValue() const override                               { return value.empty(); }
     bool isPrimitive() const override                                   { return true; }
     std::string_view getPropertyType() const override                   { return "string"; }
@@ -147,7 +147,15 @@ struct StringProperty   : public Property
     bool operator!= (std::string_view nameToMatch) const                { return value.get() != nameToMatch; }
 
     PooledString get() const                                            { return value; }
-    void set (PooledString newValue)                                    { value = newValue; }
+
+    void set (PooledString newValue)
+    {
+        if (value != newValue)
+        {
+            value = newValue;
+            ++getAllocator().stringChangeCount;
+        }
+    }
 
     operator PooledString() const                                       { return get(); }
     StringProperty& operator= (PooledString newValue)                   { set (newValue); return *this; }
@@ -155,7 +163,18 @@ struct StringProperty   : public Property
 
     Property& allocateEmptyCopy (Object& o) const override              { return AST::getAllocator (o).allocate<StringProperty> (o); }
     Property& createClone (Object& o) const override                    { auto& a = AST::getAllocator (o); return a.allocate<StringProperty> (o, a.strings.stringPool.get (value.get())); }
-    void deepCopy (const Property& source, RemappedObjects&) override   { auto s = source.getAsStringProperty(); CMAJ_ASSERT (s != nullptr); value = s->value; }
+    void deepCopy (const Property& source, RemappedObjects&) override
+    {
+        auto s = source.getAsStringProperty();
+        CMAJ_ASSERT (s != nullptr);
+
+        // when copying between allocators, the string must be re-pooled so that comparisons still work
+        if (std::addressof (s->getStringPool()) == std::addressof (getStringPool()))
+            value = s->value;
+        else
+            value = getStringPool().get (s->value.get());
+    }
+
     choc::value::Value toSyntaxTree (const SyntaxTreeOptions&) override { return choc::value::createString (value); }
 
     bool isIdentical (const Property& other) const override
@@ -378,7 +397,7 @@ CMAJ_DECLARE_ENUM_PROPERTY (BinaryOpTypeEnum, add = 0, subtract = 1, multiply =
 
 CMAJ_DECLARE_ENUM_PROPERTY (EndpointTypeEnum, stream = 0, value = 1, event = 2)
 
-CMAJ_DECLARE_ENUM_PROPERTY (InterpolationTypeEnum, none = 0, latch = 1, linear = 2, sinc = 3, fast = 4, best = 5)
+CMAJ_DECLARE_ENUM_PROPERTY (InterpolationTypeEnum, none = 0, latch = 1, linear = 2, sinc = 3, fast = 4, best = 5, fir = 6, fastFir = 7)
 
 CMAJ_DECLARE_ENUM_PROPERTY (ProcessorPropertyEnum, frequency = 0, period = 1, id = 2, session = 3, latency = 4, maxFrequency = 5)
 
@@ -448,6 +467,7 @@ struct ObjectProperty   : public Property
     {
         referencedObject = const_cast<Object*> (std::addressof (newObject));
         referencedObject->addReferrer (*this);
+        owner.objectPropertyChanged();
     }
 
     bool referTo (ptr<const Object> newChild)
@@ -487,6 +507,7 @@ struct ObjectProperty   : public Property
         {
             referencedObject->removeReferrer (*this);
             referencedObject = nullptr;
+            owner.objectPropertyChanged();
         }
     }
 
@@ -519,6 +540,7 @@ struct ObjectProperty   : public Property
                 CMAJ_ASSERT (newObject->second != nullptr);
                 referencedObject = newObject->second;
                 referencedObject->addReferrer (*this);
+                owner.objectPropertyChanged();
             }
 
             if (isParentOfObject())
@@ -676,6 +698,7 @@ struct ListProperty   : public Property
             p->reset();
 
         list.clear();
+        invalidateNameIndex();
     }
 
     const std::vector<ref<Property>>& get() const         { return list; }
@@ -770,6 +793,7 @@ struct ListProperty   : public Property
 
         reset();
         list = std::vector<ref<Property>> (newList.begin(), newList.end());
+        invalidateNameIndex();
     }
 
     bool empty() const                          { return list.empty(); }
@@ -785,18 +809,21 @@ struct ListProperty   : public Property
             list.push_back (p);
         else
             list.insert (list.begin() + insertIndex, p);
+
+        invalidateNameIndex();
     }
 
     void set (Property& p, size_t index)
     {
         CMAJ_ASSERT (index < list.size());
         list[index] = p;
+        invalidateNameIndex();
     }
 
     void addReference (const Object& o, int insertIndex = -1)           { auto& p = getAllocator().allocate<ChildObject> (owner); p.referTo (o); add (p, insertIndex); }
     void addChildObject (Object& o, int insertIndex = -1)               { auto& p = getAllocator().allocate<ChildObject> (owner); p.setChildObject (o); add (p, insertIndex); }
     void addNullObject (int insertIndex = -1)                           { add (getAllocator().allocate<ChildObject> (owner), insertIndex); }
-    void setChildObject (Object& o, size_t index)                       { CMAJ_ASSERT (index < list.size()); auto c = list[index]->getAsChildObject(); if (c == nullptr) { c = getAllocator().allocate<ChildObject> (owner); list[index] = *c; } c->setChildObject (o); }
+    void setChildObject (Object& o, size_t index)                       { CMAJ_ASSERT (index < list.size()); auto c = list[index]->getAsChildObject(); if (c == nullptr) { c = getAllocator().allocate<ChildObject> (owner); list[index] = *c; } c->setChildObject (o); invalidateNameIndex(); }
     void addString (PooledString value, int insertIndex = -1)           { add (getAllocator().allocate<StringProperty> (owner, value), insertIndex); }
     void setString (PooledString value, size_t index)                   { set (getAllocator().allocate<StringProperty> (owner, value), index); }
     void addClone (Property& p, int insertIndex = -1)                   { add (p.createClone (owner), insertIndex); }
@@ -814,6 +841,8 @@ struct ListProperty   : public Property
         }
 
         sourceList.list.clear(); // must not call reset() on the source, as we have all its items now
+        sourceList.invalidateNameIndex();
+        invalidateNameIndex();
     }
 
     void remove (size_t index)
@@ -821,6 +850,7 @@ struct ListProperty   : public Property
         CMAJ_ASSERT (index < list.size());
         list[index]->reset();
         list.erase (list.begin() + static_cast<decltype(list)::difference_type> (index));
+        invalidateNameIndex();
     }
 
     void remove (size_t start, size_t end)
@@ -848,12 +878,48 @@ struct ListProperty   : public Property
 
     ptr<Object> findObjectWithName (PooledString name) const
     {
+        ptr<Object> result;
+
+        findObjectsWithName (name, [&] (Object& o)
+        {
+            result = o;
+            return false;
+        });
+
+        return result;
+    }
+
+    /// Calls the handler (in list order) for each item with the given name, stopping
+    /// early if the handler returns false. Long lists use a hashed index of their items'
+    /// names, which gets built on demand, and discarded when the list or its items change.
+    template <typename Handler>
+    void findObjectsWithName (PooledString name, Handler&& handler) const
+    {
+        if (auto index = getNameIndex())
+        {
+            auto found = index->items.find (name.hash());
+
+            if (found != index->items.end())
+                for (auto i : found->second)
+                    if (auto o = list[i]->getObject().get())
+                        if (o->hasName (name))
+                            if (! handler (*o))
+                                return;
+
+            return;
+        }
+
         for (auto& item : list)
             if (auto o = item->getObject().get())
                 if (o->hasName (name))
-                    return *o;
+                    if (! handler (*o))
+                        return;
+    }
 
-        return {};
+    /// Discards any cached index of the items' names
+    void invalidateNameIndex() const
+    {
+        nameIndex.reset();
     }
 
     bool removeObject (const AST::Object& o)
@@ -917,6 +983,8 @@ struct ListProperty   : public Property
                 list.back()->deepCopy (p, remappedObjects);
             }
         }
+
+        invalidateNameIndex();
     }
 
     void updateObjectMappings (RemappedObjects& objectMap) override
@@ -950,4 +1018,51 @@ struct ListProperty   : public Property
 
 private:
     std::vector<ref<Property>> list;
+
+    // Below this size, a linear search is faster than hashing
+    static constexpr size_t minimumSizeForNameIndex = 16;
+
+    struct NameIndex
+    {
+        uint64_t stringChangeCount = 0;
+        std::unordered_map<size_t, choc::SmallVector<uint32_t, 2>> items; // keyed on PooledString::hash()
+    };
+
+    mutable std::unique_ptr<NameIndex> nameIndex;
+
+    const NameIndex* getNameIndex() const
+    {
+        // Only modules keep their indexes up to date when an item is replaced (see
+        // ModuleBase::objectPropertyChanged), so other objects' lists are always searched linearly
+        if (list.size() < minimumSizeForNameIndex || owner.getAsModuleBase() == nullptr)
+            return nullptr;
+
+        auto stringChangeCount = owner.context.allocator.stringChangeCount;
+
+        if (nameIndex != nullptr && nameIndex->stringChangeCount == stringChangeCount)
+            return nameIndex.get();
+
+        auto index = std::make_unique<NameIndex>();
+        index->stringChangeCount = stringChangeCount;
+        index->items.reserve (list.size());
+
+        for (size_t i = 0; i < list.size(); ++i)
+        {
+            if (auto o = list[i]->getObject().get())
+            {
+                // A reference's name comes from its target, which could be changed without
+                // this list finding out, so lists that contain them aren't indexed
+                if (o->getAsNamedReference() != nullptr)
+                    return nullptr;
+
+                auto name = o->getName();
+
+                if (! name.empty())
+                    index->items[name.hash()].push_back (static_cast<uint32_t> (i));
+            }
+        }
+
+        nameIndex = std::move (index);
+        return nameIndex.get();
+    }
 };
@@ -46,39 +46,181 @@ private:
 
 
 //==============================================================================
+/// Interns strings so that each distinct string has a single PooledString, whose text
+/// lives in the allocator's memory pool.
+///
+/// Each pool belongs to a single program and isn't thread-safe, but there's also a
+/// process-wide tier of shared strings (typically the names used by the standard library)
+/// which every pool checks before creating its own copy of a string. Once published, that
+/// shared tier is immutable, so can be read from any thread without locking.
 struct StringPool
 {
     StringPool (choc::memory::Pool& p) : pool (p)
     {
-        strings.reserve (256);
+        table.reserve (256);
     }
 
-    PooledString get (const std::string& s)
+    PooledString get (std::string_view s)
     {
         if (s.empty())
             return {};
 
-        if (auto i = strings.find (s); i != strings.end())
-            return i->second;
+        auto hash = hashString (s);
+        auto& slot = table.findSlot (s, hash);
 
+        if (slot.text != nullptr)
+            return PooledString (slot.text);
+
+        // A string that's already in this pool always comes from here, even if the shared
+        // tier gets published later, so that the same string can't end up with two PooledStrings
+        if (auto shared = getSharedStrings().load (std::memory_order_acquire))
+        {
+            if (auto text = shared->table.find (s, hash))
+            {
+                table.insert (slot, text, hash);
+                return PooledString (text);
+            }
+        }
+
+        auto text = copyString (pool, s);
+        table.insert (slot, text, hash);
+        return PooledString (text);
+    }
+
+    PooledString get (const std::string& s)     { return get (std::string_view (s)); }
+    PooledString get (const char* s)            { return get (std::string_view (s)); }
+
+    /// Copies all the strings in this pool into a process-wide tier which all pools will
+    /// use from then on. This can only be done once, and later calls are ignored.
+    static void publishSharedStrings (const StringPool& source)
+    {
+        auto& sharedStrings = getSharedStrings();
+
+        if (sharedStrings.load (std::memory_order_acquire) != nullptr)
+            return;
+
+        auto shared = std::make_unique<SharedStrings>();
+        shared->table.reserve (source.table.size());
+
+        for (auto& slot : source.table.slots)
+            if (slot.text != nullptr)
+                shared->table.insert (shared->table.findSlot (*slot.text, slot.hash),
+                                      copyString (shared->pool, *slot.text), slot.hash);
+
+        const SharedStrings* expected = nullptr;
+
+        // the shared tier is deliberately leaked, as PooledStrings may refer to it for the lifetime of the process
+        if (sharedStrings.compare_exchange_strong (expected, shared.get(), std::memory_order_acq_rel))
+            shared.release();
+    }
+
+private:
+    //==============================================================================
+    // An open-addressing hash table, which holds pointers to the strings along with their
+    // hashes, so that lookups can take a string_view without needing to allocate anything
+    struct Table
+    {
+        struct Slot
+        {
+            size_t hash = 0;
+            const std::string_view* text = nullptr;
+        };
+
+        std::vector<Slot> slots;
+        size_t numItems = 0;
+
+        size_t size() const     { return numItems; }
+
+        void reserve (size_t numItemsNeeded)
+        {
+            size_t capacity = 16;
+
+            while (capacity < numItemsNeeded * 2)
+                capacity *= 2;
+
+            if (capacity > slots.size())
+                rehash (capacity);
+        }
+
+        // Returns the slot holding this string, or the empty slot where it should be inserted
+        Slot& findSlot (std::string_view s, size_t hash)
+        {
+            auto mask = slots.size() - 1;
+
+            for (auto i = hash & mask;; i = (i + 1) & mask)
+            {
+                auto& slot = slots[i];
+
+                if (slot.text == nullptr || (slot.hash == hash && *slot.text == s))
+                    return slot;
+            }
+        }
+
+        const std::string_view* find (std::string_view s, size_t hash) const
+        {
+            return const_cast<Table&> (*this).findSlot (s, hash).text;
+        }
+
+        void insert (Slot& emptySlot, const std::string_view* text, size_t hash)
+        {
+            emptySlot.hash = hash;
+            emptySlot.text = text;
+
+            if (++numItems * 2 > slots.size())
+                rehash (slots.size() * 2);
+        }
+
+        void rehash (size_t newCapacity)
+        {
+            auto oldSlots = std::move (slots);
+            slots = std::vector<Slot> (newCapacity);
+            auto mask = newCapacity - 1;
+
+            for (auto& slot : oldSlots)
+            {
+                if (slot.text != nullptr)
+                {
+                    auto i = slot.hash & mask;
+
+                    while (slots[i].text != nullptr)
+                        i = (i + 1) & mask;
+
+                    slots[i] = slot;
+                }
+            }
+        }
+    };
+
+    struct SharedStrings
+    {
+        choc::memory::Pool pool;
+        Table table;
+    };
+
+    static std::atomic<const SharedStrings*>& getSharedStrings()
+    {
+        static std::atomic<const SharedStrings*> sharedStrings { nullptr };
+        return sharedStrings;
+    }
+
+    static size_t hashString (std::string_view s)
+    {
+        return std::hash<std::string_view>() (s);
+    }
+
+    static const std::string_view* copyString (choc::memory::Pool& destPool, std::string_view s)
+    {
         auto length = s.length();
-        auto data = pool.allocateData (sizeof (std::string_view) + length);
+        auto data = destPool.allocateData (sizeof (std::string_view) + length);
         auto sv = reinterpret_cast<std::string_view*> (data);
         auto text = static_cast<char*> (data) + sizeof (std::string_view);
-        new (sv) std::string_view (text, length);
         std::memcpy (text, s.data(), length);
-
-        auto ps = PooledString (sv);
-        strings[s] = ps;
-        return ps;
+        new (sv) std::string_view (text, length);
+        return sv;
     }
 
-    PooledString get (std::string_view s)   { return get (std::string (s)); }
-    PooledString get (const char* s)        { return get (std::string (s)); }
-
-private:
     choc::memory::Pool& pool;
-    std::unordered_map<std::string, PooledString> strings;
+    Table table;
 };
 
 
@@ -94,6 +236,7 @@ struct Strings
                        mainFunctionName              { stringPool.get ("main") },
                        userInitFunctionName          { stringPool.get ("init") },
                        resetFunctionName             { stringPool.get ("reset") },
+                       isIdleFunctionName            { stringPool.get ("isIdle") },
                        systemInitFunctionName        { stringPool.get ("_initialise") },
                        systemAdvanceFunctionName     { stringPool.get ("_advance") },
                        rootNamespaceName             { stringPool.get ("_root") },
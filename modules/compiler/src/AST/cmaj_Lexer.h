@@ -525,13 +525,33 @@ private:
             return false;
         }
 
-        currentDoubleLiteral = std::stod (std::string (nextCharacter.data(), t.data()));
+        currentDoubleLiteral = parseDouble (nextCharacter.data(), t.data());
         nextCharacter = t;
         currentLiteralType = readFloatLiteralSuffix();
         throwErrorIfInvalidLiteralSuffix (true);
         return true;
     }
 
+    double parseDouble (const char* start, const char* end) const
+    {
+        double result = 0;
+
+       #if __cpp_lib_to_chars >= 201611L
+        auto error = std::from_chars (start, end, result).ec;
+       #else
+        // The text has already been validated and is null-terminated, so strtod will stop at the end
+        (void) end;
+        errno = 0;
+        result = std::strtod (start, nullptr);
+        auto error = errno == ERANGE ? std::errc::result_out_of_range : std::errc();
+       #endif
+
+        if (error == std::errc::result_out_of_range)
+            throwError (Errors::floatLiteralOutOfRange());
+
+        return result;
+    }
+
     LexerTokenType readFloatLiteralSuffix()
     {
         if (skipIfStartsWith (nextCharacter, "f32i", "_f32i", "fi"))    return LexerToken::literalImag32;
@@ -561,7 +581,7 @@ private:
             return false;
 
         ++nextCharacter;
-        escapedStringLiteral = {};
+        escapedStringLiteral.clear();
 
         for (;;)
         {
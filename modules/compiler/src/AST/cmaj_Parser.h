@@ -816,6 +816,8 @@ private:
         if (skipIfKeywordOrIdentifier ("latch"))  return AST::InterpolationTypeEnum::Enum::latch;
         if (skipIfKeywordOrIdentifier ("linear")) return AST::InterpolationTypeEnum::Enum::linear;
         if (skipIfKeywordOrIdentifier ("sinc"))   return AST::InterpolationTypeEnum::Enum::sinc;
+        if (skipIfKeywordOrIdentifier ("fir"))    return AST::InterpolationTypeEnum::Enum::fir;
+        if (skipIfKeywordOrIdentifier ("fastFir")) return AST::InterpolationTypeEnum::Enum::fastFir;
         if (skipIfKeywordOrIdentifier ("fast"))   return AST::InterpolationTypeEnum::Enum::fast;
         if (skipIfKeywordOrIdentifier ("best"))   return AST::InterpolationTypeEnum::Enum::best;
 
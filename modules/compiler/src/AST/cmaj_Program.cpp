@@ -16,6 +16,8 @@
 //  EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
 //  DISCLAIMED.
 
+#include <thread>
+#include "choc/text/choc_Files.h"
 #include "../../include/cmaj_ErrorHandling.h"
 #include "../../../include/cmajor/COM/cmaj_Library.h"
 #include "cmaj_AST.h"
@@ -37,17 +39,456 @@ namespace cmaj
         return choc::com::create<cmaj::AST::Program>();
     }
 
+    static void addPropertyObjects (AST::Property& property, std::vector<AST::Object*>& objects)
+    {
+        if (auto list = property.getAsListProperty())
+        {
+            for (auto& item : *list)
+                addPropertyObjects (item.get(), objects);
+        }
+        else if (auto o = property.getObject())
+        {
+            objects.push_back (o.get());
+        }
+    }
+
     void AST::Program::parse (const SourceFile& source, bool isSystemModule)
     {
         Parser::parseModuleDeclarations (allocator, source, isSystemModule, parsingComments, rootNamespace, {});
         resetMainProcessor();
     }
 
-    void AST::Program::addStandardLibraryCode()
+    void AST::Program::parse (const std::vector<const SourceFile*>& sourceFiles)
     {
-        for (auto& m : transformations::parseBinaryModule (allocator, standardLibraryData, sizeof (standardLibraryData), false))
-            rootNamespace.subModules.addChildObject (m);
+        if (sourceFiles.size() < 2)
+        {
+            for (auto f : sourceFiles)
+                parse (*f, false);
+
+            return;
+        }
+
+        // Because an allocator can only be used by one thread, each file gets parsed into its own
+        // one, and then the resulting modules are copied into this program's allocator
+        struct ParsedFile
+        {
+            std::unique_ptr<Allocator> allocator = std::make_unique<Allocator>();
+            Namespace& rootNamespace = allocator->createNamespace (allocator->strings.rootNamespaceName);
+            DiagnosticMessageList messages;
+        };
+
+        std::vector<std::unique_ptr<ParsedFile>> parsedFiles;
+
+        for (size_t i = 0; i < sourceFiles.size(); ++i)
+        {
+            parsedFiles.push_back (std::make_unique<ParsedFile>());
+            parsedFiles.back()->rootNamespace.isSystem = true;
+        }
+
+        std::atomic<size_t> nextFile { 0 };
+
+        auto parseFiles = [&]
+        {
+            for (;;)
+            {
+                auto index = nextFile++;
+
+                if (index >= sourceFiles.size())
+                    break;
+
+                auto& parsedFile = *parsedFiles[index];
+
+                catchAllErrors (parsedFile.messages, [&]
+                {
+                    Parser::parseModuleDeclarations (*parsedFile.allocator, *sourceFiles[index], false,
+                                                     parsingComments, parsedFile.rootNamespace, {});
+                });
+            }
+        };
+
+        auto numThreads = std::min (sourceFiles.size(), static_cast<size_t> (std::max (1u, std::thread::hardware_concurrency())));
+        std::vector<std::thread> threads;
+
+        for (size_t i = 1; i < numThreads; ++i)
+            threads.emplace_back (parseFiles);
+
+        parseFiles();
+
+        for (auto& t : threads)
+            t.join();
+
+        // The results are added in order, stopping at the first file that failed, so
+        // that this behaves just like parsing the files one at a time
+        for (auto& parsedFile : parsedFiles)
+        {
+            if (parsedFile->messages.hasErrors())
+                throwError (parsedFile->messages);
+
+            if (! parsedFile->messages.empty())
+                emitMessage (parsedFile->messages);
+
+            copyParsedModules (parsedFile->rootNamespace, *parsedFile->allocator);
+        }
+
+        resetMainProcessor();
+    }
+
+    void AST::Program::copyParsedModules (const Namespace& parsedRootNamespace, const Allocator& parsedAllocator)
+    {
+        RemappedObjects objectMap;
+        std::vector<Object*> clones;
+        objectMap[std::addressof (parsedRootNamespace)] = std::addressof (rootNamespace);
+
+        for (auto& m : parsedRootNamespace.subModules.getAsObjectList())
+        {
+            auto& clone = m->createDeepClone (allocator, objectMap);
+            rootNamespace.subModules.addChildObject (clone);
+            clones.push_back (std::addressof (clone));
+        }
+
+        // A deep clone only copies the objects that are owned by the tree, so anything that's
+        // just referred to (e.g. the identifier naming the target of a `break`) is cloned here,
+        // leaving nothing that points into the parser's allocator once it's deleted
+        for (;;)
+        {
+            std::vector<Object*> referencedObjects, objectsToClone;
+
+            for (auto& remapped : objectMap)
+                for (auto p : remapped.second->getPropertyList())
+                    addPropertyObjects (*p, referencedObjects);
+
+            for (auto o : referencedObjects)
+                if (std::addressof (o->context.allocator) == std::addressof (parsedAllocator)
+                     && objectMap.find (o) == objectMap.end())
+                    objectsToClone.push_back (o);
+
+            if (objectsToClone.empty())
+                break;
+
+            for (auto o : objectsToClone)
+                if (objectMap.find (o) == objectMap.end())
+                    clones.push_back (std::addressof (o->createDeepClone (allocator, objectMap)));
+        }
+
+        for (auto clone : clones)
+            clone->updateObjectMappings (objectMap);
 
         transformations::mergeDuplicateNamespaces (rootNamespace);
     }
+
+    const SourceFile& AST::Program::addSourceFile (const SourceFileToParse& file)
+    {
+        return allocator.sourceFileList.add (file.filename != nullptr ? std::string (file.filename) : std::string(),
+                                             file.content != nullptr && file.contentSize != 0 ? std::string (file.content, file.contentSize) : std::string(),
+                                             false);
+    }
+
+    std::vector<const SourceFile*> AST::Program::parseSourceFiles (const SourceFileToParse* files, size_t numFiles)
+    {
+        std::vector<const SourceFile*> sourceFiles;
+
+        for (size_t i = 0; i < numFiles; ++i)
+        {
+            auto& file = files[i];
+
+            if (! file.loadFromFile)
+            {
+                sourceFiles.push_back (std::addressof (addSourceFile (file)));
+                continue;
+            }
+
+            auto filename = file.filename != nullptr ? std::string (file.filename) : std::string();
+            std::string content;
+
+            // The file is read once, straight into a string that the source file list takes
+            // ownership of, so the parser never depends on the file itself
+            try
+            {
+                content = choc::file::loadFileAsString (filename);
+            }
+            catch (const choc::file::Error&)
+            {
+                throwError (Errors::cannotReadSourceFile (filename));
+            }
+
+            sourceFiles.push_back (std::addressof (allocator.sourceFileList.add (std::move (filename), std::move (content), false)));
+        }
+
+        parse (sourceFiles);
+        return sourceFiles;
+    }
+
+    /// Calls the handler once for each object that can be reached from the root, either
+    /// as a child, a reference or a parent scope.
+    template <typename Handler>
+    static void visitReachableObjects (AST::Object& root, Handler&& handler)
+    {
+        std::unordered_set<const AST::Object*> visited;
+        std::vector<AST::Object*> objectsToVisit { std::addressof (root) };
+
+        while (! objectsToVisit.empty())
+        {
+            auto& o = *objectsToVisit.back();
+            objectsToVisit.pop_back();
+
+            if (! visited.insert (std::addressof (o)).second)
+                continue;
+
+            handler (o);
+
+            if (auto parent = o.context.parentScope.get())
+                objectsToVisit.push_back (parent);
+
+            for (auto p : o.getPropertyList())
+                addPropertyObjects (*p, objectsToVisit);
+        }
+    }
+
+    choc::value::Value AST::Program::getMemoryUsage() const
+    {
+        struct ObjectTypeUsage
+        {
+            std::string_view objectType;
+            size_t objectSize = 0, numAllocated = 0, numLive = 0;
+
+            size_t getTotalBytes() const    { return objectSize * numAllocated; }
+            size_t getLiveBytes() const     { return objectSize * numLive; }
+        };
+
+        std::vector<ObjectTypeUsage> usage;
+        std::unordered_map<std::string_view, size_t> typeIndexes;
+
+        for (auto& a : allocator.objectTypeAllocations)
+        {
+            if (a.numAllocated != 0)
+            {
+                typeIndexes[a.objectType] = usage.size();
+                usage.push_back ({ a.objectType, a.objectSize, a.numAllocated });
+            }
+        }
+
+        visitReachableObjects (rootNamespace, [&] (Object& o)
+        {
+            if (std::addressof (o.context.allocator) == std::addressof (allocator))
+                if (auto index = typeIndexes.find (o.getObjectType()); index != typeIndexes.end())
+                    ++usage[index->second].numLive;
+        });
+
+        std::sort (usage.begin(), usage.end(), [] (const ObjectTypeUsage& a, const ObjectTypeUsage& b)
+        {
+            return a.getTotalBytes() > b.getTotalBytes();
+        });
+
+        size_t totalBytes = 0, liveBytes = 0;
+        auto classes = choc::value::createEmptyArray();
+
+        for (auto& u : usage)
+        {
+            totalBytes += u.getTotalBytes();
+            liveBytes += u.getLiveBytes();
+
+            classes.addArrayElement (choc::value::createObject ("ObjectType",
+                                                                "class", std::string (u.objectType),
+                                                                "allocated", static_cast<int64_t> (u.numAllocated),
+                                                                "live", static_cast<int64_t> (u.numLive),
+                                                                "totalBytes", static_cast<int64_t> (u.getTotalBytes()),
+                                                                "liveBytes", static_cast<int64_t> (u.getLiveBytes())));
+        }
+
+        return choc::value::createObject ("MemoryUsage",
+                                          "totalBytes", static_cast<int64_t> (totalBytes),
+                                          "liveBytes", static_cast<int64_t> (liveBytes),
+                                          "otherBytes", static_cast<int64_t> (allocator.numOtherBytesAllocated),
+                                          "classes", classes);
+    }
+
+    choc::com::Ptr<AST::Program> AST::Program::createCompactedCopy() const
+    {
+        auto copy = choc::com::create<Program> (parsingComments);
+        auto& newAllocator = copy->allocator;
+
+        for (auto& f : allocator.sourceFileList.sourceFiles)
+            newAllocator.sourceFileList.add (*f);
+
+        // The root namespace and the allocator's primitive types aren't cloned, but anything
+        // that refers to them needs to use the copy's own ones instead
+        RemappedObjects objectMap;
+        objectMap[std::addressof (rootNamespace)] = std::addressof (copy->rootNamespace);
+
+        auto mapPrimitiveType = [&] (const PrimitiveType& original, const PrimitiveType& replacement)
+        {
+            objectMap[std::addressof (original)] = const_cast<PrimitiveType*> (std::addressof (replacement));
+        };
+
+        mapPrimitiveType (allocator.voidType,               newAllocator.voidType);
+        mapPrimitiveType (allocator.int32Type,              newAllocator.int32Type);
+        mapPrimitiveType (allocator.int64Type,              newAllocator.int64Type);
+        mapPrimitiveType (allocator.float32Type,            newAllocator.float32Type);
+        mapPrimitiveType (allocator.float64Type,            newAllocator.float64Type);
+        mapPrimitiveType (allocator.complex32Type,          newAllocator.complex32Type);
+        mapPrimitiveType (allocator.complex64Type,          newAllocator.complex64Type);
+        mapPrimitiveType (allocator.boolType,               newAllocator.boolType);
+        mapPrimitiveType (allocator.stringType,             newAllocator.stringType);
+        mapPrimitiveType (allocator.arraySizeType,          newAllocator.arraySizeType);
+        mapPrimitiveType (allocator.processorFrequencyType, newAllocator.processorFrequencyType);
+
+        // All the modules share one map, so that references between them get remapped
+        for (auto& m : rootNamespace.subModules.getAsObjectList())
+            copy->rootNamespace.subModules.addChildObject (m->createDeepClone (newAllocator, objectMap));
+
+        copy->rootNamespace.updateObjectMappings (objectMap);
+
+        // Cloning adds the copy's properties to the referrer lists of the original objects,
+        // and these must be removed so that the original can still be used once the copy
+        // has been deleted
+        visitReachableObjects (rootNamespace, [&] (Object& o)
+        {
+            for (auto r : o.getReferrers())
+                if (std::addressof (r->owner.context.allocator) == std::addressof (newAllocator))
+                    o.removeReferrer (*r);
+        });
+
+        // If anything still refers to an object from another allocator, it must be something
+        // that wasn't reachable from the root namespace, so the original can't be freed
+        bool allObjectsCopied = true;
+
+        visitReachableObjects (copy->rootNamespace, [&] (Object& o)
+        {
+            if (std::addressof (o.context.allocator) != std::addressof (newAllocator))
+                allObjectsCopied = false;
+        });
+
+        if (! allObjectsCopied)
+            return {};
+
+        if (mainProcessor != nullptr)
+        {
+            auto clone = objectMap.find (mainProcessor.get());
+
+            if (clone == objectMap.end())
+                return {};
+
+            copy->mainProcessor = clone->second->getAsProcessorBase();
+        }
+
+        if (! copy->externalFunctionManager.copyFrom (externalFunctionManager, objectMap))
+            return {};
+
+        // Endpoints that the code-gen transformations have removed are dropped from the list
+        copy->endpointList.inputEndpointDetails = endpointList.inputEndpointDetails;
+        copy->endpointList.outputEndpointDetails = endpointList.outputEndpointDetails;
+
+        for (auto& e : endpointList.endpoints)
+            if (auto clone = objectMap.find (std::addressof (e.endpoint)); clone != objectMap.end())
+                copy->endpointList.endpoints.push_back ({ castToRef<EndpointDeclaration> (*clone->second), e.details });
+
+        for (auto& [original, clone] : objectMap)
+            if (auto f = original->getAsFunction())
+                clone->getAsFunction()->isPreResolved = f->isPreResolved;
+
+        copy->codeHash = codeHash;
+        copy->externalVariableManager = externalVariableManager;
+        copy->resolutionStatistics = resolutionStatistics;
+        copy->compileProfile = compileProfile;
+        copy->canSkipPreResolvedFunctions = canSkipPreResolvedFunctions;
+        copy->needsReparsing = true;
+        return copy;
+    }
+
+    //==============================================================================
+    // Every program needs its own copy of the standard library AST, but rather than having
+    // each one resolve it from scratch, this image holds a version that has already been
+    // through the resolution passes, along with a flag for each of its functions to say
+    // whether the passes can skip it.
+    struct PreResolvedStandardLibrary
+    {
+        std::vector<uint8_t> moduleData;
+        std::vector<bool> resolvedFunctions;
+    };
+
+    static AST::ObjectRefVector<AST::Function> getAllFunctions (const AST::ObjectRefVector<AST::ModuleBase>& modules)
+    {
+        AST::ObjectRefVector<AST::Function> result;
+
+        for (auto& m : modules)
+        {
+            if (auto ns = m->getAsNamespace())
+                ns->visitAllFunctions (false, [&] (AST::Function& f) { result.push_back (f); });
+            else if (auto p = m->getAsProcessorBase())
+                for (auto& f : p->functions.iterateAs<AST::Function>())
+                    result.push_back (f);
+        }
+
+        return result;
+    }
+
+    static void addModules (AST::Program& program, const AST::ObjectRefVector<AST::ModuleBase>& modules)
+    {
+        for (auto& m : modules)
+            program.rootNamespace.subModules.addChildObject (m);
+
+        transformations::mergeDuplicateNamespaces (program.rootNamespace);
+    }
+
+    static PreResolvedStandardLibrary createPreResolvedStandardLibrary()
+    {
+        PreResolvedStandardLibrary image;
+
+        try
+        {
+            {
+                AST::Program program;
+                addModules (program, transformations::parseBinaryModule (program.allocator, standardLibraryData, sizeof (standardLibraryData), false));
+                transformations::runBasicResolutionPasses (program);
+                image.moduleData = transformations::createBinaryModule (program.getTopLevelModules());
+            }
+
+            // The flags are worked out from a reloaded copy of the image, so that they refer to
+            // the functions in exactly the form that each program will get them
+            AST::Program program;
+            auto modules = transformations::parseBinaryModule (program.allocator, image.moduleData.data(), image.moduleData.size(), false);
+            auto functions = getAllFunctions (modules);
+            addModules (program, modules);
+            image.resolvedFunctions = transformations::findResolvedFunctions (program, functions);
+
+            // This program's strings are now the names used by the library, so make them
+            // available to all programs rather than each one creating its own copies
+            AST::StringPool::publishSharedStrings (program.allocator.strings.stringPool);
+        }
+        catch (...)
+        {
+            // if the library can't be resolved on its own, programs will fall back to the raw version
+            return {};
+        }
+
+        return image;
+    }
+
+    static const PreResolvedStandardLibrary& getPreResolvedStandardLibrary()
+    {
+        static const PreResolvedStandardLibrary image = createPreResolvedStandardLibrary();
+        return image;
+    }
+
+    void AST::Program::addStandardLibraryCode()
+    {
+        auto& image = getPreResolvedStandardLibrary();
+
+        if (image.moduleData.empty())
+        {
+            canSkipPreResolvedFunctions = false;
+            addModules (*this, transformations::parseBinaryModule (allocator, standardLibraryData, sizeof (standardLibraryData), false));
+            return;
+        }
+
+        auto modules = transformations::parseBinaryModule (allocator, image.moduleData.data(), image.moduleData.size(), false);
+        auto functions = getAllFunctions (modules);
+        canSkipPreResolvedFunctions = functions.size() == image.resolvedFunctions.size();
+
+        if (canSkipPreResolvedFunctions)
+            for (size_t i = 0; i < functions.size(); ++i)
+                functions[i]->isPreResolved = image.resolvedFunctions[i];
+
+        addModules (*this, modules);
+    }
 }
@@ -153,6 +153,8 @@ struct CPlusPlusEngine
     static constexpr bool usesDynamicRateAndSessionID = true;
     static constexpr bool allowTopLevelSlices = false;
     static constexpr bool supportsExternalFunctions = false;
+    static constexpr bool supportsTieredCompilation = false;
+    static constexpr bool canShareLinkedCode = false;
     static bool engineSupportsIntrinsic (AST::Intrinsic::Type) { return true; }
 
     //==============================================================================
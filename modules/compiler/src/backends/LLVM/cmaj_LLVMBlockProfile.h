@@ -0,0 +1,268 @@
+//
+//     ,ad888ba,                              88
+//    d8"'    "8b
+//   d8            88,dba,,adba,   ,aPP8A.A8  88     The Cmajor Toolkit
+//   Y8,           88    88    88  88     88  88
+//    Y8a.   .a8P  88    88    88  88,   ,88  88     (C)2024 Cmajor Software Ltd
+//     '"Y888Y"'   88    88    88  '"8bbP"Y8  88     https://cmajor.dev
+//                                           ,88
+//                                        888P"
+//
+//  The Cmajor project is subject to commercial or open-source licensing.
+//  You may use it under the terms of the GPLv3 (see www.gnu.org/licenses), or
+//  visit https://cmajor.dev to learn about our commercial licence options.
+//
+//  CMAJOR IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+//  EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+//  DISCLAIMED.
+
+namespace cmaj::llvm
+{
+
+//==============================================================================
+/**
+    A count of how many times each basic block in a module was executed, which can
+    be turned into branch weights and function entry counts for the optimiser.
+
+    LLVM's own PGO instrumentation needs the compiler-rt profiling runtime, which
+    isn't available to JIT'd code, so instead instrument() adds a 64-bit counter for
+    each block to a global array that the host can read directly after the code has
+    been running for a while. The counters are read and written with relaxed atomic
+    operations, so that reading them from another thread isn't a data race. The
+    increment isn't an atomic read-modify-write, because that would be much slower,
+    so if several performers share the code, a few increments may get lost, which
+    doesn't matter for a profile.
+
+    The blocks are numbered in the order that they appear in the module, so a
+    profile can only be applied to a module that was generated in exactly the same
+    way as the instrumented one. The signature is used to check this before a
+    profile that's been reloaded from a cache gets used.
+*/
+struct BlockProfile
+{
+    uint64_t signature = 0;
+    std::vector<uint64_t> counts;
+
+    static constexpr const char* counterArrayName = "_cmaj_block_counts";
+
+    /// Adds a counter increment to the start of every block in the module, and
+    /// returns an empty profile with the right size and signature for it.
+    static BlockProfile instrument (::llvm::Module& module)
+    {
+        BlockProfile profile;
+        profile.signature = getSignature (module);
+
+        std::vector<::llvm::BasicBlock*> blocks;
+
+        for (auto& f : module)
+            for (auto& b : f)
+                blocks.push_back (std::addressof (b));
+
+        profile.counts.resize (blocks.size());
+
+        if (blocks.empty())
+            return profile;
+
+        auto& context = module.getContext();
+        auto counterType = ::llvm::Type::getInt64Ty (context);
+        auto arrayType = ::llvm::ArrayType::get (counterType, blocks.size());
+
+        auto counters = new ::llvm::GlobalVariable (module, arrayType, false,
+                                                    ::llvm::GlobalValue::ExternalLinkage,
+                                                    ::llvm::ConstantAggregateZero::get (arrayType),
+                                                    counterArrayName);
+
+        ::llvm::IRBuilder<> builder (context);
+
+        for (size_t i = 0; i < blocks.size(); ++i)
+        {
+            builder.SetInsertPoint (blocks[i], blocks[i]->getFirstInsertionPt());
+            auto counter = builder.CreateConstInBoundsGEP2_64 (arrayType, counters, 0, i);
+
+            auto load = builder.CreateAlignedLoad (counterType, counter, ::llvm::Align (sizeof (uint64_t)));
+            load->setAtomic (::llvm::AtomicOrdering::Monotonic);
+
+            auto store = builder.CreateAlignedStore (builder.CreateAdd (load, ::llvm::ConstantInt::get (counterType, 1)),
+                                                     counter, ::llvm::Align (sizeof (uint64_t)));
+            store->setAtomic (::llvm::AtomicOrdering::Monotonic);
+        }
+
+        return profile;
+    }
+
+    /// Copies the current values of the counters that instrument() added, while the
+    /// code may still be running on other threads.
+    void readCounters (const void* counterArray)
+    {
+        static_assert (sizeof (std::atomic<uint64_t>) == sizeof (uint64_t));
+
+        if (counterArray != nullptr)
+        {
+            auto counters = static_cast<const std::atomic<uint64_t>*> (counterArray);
+
+            for (size_t i = 0; i < counts.size(); ++i)
+                counts[i] = counters[i].load (std::memory_order_relaxed);
+        }
+    }
+
+    /// Returns true if this profile was recorded for a module with the same structure.
+    bool matches (const ::llvm::Module& module) const
+    {
+        return ! counts.empty() && getSignature (module) == signature;
+    }
+
+    /// Annotates the module with branch weights and function entry counts.
+    void apply (::llvm::Module& module) const
+    {
+        CMAJ_ASSERT (matches (module));
+
+        std::unordered_map<const ::llvm::BasicBlock*, uint64_t> blockCounts;
+        ::llvm::InstrProfSummaryBuilder summary (::llvm::ProfileSummaryBuilder::DefaultCutoffs);
+        size_t index = 0;
+
+        for (auto& f : module)
+        {
+            for (auto& b : f)
+            {
+                auto count = counts[index++];
+                blockCounts[std::addressof (b)] = count;
+
+                if (std::addressof (b) == std::addressof (f.getEntryBlock()))
+                    summary.addEntryCount (count);
+                else
+                    summary.addInternalCount (count);
+            }
+        }
+
+        ::llvm::MDBuilder mdBuilder (module.getContext());
+
+        for (auto& f : module)
+        {
+            if (f.isDeclaration())
+                continue;
+
+            f.setEntryCount (blockCounts[std::addressof (f.getEntryBlock())]);
+
+            for (auto& b : f)
+            {
+                auto terminator = b.getTerminator();
+
+                if (terminator == nullptr || terminator->getNumSuccessors() < 2
+                     || ! (::llvm::isa<::llvm::BranchInst> (terminator) || ::llvm::isa<::llvm::SwitchInst> (terminator)))
+                    continue;
+
+                auto weights = getSuccessorCounts (*terminator, blockCounts[std::addressof (b)], blockCounts);
+
+                if (auto maxWeight = *std::max_element (weights.begin(), weights.end()); maxWeight != 0)
+                {
+                    auto scale = maxWeight / std::numeric_limits<uint32_t>::max() + 1;
+                    std::vector<uint32_t> scaledWeights;
+
+                    for (auto w : weights)
+                        scaledWeights.push_back (static_cast<uint32_t> (w / scale));
+
+                    terminator->setMetadata (::llvm::LLVMContext::MD_prof, mdBuilder.createBranchWeights (scaledWeights));
+                }
+            }
+        }
+
+        module.setProfileSummary (summary.getSummary()->getMD (module.getContext()), ::llvm::ProfileSummary::PSK_Instr);
+    }
+
+    //==============================================================================
+    std::vector<char> serialise() const
+    {
+        std::vector<char> data ((counts.size() + 2) * sizeof (uint64_t));
+        auto dest = data.data();
+
+        auto write = [&] (uint64_t value)
+        {
+            choc::memory::writeLittleEndian (dest, value);
+            dest += sizeof (uint64_t);
+        };
+
+        write (signature);
+        write (static_cast<uint64_t> (counts.size()));
+
+        for (auto c : counts)
+            write (c);
+
+        return data;
+    }
+
+    bool deserialise (choc::span<const char> data)
+    {
+        if (data.size() < 2 * sizeof (uint64_t) || (data.size() % sizeof (uint64_t)) != 0)
+            return false;
+
+        auto read = [&] (size_t index)  { return choc::memory::readLittleEndian<uint64_t> (data.data() + index * sizeof (uint64_t)); };
+
+        auto numCounts = read (1);
+
+        if (numCounts != data.size() / sizeof (uint64_t) - 2)
+            return false;
+
+        signature = read (0);
+        counts.resize (static_cast<size_t> (numCounts));
+
+        for (size_t i = 0; i < counts.size(); ++i)
+            counts[i] = read (i + 2);
+
+        return true;
+    }
+
+private:
+    static uint64_t getSignature (const ::llvm::Module& module)
+    {
+        choc::hash::xxHash64 hash;
+
+        for (auto& f : module)
+        {
+            auto name = f.getName();
+            hash.addInput (name.data(), name.size());
+
+            for (auto& b : f)
+            {
+                auto size = static_cast<uint64_t> (b.size());
+                hash.addInput (std::addressof (size), sizeof (size));
+            }
+        }
+
+        return hash.getHash();
+    }
+
+    /// Only block counts are recorded, so edge counts have to be inferred: a successor
+    /// whose only predecessor is this block must have been reached from here every time
+    /// it ran, and whatever's left is shared between the others.
+    static std::vector<uint64_t> getSuccessorCounts (const ::llvm::Instruction& terminator, uint64_t blockCount,
+                                                     std::unordered_map<const ::llvm::BasicBlock*, uint64_t>& blockCounts)
+    {
+        auto numSuccessors = terminator.getNumSuccessors();
+        std::vector<uint64_t> weights (numSuccessors);
+        std::vector<bool> isExact (numSuccessors);
+        uint64_t exactTotal = 0;
+        uint32_t numInexact = 0;
+
+        for (uint32_t i = 0; i < numSuccessors; ++i)
+        {
+            auto successor = terminator.getSuccessor (i);
+            weights[i] = blockCounts[successor];
+            isExact[i] = successor->getSinglePredecessor() != nullptr;
+
+            if (isExact[i])
+                exactTotal += weights[i];
+            else
+                ++numInexact;
+        }
+
+        auto remaining = blockCount > exactTotal ? blockCount - exactTotal : 0;
+
+        for (uint32_t i = 0; i < numSuccessors; ++i)
+            if (! isExact[i])
+                weights[i] = numInexact == 1 ? remaining : std::min (weights[i], remaining);
+
+        return weights;
+    }
+};
+
+} // namespace cmaj::llvm
@@ -21,6 +21,8 @@
 #include "choc/memory/choc_Endianness.h"
 #include "../../codegen/cmaj_CodeGenHelpers.h"
 #include "../../validation/cmaj_ValidationUtilities.h"
+#include "cmaj_LLVMVectorMath.h"
+#include "cmaj_LLVMBlockProfile.h"
 
 namespace cmaj::llvm
 {
@@ -72,13 +74,22 @@ struct LLVMCodeGenerator
     }
 
     bool generate()
+    {
+        return generate (buildSettings.getOptimisationLevel());
+    }
+
+    bool generate (int optimisationLevel)
     {
         CodeGenerator<LLVMCodeGenerator> codeGen (*this, program.getMainProcessor());
         codeGenerator = codeGen;
 
-        codeGen.emitTypes();
-        codeGen.emitGlobals();
-        codeGen.emitFunctions();
+        {
+            auto timer = program.compileProfile.measure ("llvm", "emitIR", allocator);
+
+            codeGen.emitTypes();
+            codeGen.emitGlobals();
+            codeGen.emitFunctions();
+        }
 
        #if CMAJ_LLVM_RUN_VERIFIER
         if (verifyModule (*targetModule))
@@ -92,7 +103,12 @@ struct LLVMCodeGenerator
        #endif
 
         dumpDebugPrintout ("Pre optimisation", false);
-        applyOptimisationPasses();
+
+        {
+            auto timer = program.compileProfile.measure ("llvm", "optimise", allocator);
+            applyOptimisationPasses (*targetModule, optimisationLevel);
+        }
+
         dumpDebugPrintout ("Post optimisation");
         codeGenerator = nullptr;
         return true;
@@ -135,24 +151,37 @@ struct LLVMCodeGenerator
         return true;
     }
 
+    static void writeDictionary (::llvm::raw_ostream& s, const choc::value::SimpleStringDictionary& stringDictionary)
+    {
+        char dictionarySize[sizeof (uint32_t)];
+        choc::memory::writeLittleEndian (dictionarySize, static_cast<uint32_t> (stringDictionary.strings.size()));
+        s.write (dictionarySize, sizeof (dictionarySize));
+        s.write (stringDictionary.strings.data(), stringDictionary.strings.size());
+    }
+
     void saveBitcodeToCache (CacheDatabaseInterface& cache, const char* key)
     {
         ::llvm::SmallVector<char, 64> bitcode;
 
         {
             ::llvm::raw_svector_ostream s (bitcode);
-
-            char dictionarySize[sizeof (uint32_t)];
-            choc::memory::writeLittleEndian (dictionarySize, static_cast<uint32_t> (stringDictionary.strings.size()));
-            s.write (dictionarySize, sizeof (dictionarySize));
-            s.write (stringDictionary.strings.data(), stringDictionary.strings.size());
-
+            writeDictionary (s, stringDictionary);
             ::llvm::WriteBitcodeToFile (*targetModule, s);
         }
 
         cache.store (key, bitcode.data(), bitcode.size());
     }
 
+    /// Returns the module as bitcode, so that it can be re-loaded into a different context
+    std::string getBitcode()
+    {
+        std::string bitcode;
+        ::llvm::raw_string_ostream s (bitcode);
+        ::llvm::WriteBitcodeToFile (*targetModule, s);
+        s.flush();
+        return bitcode;
+    }
+
     void dumpDebugPrintout (const char* description, bool includeAssembly = true)
     {
         if (buildSettings.shouldDumpDebugInfo())
@@ -355,9 +384,17 @@ struct LLVMCodeGenerator
         return std::string (result.begin(), result.end());
     }
 
-    void applyOptimisationPasses()
+    /// If a profile is given, its branch weights and entry counts are added to the
+    /// module first, so that the optimiser can use them for inlining and block layout.
+    /// If a cancellation flag is given, the remaining optional passes are skipped once
+    /// it has been set, leaving the module valid but not fully optimised.
+    static void applyOptimisationPasses (::llvm::Module& module, int optimisationLevel, const BlockProfile* profile = nullptr,
+                                         const std::atomic<bool>* cancelled = nullptr)
     {
-        auto optLevel = getOptimisationLevelWithDefault (buildSettings.getOptimisationLevel());
+        if (profile != nullptr)
+            profile->apply (module);
+
+        auto optLevel = getOptimisationLevelWithDefault (optimisationLevel);
 
         ::llvm::LoopAnalysisManager     loopAnalysisManager;
         ::llvm::FunctionAnalysisManager functionAnalysisManager;
@@ -366,7 +403,16 @@ struct LLVMCodeGenerator
 
         functionAnalysisManager.registerPass ([&] { return ::llvm::AAManager(); });
 
-        ::llvm::PassBuilder passBuilder;
+        ::llvm::PassInstrumentationCallbacks instrumentationCallbacks;
+
+        if (cancelled != nullptr)
+            instrumentationCallbacks.registerShouldRunOptionalPassCallback ([cancelled] (::llvm::StringRef, ::llvm::Any)
+            {
+                return ! cancelled->load (std::memory_order_relaxed);
+            });
+
+        ::llvm::PassBuilder passBuilder (nullptr, ::llvm::PipelineTuningOptions(), {},
+                                         cancelled != nullptr ? std::addressof (instrumentationCallbacks) : nullptr);
 
         passBuilder.registerLoopAnalyses     (loopAnalysisManager);
         passBuilder.registerFunctionAnalyses (functionAnalysisManager);
@@ -389,12 +435,12 @@ struct LLVMCodeGenerator
             };
 
             passBuilder.buildPerModuleDefaultPipeline (getOptimisationLevel())
-                .run (*targetModule, moduleAnalysisManager);
+                .run (module, moduleAnalysisManager);
         }
         else
         {
             passBuilder.buildO0DefaultPipeline (::llvm::OptimizationLevel::O0)
-                .run (*targetModule, moduleAnalysisManager);
+                .run (module, moduleAnalysisManager);
         }
     }
 
@@ -402,7 +448,7 @@ struct LLVMCodeGenerator
     {
         auto packer = std::make_unique<NativeTypeLayout> (targetType);
 
-        packer->generate ([this] (const AST::TypeBase& sourceType, uint32_t elementIndex) -> NativeTypeLayout::NativeChunkInfo
+        packer->generate (targetType, [this] (const AST::TypeBase& sourceType, uint32_t elementIndex) -> NativeTypeLayout::NativeChunkInfo
         {
             auto type = getLLVMType (sourceType);
 
@@ -1563,6 +1609,29 @@ struct LLVMCodeGenerator
         return {};
     }
 
+    ::llvm::Value* createVectorMathKernel (AST::Intrinsic::Type intrinsic, ::llvm::ArrayRef<::llvm::Value*> args)
+    {
+        auto& b = getBlockBuilder();
+        auto savedFlags = b.getFastMathFlags();
+        b.clearFastMathFlags();
+
+        VectorMathKernels kernels (b, args.front());
+        ::llvm::Value* result = nullptr;
+
+        switch (intrinsic)
+        {
+            case AST::Intrinsic::Type::sin:   result = kernels.sin (args[0]); break;
+            case AST::Intrinsic::Type::cos:   result = kernels.cos (args[0]); break;
+            case AST::Intrinsic::Type::exp:   result = kernels.exp (args[0]); break;
+            case AST::Intrinsic::Type::log:   result = kernels.log (args[0]); break;
+            case AST::Intrinsic::Type::pow:   result = kernels.pow (args[0], args[1]); break;
+            default:                          break;
+        }
+
+        b.setFastMathFlags (savedFlags);
+        return result;
+    }
+
     template <typename FunctionCallArgList>
     ValueReader createIntrinsicCall (AST::Intrinsic::Type intrinsic, FunctionCallArgList argValues, const AST::TypeBase& returnType)
     {
@@ -1576,6 +1645,12 @@ struct LLVMCodeGenerator
                 args.push_back (dereference (arg.valueReader));
         }
 
+        // With fast-maths enabled, vectors of float32 use our own approximations rather
+        // than the LLVM intrinsics, which would end up as a libm call for each element
+        if (useFastMaths && ! args.empty() && VectorMathKernels::canHandle (args.front()->getType()))
+            if (auto result = createVectorMathKernel (intrinsic, args))
+                return makeReader (result, returnType);
+
         switch (intrinsic)
         {
             case AST::Intrinsic::Type::abs:           return createIntrinsicCall (::llvm::Intrinsic::fabs,   args, returnType);
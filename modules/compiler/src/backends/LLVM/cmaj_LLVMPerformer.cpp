@@ -38,7 +38,11 @@
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/PassInstrumentation.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/LLJIT.h"
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
@@ -51,6 +55,7 @@
 #include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/MC/TargetRegistry.h"
+#include "llvm/ProfileData/ProfileCommon.h"
 
 #include "choc/platform/choc_ReenableAllWarnings.h"
 #include "choc/memory/choc_AlignedMemoryBlock.h"
@@ -84,7 +89,7 @@ static void initialiseLLVM()
 
 struct LLJITHolder
 {
-    LLJITHolder (int optimisationLevel)
+    LLJITHolder (int optimisationLevel, ::llvm::ObjectCache* objectCache = nullptr)
     {
         ::llvm::sys::DynamicLibrary::LoadLibraryPermanently (nullptr);
 
@@ -101,6 +106,22 @@ struct LLJITHolder
             ::llvm::orc::LLJITBuilder builder;
             builder.setJITTargetMachineBuilder (machineBuilder.get());
 
+            // If we've been given an object cache, we need to provide our own compiler so that
+            // the object code it produces gets passed to the cache
+            if (objectCache != nullptr)
+            {
+                builder.setCompileFunctionCreator ([objectCache] (::llvm::orc::JITTargetMachineBuilder jtmb)
+                                                     -> ::llvm::Expected<std::unique_ptr<::llvm::orc::IRCompileLayer::IRCompiler>>
+                {
+                    auto targetMachine = jtmb.createTargetMachine();
+
+                    if (! targetMachine)
+                        return targetMachine.takeError();
+
+                    return std::make_unique<::llvm::orc::TMOwningSimpleCompiler> (std::move (*targetMachine), objectCache);
+                });
+            }
+
             // Avoid the special case ObjectLinkingLayer created by lljit when it's the wrong thing to do
             if (targetTriple.isOSBinFormatMachO())
             {
@@ -137,6 +158,14 @@ struct LLJITHolder
         CMAJ_ASSERT (! err);
     }
 
+    void load (std::unique_ptr<::llvm::MemoryBuffer> objectCode)
+    {
+        auto err = lljit->addObjectFile (std::move (objectCode));
+        CMAJ_ASSERT (! err);
+        err = lljit->initialize (lljit->getMainJITDylib());
+        CMAJ_ASSERT (! err);
+    }
+
     void addExternalFunctionSymbols (const std::unordered_map<std::string, void*>& functionPointers)
     {
         auto& processSymbols = lljit->getMainJITDylib();
@@ -173,6 +202,18 @@ struct LLJITHolder
     std::string getTargetTriple() const         { return lljit->getTargetTriple().normalize(); }
     const ::llvm::DataLayout& getDataLayout()   { return lljit->getDataLayout(); }
 
+    /// Returns a string describing the host's triple, CPU and feature flags, which
+    /// must be taken into account when deciding whether native code can be re-used.
+    static std::string getHostMachineDescription()
+    {
+        if (auto machineBuilder = ::llvm::orc::JITTargetMachineBuilder::detectHost())
+            return machineBuilder->getTargetTriple().normalize()
+                    + " " + machineBuilder->getCPU()
+                    + " " + machineBuilder->getFeatures().getString();
+
+        return {};
+    }
+
 private:
     std::unique_ptr<::llvm::orc::LLJIT> lljit;
 
@@ -209,6 +250,8 @@ struct LLVMEngine
     static constexpr bool usesDynamicRateAndSessionID = false;
     static constexpr bool allowTopLevelSlices = false;
     static constexpr bool supportsExternalFunctions = true;
+    static constexpr bool supportsTieredCompilation = true;
+    static constexpr bool canShareLinkedCode = true;
     static bool engineSupportsIntrinsic (AST::Intrinsic::Type) { return true; }
 
     using InitialiseFn       = void*(*)(void*, int32_t*, int32_t, double);
@@ -221,9 +264,29 @@ struct LLVMEngine
     {
         LinkedCode (LLVMEngine& llvmEngine, bool isSingleFrameOnly, double latencyToUse,
                     CacheDatabaseInterface* cache, const char* cacheKey)
-           : lljit (llvmEngine.engine.buildSettings.getOptimisationLevel()),
+           : objectCodeCache (stringDictionary),
+             lljit (shouldUseTieredCompilation (llvmEngine) ? firstTierOptimisationLevel
+                                                            : llvmEngine.engine.buildSettings.getOptimisationLevel(),
+                    shouldCacheObjectCode (llvmEngine, cache) ? std::addressof (objectCodeCache) : nullptr),
              latency (latencyToUse)
         {
+            usesTieredCompilation = shouldUseTieredCompilation (llvmEngine);
+            usesProfileGuidedOptimisation = shouldUseProfileGuidedOptimisation (llvmEngine);
+
+            // A tiered build is all about starting quickly without a cache, and the code that
+            // we'd store would only be the unoptimised version, so the caches aren't used
+            if (usesTieredCompilation)
+                cache = nullptr;
+
+            // A profile-guided build only stores code in the cache once it has been optimised
+            // with a profile, and keeps the profile itself in an entry next to it
+            if (usesProfileGuidedOptimisation && cache != nullptr)
+            {
+                profileCache = cache;
+                profileCacheKey = std::string (cacheKey) + "_profile";
+                codeCacheKey = cacheKey;
+            }
+
             LLVMCodeGenerator codeGen (*llvmEngine.engine.program,
                                        llvmEngine.engine.buildSettings,
                                        lljit.getTargetTriple(),
@@ -233,9 +296,46 @@ struct LLVMEngine
 
             codeGen.addNativeOverriddenFunctions (llvmEngine.engine.program->externalFunctionManager);
 
-            bool loadedFromCache = loadFromCache (codeGen, cache, cacheKey);
+            std::unique_ptr<::llvm::MemoryBuffer> cachedObjectCode;
+            bool loadedFromCache = false;
 
-            if (! (loadedFromCache || codeGen.generate()))
+            if (shouldCacheObjectCode (llvmEngine, cache))
+            {
+                objectCodeCache.cache = cache;
+                objectCodeCache.key = getObjectCodeCacheKey (cacheKey);
+                cachedObjectCode = objectCodeCache.loadObjectCode (codeGen);
+                loadedFromCache = cachedObjectCode != nullptr;
+            }
+
+            if (! loadedFromCache)
+                loadedFromCache = loadFromCache (codeGen, cache, cacheKey);
+
+            std::string bitcodeForSecondTier;
+
+            if (usesTieredCompilation)
+            {
+                if (! codeGen.generate (firstTierOptimisationLevel))
+                    CMAJ_ASSERT_FALSE;
+
+                bitcodeForSecondTier = codeGen.getBitcode();
+            }
+            else if (usesProfileGuidedOptimisation && loadedFromCache)
+            {
+                // The cache only ever holds the code that was re-compiled with a profile
+                usingStoredProfile = true;
+            }
+            else if (usesProfileGuidedOptimisation)
+            {
+                if (! codeGen.generate (firstTierOptimisationLevel))
+                    CMAJ_ASSERT_FALSE;
+
+                bitcodeForSecondTier = codeGen.getBitcode();
+
+                auto& program = *llvmEngine.engine.program;
+                auto timer = program.compileProfile.measure ("llvm", "optimise", program.allocator);
+                optimiseWithProfile (*codeGen.targetModule, llvmEngine.engine.buildSettings.getOptimisationLevel());
+            }
+            else if (! (loadedFromCache || codeGen.generate()))
             {
                 CMAJ_ASSERT_FALSE;
             }
@@ -251,29 +351,360 @@ struct LLVMEngine
                 throwError (Errors::failedToLink ("Memory alignment requirements not met"));
 
             initialiseEndpointHandlers (codeGen, llvmEngine.engine.endpointHandles);
+            createStateLayout (codeGen);
+
+            // Every layout that the performers need has now been created. The code generator is
+            // about to be deleted, and this object may be shared with engines that have different
+            // programs, so from now on layouts can only be looked up by their choc type.
+            nativeTypeLayouts.createLayout = {};
+
+            // Instrumented code is never cached: the profiled re-compile stores its own code later
+            bool isInstrumented = usesProfileGuidedOptimisation && ! usingStoredProfile;
 
-            if (cache != nullptr && ! loadedFromCache)
+            if (cache != nullptr && ! loadedFromCache && ! isInstrumented)
                 codeGen.saveBitcodeToCache (*cache, cacheKey);
 
             lljit.addExternalFunctionSymbols (codeGen.externalFunctionPointers);
-            lljit.load (codeGen.takeCompiledModule());
 
-            loadFunction (initialiseFn, LLVMCodeGenerator::getInitFunctionName());
+            {
+                // The JIT compiles the module to machine code when its symbols are first looked up
+                auto& program = *llvmEngine.engine.program;
+                auto timer = program.compileProfile.measure ("llvm", "machineCode", program.allocator);
+
+                if (cachedObjectCode != nullptr)
+                    lljit.load (std::move (cachedObjectCode));
+                else
+                    lljit.load (codeGen.takeCompiledModule());
+
+                loadFunction (initialiseFn, LLVMCodeGenerator::getInitFunctionName());
 
-            if (isSingleFrameOnly)
-                loadFunction (advanceOneFrameFn, LLVMCodeGenerator::getAdvanceOneFrameFunctionName());
+                if (isSingleFrameOnly)
+                    loadFunction (advanceOneFrameFn, LLVMCodeGenerator::getAdvanceOneFrameFunctionName());
+                else
+                    loadFunction (advanceBlockFn, LLVMCodeGenerator::getAdvanceBlockFunctionName());
+
+                for (auto& e : inputValues)
+                    loadFunction (e.setValue, e.setValueFnName);
+            }
+
+            if (usesTieredCompilation)
+                startSecondTier (std::move (bitcodeForSecondTier), codeGen.externalFunctionPointers,
+                                 llvmEngine.engine.buildSettings.getOptimisationLevel(), isSingleFrameOnly);
+
+            if (usesProfileGuidedOptimisation && ! usingStoredProfile)
+                startProfileGuidedRecompile (std::move (bitcodeForSecondTier), codeGen.externalFunctionPointers,
+                                             llvmEngine.engine.buildSettings.getOptimisationLevel(), isSingleFrameOnly,
+                                             llvmEngine.engine.buildSettings.getProfileWarmUpFrames());
+        }
+
+        ~LinkedCode()
+        {
+            // A re-compile can take a long time, so rather than letting it finish, we tell its
+            // thread to give up. The optimiser checks the flag before each of its passes, so
+            // the join only has to wait for whichever pass is currently running.
+            if (secondTier != nullptr)
+            {
+                secondTier->cancelled = true;
+
+                if (secondTierThread.joinable())
+                    secondTierThread.join();
+            }
+        }
+
+        //==============================================================================
+        /// The state that's shared between a LinkedCode and the thread that re-compiles
+        /// its advance function.
+        struct SecondTier
+        {
+            std::unique_ptr<LLJITHolder> jit;
+            std::atomic<bool> ready { false };
+            AdvanceOneFrameFn advanceOneFrameFn = {};
+            AdvanceBlockFn    advanceBlockFn = {};
+            CompilePerformanceTimes::Seconds compileTime {};
+            std::atomic<uint64_t> framesRendered { 0 };
+
+            /// This is set when the LinkedCode is deleted, which then waits for the thread to finish.
+            std::atomic<bool> cancelled { false };
+        };
+
+        //==============================================================================
+        /// In a tiered build, the code is first linked with minimal optimisation so that it
+        /// can start running straight away, and then a thread re-compiles it at the level
+        /// that the build settings asked for. Performers switch to the optimised version at
+        /// the start of their next block once it's ready.
+        /// Only the advance function is replaced: the event handlers and other entry points
+        /// use the same state layout, so can carry on using the first-tier code.
+        void startSecondTier (std::string bitcode, std::unordered_map<std::string, void*> externalFunctions,
+                              int optimisationLevel, bool isSingleFrameOnly)
+        {
+            secondTier = std::make_shared<SecondTier>();
+
+            secondTierThread = std::thread ([state = secondTier, bitcode = std::move (bitcode), externalFunctions = std::move (externalFunctions),
+                                             optimisationLevel, isSingleFrameOnly]
+            {
+                compileSecondTier (*state, bitcode, externalFunctions, optimisationLevel, isSingleFrameOnly, nullptr, {});
+            });
+        }
+
+        static void compileSecondTier (SecondTier& state, const std::string& bitcode,
+                                       const std::unordered_map<std::string, void*>& externalFunctions,
+                                       int optimisationLevel, bool isSingleFrameOnly, const BlockProfile* profile,
+                                       const std::function<void(const ::llvm::Module&)>& storeOptimisedModule)
+        {
+            try
+            {
+                auto startTime = CompilePerformanceTimes::Clock::now();
+                auto context = std::make_unique<::llvm::LLVMContext>();
+                auto buffer = ::llvm::MemoryBuffer::getMemBuffer (bitcode, {}, false);
+                auto module = ::llvm::parseBitcodeFile (buffer->getMemBufferRef(), *context);
+
+                if (! module)
+                {
+                    ::llvm::consumeError (module.takeError());
+                    return;
+                }
+
+                if (profile != nullptr && ! profile->matches (**module))
+                    return;
+
+                if (state.cancelled)
+                    return;
+
+                LLVMCodeGenerator::applyOptimisationPasses (**module, optimisationLevel, profile,
+                                                            std::addressof (state.cancelled));
+
+                if (state.cancelled)
+                    return;
+
+                if (storeOptimisedModule)
+                    storeOptimisedModule (**module);
+
+                auto jit = std::make_unique<LLJITHolder> (optimisationLevel);
+                jit->addExternalFunctionSymbols (externalFunctions);
+                jit->load (::llvm::orc::ThreadSafeModule (std::move (*module), std::move (context)));
+
+                if (isSingleFrameOnly)
+                    state.advanceOneFrameFn = reinterpret_cast<AdvanceOneFrameFn> (jit->findSymbol (LLVMCodeGenerator::getAdvanceOneFrameFunctionName()));
+                else
+                    state.advanceBlockFn = reinterpret_cast<AdvanceBlockFn> (jit->findSymbol (LLVMCodeGenerator::getAdvanceBlockFunctionName()));
+
+                if (state.cancelled || (state.advanceOneFrameFn == nullptr && state.advanceBlockFn == nullptr))
+                    return;
+
+                state.jit = std::move (jit);
+                state.compileTime = CompilePerformanceTimes::Clock::now() - startTime;
+                state.ready.store (true, std::memory_order_release);
+            }
+            catch (...)
+            {
+                // If anything goes wrong, we'll just keep running the first-tier code
+            }
+        }
+
+        //==============================================================================
+        /// In a profile-guided build, the first link is optimised as normal, but has a
+        /// counter added to each basic block. Once the performers have rendered enough
+        /// frames, a thread takes a snapshot of the counters, stores it in the cache,
+        /// and re-compiles the advance function with the profile's branch weights, which
+        /// then takes over in the same way as a tiered build's second tier. The re-compiled
+        /// module is also stored in the cache under the normal key.
+        /// When the cache holds that code, or a stored profile for the program, it's used
+        /// for the first link, and none of this is needed.
+        void startProfileGuidedRecompile (std::string bitcode, std::unordered_map<std::string, void*> externalFunctions,
+                                          int optimisationLevel, bool isSingleFrameOnly, uint32_t warmUpFrames)
+        {
+            auto profileCounters = lljit.findSymbol (BlockProfile::counterArrayName);
+
+            if (profileCounters == nullptr)
+                return;
+
+            secondTier = std::make_shared<SecondTier>();
+
+            secondTierThread = std::thread ([state = secondTier, bitcode = std::move (bitcode), externalFunctions = std::move (externalFunctions),
+                                             optimisationLevel, isSingleFrameOnly, warmUpFrames, profileCounters,
+                                             profile = std::move (blockProfile), cache = profileCache, profileKey = profileCacheKey,
+                                             codeKey = codeCacheKey, dictionary = stringDictionary] () mutable
+            {
+                while (state->framesRendered.load (std::memory_order_relaxed) < warmUpFrames)
+                {
+                    if (state->cancelled)
+                        return;
+
+                    std::this_thread::sleep_for (std::chrono::milliseconds (20));
+                }
+
+                // The counters live in the first-tier JIT, which the LinkedCode keeps alive
+                // until this thread has been joined
+                profile.readCounters (profileCounters);
+
+                std::function<void(const ::llvm::Module&)> storeOptimisedModule;
+
+                if (cache && ! state->cancelled)
+                {
+                    auto profileData = profile.serialise();
+                    cache->store (profileKey.c_str(), profileData.data(), profileData.size());
+
+                    storeOptimisedModule = [&] (const ::llvm::Module& module)
+                    {
+                        ::llvm::SmallVector<char, 64> data;
+
+                        {
+                            ::llvm::raw_svector_ostream s (data);
+                            LLVMCodeGenerator::writeDictionary (s, dictionary);
+                            ::llvm::WriteBitcodeToFile (module, s);
+                        }
+
+                        cache->store (codeKey.c_str(), data.data(), data.size());
+                    };
+                }
+
+                compileSecondTier (*state, bitcode, externalFunctions, optimisationLevel, isSingleFrameOnly,
+                                   std::addressof (profile), storeOptimisedModule);
+            });
+        }
+
+        void optimiseWithProfile (::llvm::Module& module, int optimisationLevel)
+        {
+            if (loadStoredProfile() && blockProfile.matches (module))
+            {
+                usingStoredProfile = true;
+                LLVMCodeGenerator::applyOptimisationPasses (module, optimisationLevel, std::addressof (blockProfile));
+            }
             else
-                loadFunction (advanceBlockFn, LLVMCodeGenerator::getAdvanceBlockFunctionName());
+            {
+                blockProfile = BlockProfile::instrument (module);
+                LLVMCodeGenerator::applyOptimisationPasses (module, optimisationLevel);
+            }
+        }
+
+        bool loadStoredProfile()
+        {
+            if (profileCache)
+            {
+                if (auto cachedSize = profileCache->reload (profileCacheKey.c_str(), nullptr, 0))
+                {
+                    std::vector<char> loaded;
+                    loaded.resize (cachedSize);
+
+                    if (profileCache->reload (profileCacheKey.c_str(), loaded.data(), cachedSize) == cachedSize)
+                        return blockProfile.deserialise (choc::span<const char> (loaded));
+                }
+            }
+
+            return false;
+        }
+
+        std::string getTieredCompilationLog() const
+        {
+            if (usesProfileGuidedOptimisation)
+            {
+                if (usingStoredProfile)
+                    return "\nProfile-guided optimisation: using a stored profile";
+
+                if (secondTier != nullptr && secondTier->ready.load (std::memory_order_acquire))
+                    return "\nProfile-guided optimisation: instrumented link, followed by a profiled re-compile";
 
-            for (auto& e : inputValues)
-                loadFunction (e.setValue, e.setValueFnName);
+                return "\nProfile-guided optimisation: instrumented link, profiled re-compile waiting for warm-up";
+            }
+
+            if (! usesTieredCompilation)
+                return {};
+
+            auto log = "\nTiered compilation: -O" + std::to_string (firstTierOptimisationLevel) + " link";
+
+            if (secondTier != nullptr && secondTier->ready.load (std::memory_order_acquire))
+                return log + ", followed by an optimised re-compile";
+
+            return log + ", optimised re-compile in progress";
+        }
+
+        /// Adds the time taken by the background re-compile, once it has finished.
+        void addSecondTierCompileTime (CompilePerformanceTimes& times) const
+        {
+            if (secondTier != nullptr && secondTier->ready.load (std::memory_order_acquire))
+                times.addCategory (usesProfileGuidedOptimisation ? "profiled re-compile" : "optimised re-compile",
+                                   secondTier->compileTime);
+        }
+
+        static bool shouldUseTieredCompilation (LLVMEngine& llvmEngine)
+        {
+            auto& settings = llvmEngine.engine.buildSettings;
+
+            return settings.shouldUseTieredCompilation()
+                    && ! shouldUseProfileGuidedOptimisation (llvmEngine)
+                    && LLVMCodeGenerator::getOptimisationLevelWithDefault (settings.getOptimisationLevel()) > firstTierOptimisationLevel;
+        }
+
+        static bool shouldUseProfileGuidedOptimisation (LLVMEngine& llvmEngine)
+        {
+            auto& settings = llvmEngine.engine.buildSettings;
+
+            return settings.getProfileWarmUpFrames() != 0
+                    && LLVMCodeGenerator::getOptimisationLevelWithDefault (settings.getOptimisationLevel()) > 0;
         }
 
         //==============================================================================
-        LLJITHolder lljit;
+        /// Receives the relocatable object file that the JIT produces for our module,
+        /// and stores it (along with the string dictionary) in the cache database,
+        /// so that a later link of the same program can skip code generation entirely.
+        struct ObjectCodeCache  : public ::llvm::ObjectCache
+        {
+            ObjectCodeCache (choc::value::SimpleStringDictionary& d) : stringDictionary (d) {}
+
+            void notifyObjectCompiled (const ::llvm::Module*, ::llvm::MemoryBufferRef objectCode) override
+            {
+                if (cache == nullptr)
+                    return;
+
+                ::llvm::SmallVector<char, 64> data;
+
+                {
+                    ::llvm::raw_svector_ostream s (data);
+                    LLVMCodeGenerator::writeDictionary (s, stringDictionary);
+                    s << objectCode.getBuffer();
+                }
+
+                cache->store (key.c_str(), data.data(), data.size());
+            }
+
+            std::unique_ptr<::llvm::MemoryBuffer> getObject (const ::llvm::Module*) override
+            {
+                // Cached objects are added directly to the JIT rather than being
+                // substituted here, so that the IR never needs to be generated
+                return {};
+            }
+
+            std::unique_ptr<::llvm::MemoryBuffer> loadObjectCode (LLVMCodeGenerator& codeGen)
+            {
+                if (auto cachedSize = cache->reload (key.c_str(), nullptr, 0))
+                {
+                    std::vector<char> loaded;
+                    loaded.resize (cachedSize);
+
+                    if (cache->reload (key.c_str(), loaded.data(), cachedSize) == cachedSize)
+                    {
+                        choc::span<char> objectCode (loaded);
+
+                        if (codeGen.reloadDictionary (objectCode) && ! objectCode.empty())
+                            return ::llvm::MemoryBuffer::getMemBufferCopy ({ objectCode.data(), objectCode.size() }, key);
+                    }
+                }
+
+                return {};
+            }
+
+            choc::value::SimpleStringDictionary& stringDictionary;
+            CacheDatabaseInterface* cache = nullptr;
+            std::string key;
+        };
+
+        //==============================================================================
         choc::value::SimpleStringDictionary stringDictionary;
+        ObjectCodeCache objectCodeCache;
+        LLJITHolder lljit;
         NativeTypeLayoutCache nativeTypeLayouts;
         size_t stateSize = 0, ioSize = 0;
+        std::string stateLayout;
         static constexpr size_t alignmentBytes = 128;
 
         double latency;
@@ -282,6 +713,16 @@ struct LLVMEngine
         AdvanceOneFrameFn   advanceOneFrameFn = {};
         AdvanceBlockFn      advanceBlockFn = {};
 
+        static constexpr int firstTierOptimisationLevel = 0;
+        bool usesTieredCompilation = false;
+        std::shared_ptr<SecondTier> secondTier;
+        std::thread secondTierThread;
+
+        bool usesProfileGuidedOptimisation = false, usingStoredProfile = false;
+        BlockProfile blockProfile;
+        CacheDatabaseInterface::Ptr profileCache;
+        std::string profileCacheKey, codeCacheKey;
+
         //==============================================================================
         struct InputStreamEndpoint
         {
@@ -334,6 +775,22 @@ struct LLVMEngine
         std::vector<OutputValueEndpoint>  outputValues;
         std::vector<OutputEventEndpoint>  outputEvents;
 
+        static bool shouldCacheObjectCode (LLVMEngine& llvmEngine, CacheDatabaseInterface* cache)
+        {
+            return cache != nullptr
+                    && llvmEngine.engine.buildSettings.shouldCacheObjectCode()
+                    && ! shouldUseTieredCompilation (llvmEngine)
+                    && ! shouldUseProfileGuidedOptimisation (llvmEngine);
+        }
+
+        static std::string getObjectCodeCacheKey (const char* cacheKey)
+        {
+            // Native code is only valid for the exact CPU it was generated for
+            choc::hash::xxHash64 hash;
+            hash.addInput (LLJITHolder::getHostMachineDescription());
+            return std::string (cacheKey) + "_obj_" + choc::text::createHexString (hash.getHash());
+        }
+
         static bool loadFromCache (LLVMCodeGenerator& codeGen, CacheDatabaseInterface* cache, const char* key)
         {
             if (cache != nullptr)
@@ -351,6 +808,72 @@ struct LLVMEngine
             return false;
         }
 
+        //==============================================================================
+        /// Describes the leaf variables in the state struct, using their native offsets,
+        /// so that a host can match up the state of two different builds of a program.
+        void createStateLayout (LLVMCodeGenerator& codeGen)
+        {
+            auto members = choc::value::createEmptyArray();
+            addStateLayoutMembers (codeGen, members, *codeGen.stateStruct, {}, 0);
+            stateLayout = choc::json::toString (members);
+        }
+
+        static bool containsStringHandle (const AST::TypeBase& type)
+        {
+            auto& t = type.skipConstAndRefModifiers();
+
+            if (t.isPrimitiveString())
+                return true;
+
+            if (auto a = t.getAsArrayType())
+                return containsStringHandle (a->getInnermostElementTypeRef());
+
+            if (auto s = t.getAsStructType())
+                for (size_t i = 0; i < s->memberNames.size(); ++i)
+                    if (containsStringHandle (s->getMemberType (i)))
+                        return true;
+
+            return false;
+        }
+
+        static void addStateLayoutMembers (LLVMCodeGenerator& codeGen, choc::value::Value& members,
+                                           const AST::StructType& structType, const std::string& parentName, size_t parentOffset)
+        {
+            for (size_t i = 0; i < structType.memberNames.size(); ++i)
+            {
+                auto& type = structType.getMemberType (i);
+                auto memberName = structType.getMemberName (i);
+                auto nameText = memberName.get();
+
+                // Names beginning with an underscore are reserved, so these members were added by the
+                // compiler, e.g. the point at which to resume after an advance() call, or locals that
+                // were moved into the state. They only make sense to the code that created them. The
+                // exception is the member that holds the state of a wrapped processor.
+                if (! nameText.empty() && nameText[0] == '_' && memberName != structType.getStrings()._state)
+                    continue;
+
+                // Slices point into memory that belongs to a particular instance, and strings are
+                // handles into that instance's string dictionary, so neither can be copied
+                if (type.containsSlice() || containsStringHandle (type))
+                    continue;
+
+                auto name = parentName + std::string (nameText);
+                auto offset = parentOffset + codeGen.getStructMemberOffset (structType, static_cast<uint32_t> (i));
+
+                if (auto memberStruct = type.getAsStructType())
+                {
+                    addStateLayoutMembers (codeGen, members, *memberStruct, name + ".", offset);
+                    continue;
+                }
+
+                members.addArrayElement (choc::value::createObject ("StateMember",
+                                                                    "name", name,
+                                                                    "type", type.getLayoutSignature(),
+                                                                    "offset", static_cast<int64_t> (offset),
+                                                                    "size", static_cast<int64_t> (codeGen.getTypeSize (type))));
+            }
+        }
+
         //==============================================================================
         void initialiseEndpointHandlers (LLVMCodeGenerator& codeGen, const std::vector<EndpointInfo>& endpointArray)
         {
@@ -468,6 +991,7 @@ struct LLVMEngine
 
             advanceOneFrameFn = code->advanceOneFrameFn;
             advanceBlockFn = code->advanceBlockFn;
+            waitingForSecondTier = code->secondTier != nullptr;
         }
 
         //==============================================================================
@@ -479,68 +1003,92 @@ struct LLVMEngine
 
         uint8_t* statePointer = nullptr;
         uint8_t* ioPointer = nullptr;
+        bool waitingForSecondTier = false;
+        choc::memory::Pool dispatchState;
 
         //==============================================================================
         void advance (uint32_t framesToAdvance) noexcept
         {
+            if (waitingForSecondTier)
+            {
+                code->secondTier->framesRendered.fetch_add (framesToAdvance, std::memory_order_relaxed);
+                switchToSecondTierIfReady();
+            }
+
             if (advanceOneFrameFn)
                 advanceOneFrameFn (statePointer, ioPointer);
             else
                 advanceBlockFn (statePointer, ioPointer, framesToAdvance);
         }
 
-        std::function<void(void*, uint32_t)> createCopyOutputValueFunction (const EndpointInfo& e)
+        void switchToSecondTierIfReady() noexcept
         {
-            if (e.details.isStream())
+            auto& secondTier = *code->secondTier;
+
+            if (secondTier.ready.load (std::memory_order_acquire))
             {
-                auto& info = code->getEndpointInfo (code->outputStreams, e.handle);
-                auto* source = ioPointer + info.addressOffset;
-                auto destStride = info.frameSize;
-                auto sourceStride = info.frameStride;
+                if (secondTier.advanceOneFrameFn != nullptr)
+                    advanceOneFrameFn = secondTier.advanceOneFrameFn;
 
-                if (destStride == sourceStride)
-                {
-                    return [source, destStride] (void* destBuffer, uint32_t numFrames)
-                    {
-                        memcpy (destBuffer, source, destStride * numFrames);
-                        memset (source, 0, destStride * numFrames);
-                    };
-                }
-                else
-                {
-                    auto* frameLayout = info.frameLayout.get();
+                if (secondTier.advanceBlockFn != nullptr)
+                    advanceBlockFn = secondTier.advanceBlockFn;
 
-                    return [source, destStride, sourceStride, frameLayout] (void* destBuffer, uint32_t numFrames)
-                    {
-                        auto dest = static_cast<uint8_t*> (destBuffer);
-                        auto src = source;
+                waitingForSecondTier = false;
+            }
+        }
 
-                        for (uint32_t i = 0; i < numFrames; ++i)
-                        {
-                            frameLayout->copyNativeToPacked (dest, src);
-                            dest += destStride;
-                            src += sourceStride;
-                        }
+        DispatchFunction<void(void*, uint32_t)> createCopyOutputValueFunction (const EndpointInfo& e)
+        {
+            using Signature = void(void*, uint32_t);
 
-                        memset (source, 0, sourceStride * numFrames);
-                    };
-                }
-            }
-            else
+            if (! e.details.isStream())
             {
                 auto& info = code->getEndpointInfo (code->outputValues, e.handle);
                 auto* source = statePointer + info.addressOffset;
-                auto layout = info.layout.get();
+                auto* layout = info.layout.get();
 
-                return [layout, source] (void* destBuffer, uint32_t)
+                return createDispatchFunction<Signature> ([source, layout] (void* destBuffer, uint32_t)
                 {
                     layout->copyNativeToPacked (destBuffer, source);
-                };
+                });
+            }
+
+            auto& info = code->getEndpointInfo (code->outputStreams, e.handle);
+            auto* source = ioPointer + info.addressOffset;
+            auto destStride = info.frameSize;
+            auto sourceStride = info.frameStride;
+
+            if (destStride == sourceStride)
+            {
+                return createDispatchFunction<Signature> ([source, destStride] (void* destBuffer, uint32_t numFrames)
+                {
+                    memcpy (destBuffer, source, destStride * numFrames);
+                    memset (source, 0, destStride * numFrames);
+                });
             }
+
+            auto* layout = info.frameLayout.get();
+
+            return createDispatchFunction<Signature> ([source, destStride, sourceStride, layout] (void* destBuffer, uint32_t numFrames)
+            {
+                auto dest = static_cast<uint8_t*> (destBuffer);
+                auto src = source;
+
+                for (uint32_t i = 0; i < numFrames; ++i)
+                {
+                    layout->copyNativeToPacked (dest, src);
+                    dest += destStride;
+                    src += sourceStride;
+                }
+
+                memset (source, 0, sourceStride * numFrames);
+            });
         }
 
-        std::function<void(const void*, uint32_t, uint32_t)> createSetInputStreamFramesFunction (const EndpointInfo& e)
+        DispatchFunction<void(const void*, uint32_t, uint32_t)> createSetInputStreamFramesFunction (const EndpointInfo& e)
         {
+            using Signature = void(const void*, uint32_t, uint32_t);
+
             auto& info = code->getEndpointInfo (code->inputStreams, e.handle);
             auto* dest = ioPointer + info.addressOffset;
             auto destStride = info.frameStride;
@@ -548,36 +1096,30 @@ struct LLVMEngine
 
             if (destStride == sourceStride)
             {
-                return [dest, destStride] (const void* sourceData, uint32_t numFrames, uint32_t numTrailingFramesToClear)
+                return createDispatchFunction<Signature> ([dest, destStride] (const void* sourceData, uint32_t numFrames, uint32_t numTrailingFramesToClear)
                 {
-                    auto source = static_cast<const uint8_t*> (sourceData);
                     auto size = destStride * numFrames;
-                    memcpy (dest, source, size);
-
-                    if (numTrailingFramesToClear != 0)
-                        memset (dest + size, 0, numTrailingFramesToClear * destStride);
-                };
+                    memcpy (dest, sourceData, size);
+                    memset (dest + size, 0, numTrailingFramesToClear * destStride);
+                });
             }
-            else
+
+            auto* frameLayout = info.frameLayout.get();
+
+            return createDispatchFunction<Signature> ([dest, destStride, sourceStride, frameLayout] (const void* sourceData, uint32_t numFrames, uint32_t numTrailingFramesToClear)
             {
-                auto* frameLayout = info.frameLayout.get();
+                auto source = static_cast<const uint8_t*> (sourceData);
+                auto d = dest;
 
-                return [dest, destStride, sourceStride, frameLayout] (const void* sourceData, uint32_t numFrames, uint32_t numTrailingFramesToClear)
+                for (uint32_t i = 0; i < numFrames; ++i)
                 {
-                    auto source = static_cast<const uint8_t*> (sourceData);
-                    auto d = dest;
-
-                    for (uint32_t i = 0; i < numFrames; ++i)
-                    {
-                        frameLayout->copyPackedToNative (d, source);
-                        d += destStride;
-                        source += sourceStride;
-                    }
+                    frameLayout->copyPackedToNative (d, source);
+                    d += destStride;
+                    source += sourceStride;
+                }
 
-                    if (numTrailingFramesToClear != 0)
-                        memset (d, 0, numTrailingFramesToClear * destStride);
-                };
-            }
+                memset (d, 0, numTrailingFramesToClear * destStride);
+            });
         }
 
         auto createSetInputValueFunction (const EndpointInfo& e)
@@ -596,42 +1138,53 @@ struct LLVMEngine
             };
         }
 
-        std::function<void(const void*)> createSendEventFunction (const EndpointInfo&, const AST::TypeBase& type, const AST::Function& f)
+        DispatchFunction<void(const void*)> createSendEventFunction (const EndpointInfo&, const AST::TypeBase& type, const AST::Function& f)
         {
-            auto eventType = type.toChocType();
+            using Signature = void(const void*);
+
             auto name = AST::getEventHandlerFunctionName (f);
             auto state = statePointer;
 
             void* call = code->lljit.findSymbol (name);
             CMAJ_ASSERT (call != nullptr);
 
-            if (type.isVoid())              return [call, state] (const void*)      { using F = void(*)(void*);           reinterpret_cast<F> (call) (state); };
-            if (type.isPrimitiveInt32())    return [call, state] (const void* data) { using F = void(*)(void*, int32_t);  reinterpret_cast<F> (call) (state, *static_cast<const int32_t*>  (data)); };
-            if (type.isPrimitiveInt64())    return [call, state] (const void* data) { using F = void(*)(void*, int64_t);  reinterpret_cast<F> (call) (state, *static_cast<const int64_t*>  (data)); };
-            if (type.isPrimitiveFloat32())  return [call, state] (const void* data) { using F = void(*)(void*, float);    reinterpret_cast<F> (call) (state, *static_cast<const float*>    (data)); };
-            if (type.isPrimitiveFloat64())  return [call, state] (const void* data) { using F = void(*)(void*, double);   reinterpret_cast<F> (call) (state, *static_cast<const double*>   (data)); };
-            if (type.isPrimitiveBool())     return [call, state] (const void* data) { using F = void(*)(void*, int32_t);  reinterpret_cast<F> (call) (state, *static_cast<const int32_t*>  (data)); };
-            if (type.isPrimitiveString())   return [call, state] (const void* data) { using F = void(*)(void*, uint32_t); reinterpret_cast<F> (call) (state, *static_cast<const uint32_t*> (data)); };
-
-            auto& layout = *code->nativeTypeLayouts.find (type);
-
-            if (layout.requiresPacking())
+            auto createPrimitiveCall = [&] (auto primitiveValue)
             {
-                choc::AlignedMemoryBlock<16> scratch (layout.getNativeSize());
+                using PrimitiveType = decltype (primitiveValue);
+                auto fn = reinterpret_cast<void(*)(void*, PrimitiveType)> (call);
 
-                return [call, state, scratch, &layout] (const void* data) mutable
+                return createDispatchFunction<Signature> ([fn, state] (const void* data)
                 {
-                    layout.copyPackedToNative (scratch.data(), data);
-                    using F = void(*)(void*, const void*);
-                    reinterpret_cast<F> (call) (state, scratch.data());
-                };
+                    fn (state, *static_cast<const PrimitiveType*> (data));
+                });
+            };
+
+            if (type.isVoid())
+            {
+                auto fn = reinterpret_cast<void(*)(void*)> (call);
+                return createDispatchFunction<Signature> ([fn, state] (const void*) { fn (state); });
             }
 
-            return [call, state] (const void* data)
+            if (type.isPrimitiveInt32() || type.isPrimitiveBool() || type.isPrimitiveString())
+                return createPrimitiveCall (int32_t());
+
+            if (type.isPrimitiveInt64())    return createPrimitiveCall (int64_t());
+            if (type.isPrimitiveFloat32())  return createPrimitiveCall (float());
+            if (type.isPrimitiveFloat64())  return createPrimitiveCall (double());
+
+            auto fn = reinterpret_cast<void(*)(void*, const void*)> (call);
+            auto layout = code->nativeTypeLayouts.find (type);
+
+            if (! layout->requiresPacking())
+                return createDispatchFunction<Signature> ([fn, state] (const void* data) { fn (state, data); });
+
+            choc::AlignedMemoryBlock<16> scratch (layout->getNativeSize());
+
+            return createDispatchFunction<Signature> ([fn, state, layout = layout.get(), scratch] (const void* data) mutable
             {
-                using F = void(*)(void*, const void*);
-                reinterpret_cast<F> (call) (state, data);
-            };
+                layout->copyPackedToNative (scratch.data(), data);
+                fn (state, scratch.data());
+            });
         }
 
         auto createGetNumOutputEventsFunction (const EndpointInfo& e)
@@ -683,7 +1236,18 @@ struct LLVMEngine
             };
         }
 
+        /// Where a create function picks one of several specialised functors, it stores
+        /// it here and hands back the DispatchFunction, so the choice is made only once.
+        template <typename Signature, typename Functor>
+        DispatchFunction<Signature> createDispatchFunction (Functor&& functor)
+        {
+            return allocateDispatchFunction<Signature> (dispatchState, std::forward<Functor> (functor));
+        }
+
         choc::value::StringDictionary& getDictionary()  { return code->stringDictionary; }
+
+        choc::com::String* getStateLayout()             { return choc::com::createString (code->stateLayout); }
+        void* getStateMemory()                          { return statePointer; }
     };
 
     PerformerInterface* createPerformer (std::shared_ptr<LinkedCode> code)
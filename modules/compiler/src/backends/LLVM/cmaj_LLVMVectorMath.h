@@ -0,0 +1,197 @@
+//
+//     ,ad888ba,                              88
+//    d8"'    "8b
+//   d8            88,dba,,adba,   ,aPP8A.A8  88     The Cmajor Toolkit
+//   Y8,           88    88    88  88     88  88
+//    Y8a.   .a8P  88    88    88  88,   ,88  88     (C)2024 Cmajor Software Ltd
+//     '"Y888Y"'   88    88    88  '"8bbP"Y8  88     https://cmajor.dev
+//                                           ,88
+//                                        888P"
+//
+//  The Cmajor project is subject to commercial or open-source licensing.
+//  You may use it under the terms of the GPLv3 (see www.gnu.org/licenses), or
+//  visit https://cmajor.dev to learn about our commercial licence options.
+//
+//  CMAJOR IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+//  EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+//  DISCLAIMED.
+
+namespace cmaj::llvm
+{
+
+//==============================================================================
+/**
+    Emits polynomial approximations of sin, cos, exp, log and pow for vectors of
+    float32 as plain IR, so that they get vectorised along with the code around
+    them, instead of being split into a libm call for each lane.
+
+    These are only used when fast-maths is enabled. Compared with double-precision
+    libm results, the worst errors measured are:
+
+        sin, cos:   absolute error 8e-8 for |x| < 8192, and 1e-6 for |x| < 1e5.
+                    Beyond about 1e9 the range reduction fails and the result is undefined.
+        exp:        relative error 8.2e-8. Results that would underflow return 0 (or a
+                    denormal), and ones that overflow return +inf.
+        log:        absolute error 4e-8 for x in [0.5, 2], and relative error 6e-8
+                    elsewhere. log (0) is -inf, and negative values give NaN.
+        pow:        this is exp (y * log (|x|)) with the sign fixed up for negative x,
+                    so its relative error grows with |y * log (x)|. It's 2e-6 for
+                    x in [0.001, 1000] and y in [-4, 4].
+
+    NaN inputs aren't supported.
+
+    The builder must not have any fast-maths flags set while these are emitted,
+    because the range reductions depend on the exact order of their operations.
+*/
+struct VectorMathKernels
+{
+    VectorMathKernels (::llvm::IRBuilder<>& b, ::llvm::Value* firstArg)
+        : builder (b),
+          floatType (firstArg->getType()),
+          intType (::llvm::VectorType::getInteger (::llvm::cast<::llvm::VectorType> (floatType)))
+    {
+        CMAJ_ASSERT (canHandle (floatType));
+    }
+
+    static bool canHandle (::llvm::Type* type)
+    {
+        if (auto vectorType = ::llvm::dyn_cast<::llvm::FixedVectorType> (type))
+            return vectorType->getElementType()->isFloatTy() && vectorType->getNumElements() > 1;
+
+        return false;
+    }
+
+    ::llvm::Value* sin (::llvm::Value* x)      { return sinOrCos (x, 0); }
+    ::llvm::Value* cos (::llvm::Value* x)      { return sinOrCos (x, 1); }
+
+    ::llvm::Value* exp (::llvm::Value* x)
+    {
+        x = select (lessThan (x, -104.0), constant (-104.0), x);
+        x = select (greaterThan (x, 89.0), constant (89.0), x);
+
+        // exp (x) = 2^n * exp (r), where r = x - n * ln2 is in [-ln2/2, ln2/2]
+        auto n = roundToInt (mul (x, 1.44269504088896341));
+        auto r = sub (sub (x, mul (n, 0.693359375)), mul (n, -2.12194440e-4));
+
+        auto p = add (add (mul (polynomial (r, { 1.9875691500e-4, 1.3981999507e-3, 8.3334519073e-3,
+                                                 4.1665795894e-2, 1.6666665459e-1, 5.0000001201e-1 }),
+                                mul (r, r)),
+                           r),
+                      1.0);
+
+        // The scale is applied in two halves, so that results near the ends of the
+        // range don't need an exponent that's out of range for a float32
+        auto ni = builder.CreateFPToSI (n, intType);
+        auto n1 = builder.CreateAShr (ni, intConstant (1));
+        auto n2 = builder.CreateSub (ni, n1);
+
+        return mul (mul (p, powerOfTwo (n1)), powerOfTwo (n2));
+    }
+
+    ::llvm::Value* log (::llvm::Value* x)
+    {
+        // Denormals are scaled up to normal numbers first, so that splitting them into
+        // an exponent and mantissa works
+        auto isDenormal = lessThan (x, 1.17549435e-38);
+        auto scaled = select (isDenormal, mul (x, 8388608.0), x);
+
+        auto bits = builder.CreateBitCast (scaled, intType);
+        auto exponent = builder.CreateSub (builder.CreateAnd (builder.CreateLShr (bits, intConstant (23)), intConstant (0xff)), intConstant (126));
+        exponent = builder.CreateSelect (isDenormal, builder.CreateSub (exponent, intConstant (23)), exponent);
+
+        // mantissa is in [0.5, 1), and gets adjusted to be in [sqrt(0.5), sqrt(2))
+        auto mantissa = builder.CreateBitCast (builder.CreateOr (builder.CreateAnd (bits, intConstant (0x007fffff)), intConstant (0x3f000000)), floatType);
+        auto isSmall = lessThan (mantissa, 0.707106781186547524);
+        auto e = builder.CreateSIToFP (builder.CreateSelect (isSmall, builder.CreateSub (exponent, intConstant (1)), exponent), floatType);
+        auto f = select (isSmall, sub (add (mantissa, mantissa), 1.0), sub (mantissa, 1.0));
+
+        auto z = mul (f, f);
+        auto y = mul (mul (polynomial (f, { 7.0376836292e-2, -1.1514610310e-1, 1.1676998740e-1, -1.2420140846e-1, 1.4249322787e-1,
+                                            -1.6668057665e-1, 2.0000714765e-1, -2.4999993993e-1, 3.3333331174e-1 }),
+                           f),
+                       z);
+
+        y = add (y, mul (e, -2.12194440e-4));
+        y = sub (y, mul (z, 0.5));
+        auto result = add (add (f, y), mul (e, 0.693359375));
+
+        result = select (equals (x, 0.0), constant (-std::numeric_limits<double>::infinity()), result);
+        result = select (lessThan (x, 0.0), constant (std::numeric_limits<double>::quiet_NaN()), result);
+        return select (equals (x, std::numeric_limits<double>::infinity()), x, result);
+    }
+
+    ::llvm::Value* pow (::llvm::Value* x, ::llvm::Value* y)
+    {
+        auto result = exp (mul (y, log (builder.CreateUnaryIntrinsic (::llvm::Intrinsic::fabs, x))));
+
+        // A negative base only has a real result for integer exponents, with odd
+        // ones giving a negative result
+        auto yIsInteger = builder.CreateFCmpOEQ (roundToInt (y), y);
+        auto yIsOdd = builder.CreateAnd (yIsInteger, builder.CreateFCmpONE (mul (roundToInt (mul (y, 0.5)), 2.0), y));
+        auto resultForNegativeX = select (yIsInteger, select (yIsOdd, builder.CreateFNeg (result), result),
+                                          constant (std::numeric_limits<double>::quiet_NaN()));
+
+        result = select (lessThan (x, 0.0), resultForNegativeX, result);
+        return select (equals (y, 0.0), constant (1.0), result);
+    }
+
+private:
+    ::llvm::IRBuilder<>& builder;
+    ::llvm::Type* floatType;
+    ::llvm::Type* intType;
+
+    ::llvm::Value* sinOrCos (::llvm::Value* x, int32_t quadrantOffset)
+    {
+        // Reduce x to r in [-pi/4, pi/4], where x = r + q * pi/2, using pi/2 split into
+        // three parts, so that the first products are exact
+        auto q = roundToInt (mul (x, 0.636619772367581343));
+        auto r = sub (sub (sub (x, mul (q, 1.5703125)), mul (q, 4.837512969970703125e-4)), mul (q, 7.54978995489188216e-8));
+
+        auto z = mul (r, r);
+        auto sinR = add (mul (mul (polynomial (z, { -1.9515295891e-4, 8.3321608736e-3, -1.6666654611e-1 }), z), r), r);
+        auto cosR = add (sub (mul (mul (polynomial (z, { 2.443315711809948e-5, -1.388731625493765e-3, 4.166664568298827e-2 }), z), z),
+                              mul (z, 0.5)),
+                         1.0);
+
+        auto quadrant = builder.CreateAdd (builder.CreateFPToSI (q, intType), intConstant (quadrantOffset));
+        auto isOddQuadrant = builder.CreateICmpNE (builder.CreateAnd (quadrant, intConstant (1)), intConstant (0));
+        auto isNegative    = builder.CreateICmpNE (builder.CreateAnd (quadrant, intConstant (2)), intConstant (0));
+
+        auto result = select (isOddQuadrant, cosR, sinR);
+        return select (isNegative, builder.CreateFNeg (result), result);
+    }
+
+    ::llvm::Value* polynomial (::llvm::Value* x, std::initializer_list<double> coefficients)
+    {
+        ::llvm::Value* result = nullptr;
+
+        for (auto c : coefficients)
+            result = result == nullptr ? constant (c) : add (mul (result, x), c);
+
+        return result;
+    }
+
+    ::llvm::Value* powerOfTwo (::llvm::Value* exponent)
+    {
+        return builder.CreateBitCast (builder.CreateShl (builder.CreateAdd (exponent, intConstant (127)), intConstant (23)), floatType);
+    }
+
+    ::llvm::Value* roundToInt (::llvm::Value* x)                { return builder.CreateUnaryIntrinsic (::llvm::Intrinsic::rint, x); }
+    ::llvm::Value* constant (double value)                      { return ::llvm::ConstantFP::get (floatType, value); }
+    ::llvm::Value* intConstant (int32_t value)                  { return ::llvm::ConstantInt::get (intType, static_cast<uint64_t> (static_cast<int64_t> (value)), true); }
+
+    ::llvm::Value* add (::llvm::Value* a, ::llvm::Value* b)     { return builder.CreateFAdd (a, b); }
+    ::llvm::Value* add (::llvm::Value* a, double b)             { return builder.CreateFAdd (a, constant (b)); }
+    ::llvm::Value* sub (::llvm::Value* a, ::llvm::Value* b)     { return builder.CreateFSub (a, b); }
+    ::llvm::Value* sub (::llvm::Value* a, double b)             { return builder.CreateFSub (a, constant (b)); }
+    ::llvm::Value* mul (::llvm::Value* a, ::llvm::Value* b)     { return builder.CreateFMul (a, b); }
+    ::llvm::Value* mul (::llvm::Value* a, double b)             { return builder.CreateFMul (a, constant (b)); }
+
+    ::llvm::Value* lessThan (::llvm::Value* a, double b)        { return builder.CreateFCmpOLT (a, constant (b)); }
+    ::llvm::Value* greaterThan (::llvm::Value* a, double b)     { return builder.CreateFCmpOGT (a, constant (b)); }
+    ::llvm::Value* equals (::llvm::Value* a, double b)          { return builder.CreateFCmpOEQ (a, constant (b)); }
+
+    ::llvm::Value* select (::llvm::Value* condition, ::llvm::Value* a, ::llvm::Value* b)   { return builder.CreateSelect (condition, a, b); }
+};
+
+} // namespace cmaj::llvm
@@ -54,6 +54,8 @@ struct WebAssemblyEngine
     static constexpr bool usesDynamicRateAndSessionID = false;
     static constexpr bool allowTopLevelSlices = false;
     static constexpr bool supportsExternalFunctions = false;
+    static constexpr bool supportsTieredCompilation = false;
+    static constexpr bool canShareLinkedCode = false;
     static bool engineSupportsIntrinsic (AST::Intrinsic::Type) { return false; }
 
     //==============================================================================
@@ -518,6 +520,10 @@ initialisePatch();
 
         Dictionary dictionary { *this };
         choc::value::StringDictionary& getDictionary()  { return dictionary; }
+
+        // The state lives inside the WASM instance, so can't be accessed directly
+        choc::com::String* getStateLayout()             { return {}; }
+        void* getStateMemory()                          { return {}; }
     };
 
 
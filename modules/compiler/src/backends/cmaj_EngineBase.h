@@ -21,6 +21,9 @@
 #include "../../include/cmaj_ErrorHandling.h"
 #include "../../../include/cmajor/COM/cmaj_EngineFactoryInterface.h"
 #include <iostream>
+#include <future>
+#include <mutex>
+#include "choc/text/choc_Files.h"
 #include "../AST/cmaj_AST.h"
 #include "../codegen/cmaj_GraphGenerator.h"
 #include "../transformations/cmaj_Transformations.h"
@@ -28,6 +31,13 @@
 #include "WebAssembly/cmaj_WebAssembly.h"
 #include "LLVM/cmaj_LLVM.h"
 
+// Setting this makes every DispatchFunction call go through a std::function, which is
+// roughly what each endpoint call cost before the dispatch table was added. It's only
+// meant for getting a baseline when benchmarking, e.g. with the cmaj_test_endpoint_io tests.
+#ifndef CMAJ_PERFORMER_STD_FUNCTION_DISPATCH
+ #define CMAJ_PERFORMER_STD_FUNCTION_DISPATCH 0
+#endif
+
 namespace cmaj
 {
 
@@ -39,6 +49,108 @@ struct EndpointInfo
 };
 
 
+//==============================================================================
+/**
+    Keeps track of the code that engines have linked, so that when another engine
+    links an identical program, it can share the same compiled code rather than
+    building it again. Only the state and IO memory then need to be per-performer.
+
+    Entries are held weakly, so code gets freed when the last engine or performer
+    that uses it is deleted.
+*/
+template <typename LinkedCode>
+struct SharedLinkedCodeRegistry
+{
+    static SharedLinkedCodeRegistry& getInstance()
+    {
+        static SharedLinkedCodeRegistry registry;
+        return registry;
+    }
+
+    /// Returns the code for the given key, either by finding an existing one or by
+    /// calling the create function. If another thread is already building the same
+    /// code, this waits for it to finish rather than starting a duplicate build.
+    template <typename CreateFn>
+    std::shared_ptr<LinkedCode> getOrCreate (const std::string& key, CreateFn&& create)
+    {
+        std::promise<std::shared_ptr<LinkedCode>> result;
+        std::shared_future<std::shared_ptr<LinkedCode>> pendingResult;
+
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            removeUnusedEntries();
+
+            auto& entry = entries[key];
+
+            if (auto existing = entry.code.lock())
+                return existing;
+
+            if (entry.pending.valid())
+                pendingResult = entry.pending;
+            else
+                entry.pending = result.get_future().share();
+        }
+
+        if (pendingResult.valid())
+        {
+            if (auto code = pendingResult.get())
+                return code;
+
+            // The other build failed, so build our own to get the errors reported properly
+            return create();
+        }
+
+        std::shared_ptr<LinkedCode> code;
+
+        try
+        {
+            code = create();
+        }
+        catch (...)
+        {
+            finishPendingEntry (key, result, {});
+            throw;
+        }
+
+        finishPendingEntry (key, result, code);
+        return code;
+    }
+
+private:
+    struct Entry
+    {
+        std::weak_ptr<LinkedCode> code;
+        std::shared_future<std::shared_ptr<LinkedCode>> pending;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+
+    void finishPendingEntry (const std::string& key, std::promise<std::shared_ptr<LinkedCode>>& result,
+                             const std::shared_ptr<LinkedCode>& code)
+    {
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            auto& entry = entries[key];
+            entry.code = code;
+            entry.pending = {};
+        }
+
+        result.set_value (code);
+    }
+
+    void removeUnusedEntries()
+    {
+        for (auto i = entries.begin(); i != entries.end();)
+        {
+            if (i->second.code.expired() && ! i->second.pending.valid())
+                i = entries.erase (i);
+            else
+                ++i;
+        }
+    }
+};
+
 //==============================================================================
 template <typename Implementation>
 struct EngineBase  : public choc::com::ObjectWithAtomicRefCount<EngineInterface, EngineBase<Implementation>>
@@ -66,6 +178,7 @@ struct EngineBase  : public choc::com::ObjectWithAtomicRefCount<EngineInterface,
     choc::com::StringPtr loadedProgramDetailsJSON;
     std::shared_ptr<typename Implementation::LinkedCode> linkedCode;
     CompilePerformanceTimes compilePerformanceTimes;
+    std::string compactionLog;
     std::vector<EndpointInfo> endpointHandles;
     uint32_t nextHandle = 1;
 
@@ -101,6 +214,7 @@ struct EngineBase  : public choc::com::ObjectWithAtomicRefCount<EngineInterface,
         newProgram.reset();
         program.reset();
         loadedProgramDetailsJSON = {};
+        compactionLog = {};
     }
 
     bool isLoaded() override        { return loadedProgram != nullptr; }
@@ -135,6 +249,14 @@ struct EngineBase  : public choc::com::ObjectWithAtomicRefCount<EngineInterface,
     choc::com::String* load (ProgramInterface* programToLoad,
                              void* variableContext, EngineInterface::RequestExternalVariableFn requestExternalVariable,
                              void* functionContext, EngineInterface::RequestExternalFunctionFn requestExternalFunction) override
+    {
+        return loadWithCache (programToLoad, variableContext, requestExternalVariable, functionContext, requestExternalFunction, nullptr);
+    }
+
+    choc::com::String* loadWithCache (ProgramInterface* programToLoad,
+                                      void* variableContext, EngineInterface::RequestExternalVariableFn requestExternalVariable,
+                                      void* functionContext, EngineInterface::RequestExternalFunctionFn requestExternalFunction,
+                                      CacheDatabaseInterface* cache) override
     {
         unload();
 
@@ -146,6 +268,25 @@ struct EngineBase  : public choc::com::ObjectWithAtomicRefCount<EngineInterface,
                 throwError (Errors::emptyProgram());
 
             newProgram = AST::getProgram (*programToLoad);
+            newProgram->resolutionStatistics.reset();
+            newProgram->compileProfile.reset();
+
+            auto loadTimer = newProgram->compileProfile.measure ("engine", "load", newProgram->allocator);
+
+            std::string loadCacheKey;
+
+            if (cache != nullptr)
+            {
+                loadCacheKey = getLoadCacheKey();
+
+                if (loadResolvedProgramFromCache (*cache, loadCacheKey))
+                {
+                    newProgram->externalVariableManager.setExternalRequestor (requestExternalVariable, variableContext);
+                    newProgram->externalFunctionManager.setExternalRequestor (requestExternalFunction, functionContext);
+                    finishLoading (*programToLoad);
+                    return;
+                }
+            }
 
             if (! newProgram->prepareForLoading())
                 throwError (Errors::invalidProgram());
@@ -168,16 +309,110 @@ struct EngineBase  : public choc::com::ObjectWithAtomicRefCount<EngineInterface,
 
             transformations::prepareForResolution (*newProgram, buildSettings.getMaxStackSize());
 
-            newProgram->endpointList.initialise (*mainProcessor);
+            if (auto numLanes = buildSettings.getNumInstanceLanes(); numLanes > 1)
+            {
+                transformations::createInstanceLanes (*newProgram, numLanes);
+                mainProcessor = newProgram->findMainProcessor();
+            }
 
-            program = newProgram;
-            programToLoad->addRef();
-            loadedProgram = ProgramPtr (programToLoad);
+            if (cache != nullptr)
+                saveResolvedProgramToCache (*cache, loadCacheKey);
 
-            loadedProgramDetailsJSON = createProgramDetails();
+            finishLoading (*programToLoad);
         });
     }
 
+    void finishLoading (ProgramInterface& programToLoad)
+    {
+        newProgram->endpointList.initialise (*mainProcessor);
+
+        program = newProgram;
+        programToLoad.addRef();
+        loadedProgram = ProgramPtr (std::addressof (programToLoad));
+
+        loadedProgramDetailsJSON = createProgramDetails();
+    }
+
+    //==============================================================================
+    /// The key for a resolved program depends only on the source code and the settings
+    /// that affect resolution, so it can be computed before anything is parsed
+    std::string getLoadCacheKey() const
+    {
+        auto hash = newProgram->codeHash;
+        hash.addInput (implementation->getEngineVersion());
+        hash.addInput (buildSettings.withoutDiagnosticSettings().toJSON());
+
+        return "resolved_" + choc::text::createHexString (hash.getHash());
+    }
+
+    /// Stores the resolved program as a binary module, preceded by the name of its
+    /// main processor. Programs that use externals aren't stored, because their values
+    /// get baked into the AST during resolution and may be different next time.
+    void saveResolvedProgramToCache (CacheDatabaseInterface& cache, const std::string& key) const
+    {
+        if (! (newProgram->externalVariableManager.isEmpty() && newProgram->externalFunctionManager.isEmpty()))
+            return;
+
+        auto mainProcessorName = mainProcessor->getFullyQualifiedReadableName();
+        auto module = transformations::createBinaryModule (newProgram->getTopLevelModules());
+
+        std::vector<uint8_t> data;
+        data.reserve (mainProcessorName.length() + 1 + module.size());
+        data.insert (data.end(), mainProcessorName.begin(), mainProcessorName.end());
+        data.push_back (0);
+        data.insert (data.end(), module.begin(), module.end());
+
+        cache.store (key.c_str(), data.data(), data.size());
+    }
+
+    bool loadResolvedProgramFromCache (CacheDatabaseInterface& cache, const std::string& key)
+    {
+        std::vector<uint8_t> data;
+
+        if (auto cachedSize = cache.reload (key.c_str(), nullptr, 0))
+        {
+            data.resize (static_cast<size_t> (cachedSize));
+
+            if (cache.reload (key.c_str(), data.data(), cachedSize) != cachedSize)
+                return false;
+        }
+
+        auto nameEnd = std::find (data.begin(), data.end(), static_cast<uint8_t> (0));
+
+        if (nameEnd == data.end())
+            return false;
+
+        auto mainProcessorName = std::string (data.begin(), nameEnd);
+        auto moduleData = std::addressof (*nameEnd) + 1;
+        auto moduleSize = static_cast<size_t> (data.end() - nameEnd) - 1;
+
+        if (! transformations::isValidBinaryModuleData (moduleData, moduleSize))
+            return false;
+
+        newProgram->rootNamespace.clear();
+        newProgram->resetMainProcessor();
+        newProgram->endpointList.clear();
+
+        for (auto& m : transformations::parseBinaryModule (newProgram->allocator, moduleData, moduleSize, false))
+            newProgram->rootNamespace.subModules.addChildObject (m);
+
+        // Either way, the program's contents no longer match its source files, so
+        // if it gets loaded again it'll need to start from scratch
+        newProgram->markAsNeedingReparsing();
+
+        for (auto& p : newProgram->getAllProcessors())
+        {
+            if (p->getFullyQualifiedReadableName() == mainProcessorName)
+            {
+                newProgram->setMainProcessor (p.get());
+                mainProcessor = newProgram->findMainProcessor();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     choc::com::String* link (CacheDatabaseInterface* cache) override
     {
         if (isLinked())
@@ -195,6 +430,7 @@ struct EngineBase  : public choc::com::ObjectWithAtomicRefCount<EngineInterface,
 
             {
                 auto pc = compilePerformanceTimes.getCounter ("compile");
+                auto timer = program->compileProfile.measure ("engine", "compile", program->allocator);
 
                 transformations::prepareForCodeGen (*program,
                                                     buildSettings,
@@ -207,35 +443,141 @@ struct EngineBase  : public choc::com::ObjectWithAtomicRefCount<EngineInterface,
                                                     [this] (const EndpointID& e) { return isEndpointActive (e); });
             }
 
+            if (buildSettings.shouldCompactAST())
+            {
+                auto pc = compilePerformanceTimes.getCounter ("compact");
+                compactProgram();
+            }
+
             {
                 auto pc = compilePerformanceTimes.getCounter ("link");
+                auto timer = program->compileProfile.measure ("engine", "link", program->allocator);
 
-                std::string cacheKey;
+                auto cacheKey = getCacheKey();
+                bool isSingleFrameOnly = buildSettings.getMaxBlockSize() == 1;
 
-                if (cache != nullptr)
-                    cacheKey = getCacheKey();
+                auto createLinkedCode = [&]
+                {
+                    return std::make_shared<typename Implementation::LinkedCode> (*implementation, isSingleFrameOnly, latency,
+                                                                                  cache, cache != nullptr ? cacheKey.c_str() : "");
+                };
 
-                bool isSingleFrameOnly = buildSettings.getMaxBlockSize() == 1;
-                linkedCode = std::make_shared<typename Implementation::LinkedCode> (*implementation, isSingleFrameOnly,
-                                                                                    latency, cache, cacheKey.c_str());
+                if constexpr (Implementation::canShareLinkedCode)
+                    linkedCode = SharedLinkedCodeRegistry<typename Implementation::LinkedCode>::getInstance()
+                                    .getOrCreate (getSharedLinkedCodeKey (cacheKey), createLinkedCode);
+                else
+                    linkedCode = createLinkedCode();
+            }
+
+            if (auto traceFile = buildSettings.getCompileTraceFile(); ! traceFile.empty())
+            {
+                try
+                {
+                    choc::file::replaceFileWithContent (traceFile, program->compileProfile.toChromeTrace());
+                }
+                catch (const choc::file::Error&)
+                {
+                    throwError (Errors::cannotWriteFile (traceFile));
+                }
             }
         });
     }
 
+    /// Replaces the program with a copy that only contains the objects that are still in use,
+    /// so that everything that resolution and the code-gen transformations have discarded
+    /// can be freed. The engine also lets go of the program that was loaded, so that gets
+    /// deleted too, unless the caller is still holding on to it.
+    void compactProgram()
+    {
+        auto compacted = program->createCompactedCopy();
+
+        if (compacted == nullptr)
+        {
+            compactionLog = "AST compaction: skipped, because the program refers to objects outside its root namespace";
+            return;
+        }
+
+        std::vector<EndpointInfo> remappedHandles;
+
+        for (auto& e : endpointHandles)
+            for (auto& newEndpoint : compacted->endpointList.endpoints)
+                if (newEndpoint.details.endpointID == e.details.endpointID)
+                    remappedHandles.push_back ({ e.handle, newEndpoint.endpoint, e.details });
+
+        if (remappedHandles.size() != endpointHandles.size())
+        {
+            compactionLog = "AST compaction: skipped, because an endpoint in use was removed";
+            return;
+        }
+
+        auto bytesBefore = program->getMemoryUsage()["totalBytes"].getInt64();
+        auto bytesAfter = compacted->getMemoryUsage()["totalBytes"].getInt64();
+
+        compactionLog = "AST compaction: kept " + std::to_string (bytesAfter) + " of "
+                          + std::to_string (bytesBefore) + " bytes of AST objects";
+
+        endpointHandles = std::move (remappedHandles);
+        mainProcessor = compacted->findMainProcessor();
+        program = compacted.get();
+        newProgram = program;
+        loadedProgram = compacted;
+    }
+
     choc::com::String* getLastBuildLog() override
     {
-        return choc::com::createRawString (compilePerformanceTimes.getResults());
+        auto times = compilePerformanceTimes;
+
+        if constexpr (Implementation::supportsTieredCompilation)
+            if (linkedCode != nullptr)
+                linkedCode->addSecondTierCompileTime (times);
+
+        auto log = times.getResults();
+
+        if constexpr (Implementation::supportsTieredCompilation)
+            if (linkedCode != nullptr)
+                log += linkedCode->getTieredCompilationLog();
+
+        if (! compactionLog.empty())
+            log += "\n" + compactionLog;
+
+        if (program != nullptr && buildSettings.shouldProfileCompilation())
+        {
+            if (auto stats = program->resolutionStatistics.getSummary(); ! stats.empty())
+                log += "\n" + stats;
+
+            log += "\nCompile profile: " + choc::json::toString (program->compileProfile.getSummary(), true);
+            log += "\nAST memory: " + choc::json::toString (program->getMemoryUsage(), true);
+        }
+
+        return choc::com::createRawString (log);
     }
 
     std::string getCacheKey()
     {
         auto hash = getProgram().codeHash;
         hash.addInput (implementation->getEngineVersion());
-        hash.addInput (BuildSettings (buildSettings).setSessionID (0).toJSON());
+        hash.addInput (buildSettings.withoutDiagnosticSettings().toJSON());
+
+        // The generated code depends on which endpoints are in use and on the values
+        // of any externals, neither of which are part of the source code
+        for (auto& e : endpointHandles)
+            hash.addInput (std::to_string (e.handle) + ":" + e.details.endpointID.toString());
+
+        getProgram().externalVariableManager.addToHash (hash);
 
         return std::string (mainProcessor->getName()) + "_" + choc::text::createHexString (hash.getHash());
     }
 
+    /// The key used to share code between engines in this process: as well as everything
+    /// in the cache key, this also includes the addresses of any external functions.
+    std::string getSharedLinkedCodeKey (const std::string& cacheKey)
+    {
+        choc::hash::xxHash64 hash;
+        hash.addInput (cacheKey);
+        getProgram().externalFunctionManager.addToHash (hash);
+        return cacheKey + "_" + choc::text::createHexString (hash.getHash());
+    }
+
     //==============================================================================
     bool isEndpointActive (const EndpointID& endpointID)
     {
@@ -433,6 +775,51 @@ struct EngineBase  : public choc::com::ObjectWithAtomicRefCount<EngineInterface,
 };
 
 
+//==============================================================================
+/// A plain function pointer plus a pointer to the state that it operates on.
+/// The performer uses these rather than std::function or virtual methods, so that
+/// each endpoint call costs a single indirect call.
+template <typename Signature>
+struct DispatchFunction;
+
+template <typename Result, typename... Args>
+struct DispatchFunction<Result(Args...)>
+{
+    using Function = Result(*)(void*, Args...);
+
+    Result operator() (Args... args) const      { return function (state, args...); }
+
+    template <typename Functor>
+    static Result call (void* functor, Args... args)
+    {
+        return (*static_cast<Functor*> (functor)) (args...);
+    }
+
+    static Result invalidCall (void*, Args...)  { CMAJ_ASSERT_FALSE; }
+
+    Function function = invalidCall;
+    void* state = nullptr;
+};
+
+/// Copies a functor into the given pool, and returns a DispatchFunction that calls it.
+template <typename Signature, typename Functor>
+DispatchFunction<Signature> allocateDispatchFunction (choc::memory::Pool& pool, Functor&& functor)
+{
+   #if CMAJ_PERFORMER_STD_FUNCTION_DISPATCH
+    using FunctorType = std::function<Signature>;
+   #else
+    using FunctorType = std::decay_t<Functor>;
+   #endif
+
+    auto& state = pool.allocate<FunctorType> (std::forward<Functor> (functor));
+
+    DispatchFunction<Signature> f;
+    f.function = DispatchFunction<Signature>::template call<FunctorType>;
+    f.state = std::addressof (state);
+    return f;
+}
+
+
 //==============================================================================
 template <typename JITInstance>
 struct PerformerBase  : public choc::com::ObjectWithAtomicRefCount<cmaj::PerformerInterface, PerformerBase<JITInstance>>
@@ -458,32 +845,64 @@ struct PerformerBase  : public choc::com::ObjectWithAtomicRefCount<cmaj::Perform
 
     void setInputFrames (EndpointHandle handle, const void* frameData, uint32_t numFrames) override
     {
-        getEndpointHandler (handle).setInputFrames (frameData, numFrames, numFramesToDo);
+        auto& endpoint = getEndpoint (handle);
+
+        if (numFrames == numFramesToDo)
+        {
+            endpoint.setInputFrames (frameData, numFrames, 0);
+        }
+        else
+        {
+            registerXRun();
+
+            if (numFrames > numFramesToDo)
+                numFrames = numFramesToDo;
+
+            endpoint.setInputFrames (frameData, numFrames, numFramesToDo - numFrames);
+        }
     }
 
     void setInputValue (EndpointHandle handle, const void* valueData, uint32_t numFramesToReachValue) override
     {
-        getEndpointHandler (handle).setInputValue (valueData, numFramesToReachValue);
+        getEndpoint (handle).setInputValue (valueData, numFramesToReachValue);
     }
 
     void addInputEvent (EndpointHandle handle, uint32_t typeIndex, const void* eventData) override
     {
-        getEndpointHandler (handle).addInputEvent (typeIndex, eventData);
+        auto& endpoint = getEndpoint (handle);
+        CMAJ_ASSERT (typeIndex < endpoint.numEventTypeHandlers);
+        eventTypeHandlers[endpoint.firstEventTypeHandler + typeIndex] (eventData);
     }
 
     void copyOutputValue (EndpointHandle handle, void* dest) override
     {
-        getEndpointHandler (handle).copyOutputValue (dest);
+        getEndpoint (handle).copyOutput (dest, 1);
     }
 
     void copyOutputFrames (EndpointHandle handle, void* dest, uint32_t numFramesToCopy) override
     {
-        getEndpointHandler (handle).copyOutputFrames (dest, numFramesToCopy);
+        getEndpoint (handle).copyOutput (dest, numFramesToCopy);
     }
 
     void iterateOutputEvents (EndpointHandle handle, void* context, PerformerInterface::HandleOutputEventCallback handler) override
     {
-        getEndpointHandler (handle).iterateOutputEvents (context, handler);
+        iterateOutputEvents (handle, context, handler, 0);
+    }
+
+    void iterateOutputEvents (EndpointHandle handle, void* context, PerformerInterface::HandleOutputEventCallback handler, uint32_t frameOffset)
+    {
+        auto& endpoint = getEndpoint (handle);
+        CMAJ_ASSERT (endpoint.outputEventHandler < outputEventHandlers.size());
+        auto& queue = outputEventHandlers[endpoint.outputEventHandler].queue;
+        auto numEvents = queue.numEvents;
+
+        for (uint32_t i = 0; i < numEvents; ++i)
+        {
+            auto& event = queue.getEvent (i);
+
+            if (! handler (context, handle, event.type, frameOffset + event.frame, event.data, queue.eventSizes[event.type]))
+                break;
+        }
     }
 
     void advance() override
@@ -491,9 +910,52 @@ struct PerformerBase  : public choc::com::ObjectWithAtomicRefCount<cmaj::Perform
         jit.advance (numFramesToDo);
 
         for (auto& e : outputEventHandlers)
-            e->moveOutputEventsToQueue();
+            moveOutputEventsToQueue (e);
     }
 
+    void processBlock (const PerformerInterface::BlockDescriptor& block) override
+    {
+        // A block that's bigger than the maximum size gets rendered in chunks, with the
+        // inputs that aren't streams applied before the first one
+        for (uint32_t start = 0; start < block.numFrames; start += maxBlockSize)
+        {
+            auto numFrames = std::min (maxBlockSize, block.numFrames - start);
+            PerformerBase::setBlockSize (numFrames);
+
+            for (uint32_t i = 0; i < block.numInputStreams; ++i)
+            {
+                auto& endpoint = getEndpoint (block.inputStreams[i].handle);
+                endpoint.setInputFrames (static_cast<const uint8_t*> (block.inputStreams[i].frameData) + start * endpoint.frameSize, numFrames, 0);
+            }
+
+            if (start == 0)
+            {
+                for (uint32_t i = 0; i < block.numInputValues; ++i)
+                    getEndpoint (block.inputValues[i].handle).setInputValue (block.inputValues[i].valueData, block.inputValues[i].numFramesToReachValue);
+
+                for (uint32_t i = 0; i < block.numInputEvents; ++i)
+                    PerformerBase::addInputEvent (block.inputEvents[i].handle, block.inputEvents[i].typeIndex, block.inputEvents[i].eventData);
+            }
+
+            PerformerBase::advance();
+
+            for (uint32_t i = 0; i < block.numOutputStreams; ++i)
+            {
+                auto& endpoint = getEndpoint (block.outputStreams[i].handle);
+                endpoint.copyOutput (static_cast<uint8_t*> (block.outputStreams[i].dest) + start * endpoint.frameSize, numFrames);
+            }
+
+            for (uint32_t i = 0; i < block.numOutputEvents; ++i)
+                PerformerBase::iterateOutputEvents (block.outputEvents[i].handle, block.outputEvents[i].context, block.outputEvents[i].callback, start);
+        }
+
+        for (uint32_t i = 0; i < block.numOutputValues; ++i)
+            getEndpoint (block.outputValues[i].handle).copyOutput (block.outputValues[i].dest, 1);
+    }
+
+    choc::com::String* getStateLayout() override    { return jit.getStateLayout(); }
+    void* getStateMemory() override                 { return jit.getStateMemory(); }
+
     uint32_t getMaximumBlockSize() override     { return maxBlockSize; }
     double getLatency() override                { return latency; }
     uint32_t getEventBufferSize() override      { return eventBufferSize; }
@@ -526,279 +988,195 @@ private:
     const double latency;
 
     //==============================================================================
-    void initialiseEndpointList (const std::vector<EndpointInfo>& endpoints)
+    struct OutputEventQueue
     {
-        if (endpoints.empty())
-            return;
-
-        firstHandle = endpoints.front().handle;
-        lastHandle = firstHandle;
+        struct Event
+        {
+            uint32_t frame = 0, type = 0;
+            uint64_t data[1];
+        };
 
-        for (auto& endpoint : endpoints)
+        void initialise (const EndpointDetails& details, uint32_t maxNumEventsToUse)
         {
-            CMAJ_ASSERT (endpoint.handle == lastHandle); // handles must be in order
-            ++lastHandle;
+            numEvents = 0;
+            maxNumEvents = maxNumEventsToUse;
+            size_t maxEventDataSize = 0;
 
-            if (endpoint.details.isInput)
+            for (auto& t : details.dataTypes)
             {
-                if (endpoint.details.isEvent())
-                    endpointHandlers.push_back (std::make_unique<InputEventHandler> (*this, endpoint));
-                else if (endpoint.details.isStream())
-                    endpointHandlers.push_back (std::make_unique<InputStreamHandler> (*this, endpoint));
-                else
-                    endpointHandlers.push_back (std::make_unique<InputValueHandler> (*this, endpoint));
+                auto size = t.getValueDataSize();
+                maxEventDataSize = std::max (maxEventDataSize, size);
+                eventSizes.push_back (static_cast<uint32_t> (size));
             }
-            else if (endpoint.details.isEvent())
-            {
-                auto h = std::make_unique<OutputEventHandler> (*this, endpoint);
-                outputEventHandlers.push_back (h.get());
-                endpointHandlers.push_back (std::move (h));
-            }
-            else
-            {
-                auto h = std::make_unique<OutputStreamOrValueHandler> (*this, endpoint);
-                endpointHandlers.push_back (std::move (h));
-            }
-        }
-    }
-
-    //==============================================================================
-    struct EndpointHandler
-    {
-        EndpointHandler() = default;
-        virtual ~EndpointHandler() = default;
-
-        virtual void setInputFrames (const void*, uint32_t, uint32_t)           { CMAJ_ASSERT_FALSE; }
-        virtual void setInputValue (const void*, uint32_t)                      { CMAJ_ASSERT_FALSE; }
-        virtual void addInputEvent (uint32_t, const void*)                      { CMAJ_ASSERT_FALSE; }
-        virtual void copyOutputValue (void*)                                    { CMAJ_ASSERT_FALSE; }
-        virtual void copyOutputFrames (void*, uint32_t)                         { CMAJ_ASSERT_FALSE; }
-        virtual void iterateOutputEvents (void*, PerformerInterface::HandleOutputEventCallback)  { CMAJ_ASSERT_FALSE; }
-    };
 
-    //==============================================================================
-    struct InputStreamHandler  : public EndpointHandler
-    {
-        InputStreamHandler (PerformerBase& p, const EndpointInfo& endpoint) : owner (p)
-        {
-            setInputStreamFrames = owner.jit.createSetInputStreamFramesFunction (endpoint);
+            eventStride = ((sizeof (Event) + maxEventDataSize) + 7u) & ~7u;
+            eventSpace.resize (maxNumEvents * eventStride);
         }
 
-        void setInputFrames (const void* frameData, uint32_t numFrames, uint32_t framesForBlock) override
+        Event& getEvent (size_t index) noexcept
         {
-            if (numFrames == framesForBlock)
-            {
-                setInputStreamFrames (frameData, numFrames, 0);
-            }
-            else
-            {
-                owner.registerXRun();
+            return *reinterpret_cast<Event*> (eventSpace.data() + eventStride * index);
+        }
 
-                if (numFrames > framesForBlock)
-                    numFrames = framesForBlock;
+        uint32_t numEvents = 0;
+        uint32_t maxNumEvents = 0;
 
-                setInputStreamFrames (frameData, numFrames, framesForBlock - numFrames);
-            }
-        }
+        std::vector<uint32_t> eventSizes;
 
-        PerformerBase& owner;
-        std::function<void(const void*, uint32_t, uint32_t)> setInputStreamFrames;
+    private:
+        size_t eventStride = 0;
+        std::vector<uint8_t> eventSpace;
     };
 
-    //==============================================================================
-    struct InputValueHandler  : public EndpointHandler
+    struct OutputEventHandler
     {
-        InputValueHandler (PerformerBase& owner, const EndpointInfo& endpoint)
-        {
-            setInputValueFn = owner.jit.createSetInputValueFunction (endpoint);
-        }
-
-        void setInputValue (const void* valueData, uint32_t numFramesToReachValue) override
-        {
-            setInputValueFn (valueData, numFramesToReachValue);
-        }
+        OutputEventQueue queue;
 
-        std::function<void(const void*, uint32_t)> setInputValueFn;
-        uint32_t dataTypeSize = 0;
+        DispatchFunction<uint32_t()>                 getNumOutputEvents;
+        DispatchFunction<uint32_t(uint32_t)>         getEventTypeIndex;
+        DispatchFunction<uint32_t(uint32_t, void*)>  readOutputEvent;
+        DispatchFunction<void()>                     resetEventCount;
     };
 
-    //==============================================================================
-    struct InputEventHandler : public EndpointHandler
+    /// One of these is held for each endpoint handle. Any functions which don't
+    /// apply to the endpoint's type are left pointing at an asserting stub.
+    struct EndpointDispatch
     {
-        InputEventHandler (PerformerBase& owner, const EndpointInfo& endpoint)
-        {
-            for (auto& dataType : endpoint.endpoint.dataTypes)
-            {
-                auto& t = AST::castToRefSkippingReferences<AST::TypeBase> (dataType);
-                std::function<void(const void*)> handler;
-
-                if (auto handlerFunction = AST::findEventHandlerFunction (endpoint.endpoint, t))
-                    handler = owner.jit.createSendEventFunction (endpoint, t, *handlerFunction);
-                else
-                    handler = [] (const void*) {};
-
-                auto type = t.toChocType();
-                auto size = static_cast<uint32_t> (type.getValueDataSize());
-
-                typeHandlers.push_back ({ std::move (type), size, std::move (handler) });
-            }
-        }
-
-        void addInputEvent (uint32_t typeIndex, const void* eventData) override
-        {
-            CMAJ_ASSERT (typeIndex < typeHandlers.size());
-            typeHandlers[typeIndex].handler (eventData);
-        }
+        DispatchFunction<void(const void*, uint32_t, uint32_t)>  setInputFrames;
+        DispatchFunction<void(const void*, uint32_t)>            setInputValue;
+        DispatchFunction<void(void*, uint32_t)>                  copyOutput;
 
-        struct TypeHandler
-        {
-            choc::value::Type type;
-            uint32_t dataSize = 0;
-            std::function<void(const void*)> handler;
-        };
+        uint32_t firstEventTypeHandler = 0, numEventTypeHandlers = 0;
+        uint32_t outputEventHandler = std::numeric_limits<uint32_t>::max();
 
-        std::vector<TypeHandler> typeHandlers;
+        /// For streams, this is the size of a frame in the data passed to setInputFrames and copyOutput
+        uint32_t frameSize = 0;
     };
 
     //==============================================================================
-    struct OutputStreamOrValueHandler  : public EndpointHandler
-    {
-        OutputStreamOrValueHandler (PerformerBase& owner, const EndpointInfo& endpoint)
-        {
-            copyOutputValueFn = owner.jit.createCopyOutputValueFunction (endpoint);
-            isStream = endpoint.details.isStream();
-        }
+    std::vector<EndpointDispatch> endpoints;
+    std::vector<DispatchFunction<void(const void*)>> eventTypeHandlers;
+    std::vector<OutputEventHandler> outputEventHandlers;
+    uint32_t firstHandle = 0, lastHandle = 0;
 
-        void copyOutputValue (void* dest) override
-        {
-            copyOutputValueFn (dest, 1);
-        }
+    /// Holds the state objects that the dispatch functions point to.
+    choc::memory::Pool dispatchState;
 
-        void copyOutputFrames (void* dest, uint32_t numFramesToCopy) override
-        {
-            copyOutputValueFn (dest, numFramesToCopy);
-        }
-
-        uint32_t dataTypeSize = 0;
-        bool isStream = false;
+    EndpointDispatch& getEndpoint (EndpointHandle handle)
+    {
+        CMAJ_ASSERT (handle >= firstHandle && handle < lastHandle);
+        return endpoints[handle - firstHandle];
+    }
 
-        std::function<void(void*, uint32_t)> copyOutputValueFn;
-    };
+    /// The JIT can either return a functor to be stored here, or a DispatchFunction
+    /// that it has already created, when it wants to pick a specialised one.
+    template <typename Signature, typename Functor>
+    DispatchFunction<Signature> createDispatchFunction (Functor&& functor)
+    {
+        if constexpr (std::is_same_v<std::decay_t<Functor>, DispatchFunction<Signature>>)
+            return functor;
+        else
+            return allocateDispatchFunction<Signature> (dispatchState, std::forward<Functor> (functor));
+    }
 
     //==============================================================================
-    struct OutputEventHandler : public EndpointHandler
+    void initialiseEndpointList (const std::vector<EndpointInfo>& endpointInfo)
     {
-        OutputEventHandler (PerformerBase& p, const EndpointInfo& endpoint)
-            : owner (p), handle (endpoint.handle)
-        {
-            getNumOutputEvents = owner.jit.createGetNumOutputEventsFunction (endpoint);
-            getEventTypeIndex  = owner.jit.createGetEventTypeIndexFunction (endpoint);
-            readOutputEvent    = owner.jit.createReadOutputEventFunction (endpoint);
-            resetEventCount    = owner.jit.createResetEventCountFunction (endpoint);
+        if (endpointInfo.empty())
+            return;
 
-            queue.initialise (endpoint.details, owner.eventBufferSize);
-        }
+        firstHandle = endpointInfo.front().handle;
+        lastHandle = firstHandle;
 
-        void iterateOutputEvents (void* context, PerformerInterface::HandleOutputEventCallback handler) override
+        for (auto& endpoint : endpointInfo)
         {
-            auto numEvents = queue.numEvents;
-
-            for (uint32_t i = 0; i < numEvents; ++i)
-            {
-                auto& event = queue.getEvent (i);
+            CMAJ_ASSERT (endpoint.handle == lastHandle); // handles must be in order
+            ++lastHandle;
 
-                if (! handler (context, handle, event.type, event.frame, event.data, queue.eventSizes[event.type]))
-                    break;
-            }
-        }
+            EndpointDispatch dispatch;
 
-        void moveOutputEventsToQueue()
-        {
-            CMAJ_ASSERT (getNumOutputEvents != nullptr);
+            if (endpoint.details.isStream())
+                dispatch.frameSize = static_cast<uint32_t> (endpoint.details.dataTypes.front().getValueDataSize());
 
-            if (auto numEvents = getNumOutputEvents())
+            if (endpoint.details.isInput)
             {
-                if (numEvents > queue.maxNumEvents)
-                {
-                    numEvents = queue.maxNumEvents;
-                    owner.registerXRun();
-                }
-
-                for (uint32_t i = 0; i < numEvents; ++i)
-                {
-                    auto& event = queue.getEvent (i);
-                    event.type  = getEventTypeIndex (i);
-                    event.frame = readOutputEvent (i, event.data);
-                }
-
-                queue.numEvents = numEvents;
-                resetEventCount();
+                if (endpoint.details.isEvent())
+                    addInputEventHandlers (dispatch, endpoint);
+                else if (endpoint.details.isStream())
+                    dispatch.setInputFrames = createDispatchFunction<void(const void*, uint32_t, uint32_t)> (jit.createSetInputStreamFramesFunction (endpoint));
+                else
+                    dispatch.setInputValue = createDispatchFunction<void(const void*, uint32_t)> (jit.createSetInputValueFunction (endpoint));
+            }
+            else if (endpoint.details.isEvent())
+            {
+                dispatch.outputEventHandler = static_cast<uint32_t> (outputEventHandlers.size());
+                addOutputEventHandler (endpoint);
             }
             else
             {
-                queue.numEvents = 0;
+                dispatch.copyOutput = createDispatchFunction<void(void*, uint32_t)> (jit.createCopyOutputValueFunction (endpoint));
             }
-        }
 
-        struct OutputEventQueue
-        {
-            struct Event
-            {
-                uint32_t frame = 0, type = 0;
-                uint64_t data[1];
-            };
+            endpoints.push_back (dispatch);
+        }
+    }
 
-            void initialise (const EndpointDetails& details, uint32_t maxNumEventsToUse)
-            {
-                numEvents = 0;
-                maxNumEvents = maxNumEventsToUse;
-                size_t maxEventDataSize = 0;
+    void addInputEventHandlers (EndpointDispatch& dispatch, const EndpointInfo& endpoint)
+    {
+        dispatch.firstEventTypeHandler = static_cast<uint32_t> (eventTypeHandlers.size());
 
-                for (auto& t : details.dataTypes)
-                {
-                    auto size = t.getValueDataSize();
-                    maxEventDataSize = std::max (maxEventDataSize, size);
-                    eventSizes.push_back (static_cast<uint32_t> (size));
-                }
+        for (auto& dataType : endpoint.endpoint.dataTypes)
+        {
+            auto& t = AST::castToRefSkippingReferences<AST::TypeBase> (dataType);
 
-                eventStride = ((sizeof (Event) + maxEventDataSize) + 7u) & ~7u;
-                eventSpace.resize (maxNumEvents * eventStride);
-            }
+            if (auto handlerFunction = AST::findEventHandlerFunction (endpoint.endpoint, t))
+                eventTypeHandlers.push_back (createDispatchFunction<void(const void*)> (jit.createSendEventFunction (endpoint, t, *handlerFunction)));
+            else
+                eventTypeHandlers.push_back (createDispatchFunction<void(const void*)> ([] (const void*) {}));
+        }
 
-            Event& getEvent (size_t index) noexcept
-            {
-                return *reinterpret_cast<Event*> (eventSpace.data() + eventStride * index);
-            }
+        dispatch.numEventTypeHandlers = static_cast<uint32_t> (eventTypeHandlers.size()) - dispatch.firstEventTypeHandler;
+    }
 
-            uint32_t numEvents = 0;
-            uint32_t maxNumEvents = 0;
+    void addOutputEventHandler (const EndpointInfo& endpoint)
+    {
+        OutputEventHandler h;
 
-            std::vector<uint32_t> eventSizes;
+        h.getNumOutputEvents = createDispatchFunction<uint32_t()>                (jit.createGetNumOutputEventsFunction (endpoint));
+        h.getEventTypeIndex  = createDispatchFunction<uint32_t(uint32_t)>        (jit.createGetEventTypeIndexFunction (endpoint));
+        h.readOutputEvent    = createDispatchFunction<uint32_t(uint32_t, void*)> (jit.createReadOutputEventFunction (endpoint));
+        h.resetEventCount    = createDispatchFunction<void()>                    (jit.createResetEventCountFunction (endpoint));
 
-        private:
-            size_t eventStride = 0;
-            std::vector<uint8_t> eventSpace;
-        };
+        h.queue.initialise (endpoint.details, eventBufferSize);
+        outputEventHandlers.push_back (std::move (h));
+    }
 
-        PerformerBase& owner;
-        EndpointHandle handle;
-        OutputEventQueue queue;
+    void moveOutputEventsToQueue (OutputEventHandler& h)
+    {
+        auto& queue = h.queue;
 
-        std::function<uint32_t()>                 getNumOutputEvents;
-        std::function<uint32_t(uint32_t)>         getEventTypeIndex;
-        std::function<uint32_t(uint32_t, void*)>  readOutputEvent;
-        std::function<void()>                     resetEventCount;
-    };
+        if (auto numEvents = h.getNumOutputEvents())
+        {
+            if (numEvents > queue.maxNumEvents)
+            {
+                numEvents = queue.maxNumEvents;
+                registerXRun();
+            }
 
-    //==============================================================================
-    std::vector<std::unique_ptr<EndpointHandler>> endpointHandlers;
-    uint32_t firstHandle = 0, lastHandle = 0;
-    std::vector<OutputEventHandler*> outputEventHandlers;
+            for (uint32_t i = 0; i < numEvents; ++i)
+            {
+                auto& event = queue.getEvent (i);
+                event.type  = h.getEventTypeIndex (i);
+                event.frame = h.readOutputEvent (i, event.data);
+            }
 
-    EndpointHandler& getEndpointHandler (EndpointHandle handle)
-    {
-        CMAJ_ASSERT (handle >= firstHandle && handle < lastHandle);
-        return *endpointHandlers[handle - firstHandle];
+            queue.numEvents = numEvents;
+            h.resetEventCount();
+        }
+        else
+        {
+            queue.numEvents = 0;
+        }
     }
 };
 
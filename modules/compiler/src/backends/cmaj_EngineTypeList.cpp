@@ -96,6 +96,8 @@ struct DummyEngineFactory  : public choc::com::ObjectWithAtomicRefCount<EngineFa
         static constexpr bool usesDynamicRateAndSessionID = true;
         static constexpr bool allowTopLevelSlices = false;
         static constexpr bool supportsExternalFunctions = true;
+        static constexpr bool supportsTieredCompilation = false;
+        static constexpr bool canShareLinkedCode = false;
         static bool engineSupportsIntrinsic (AST::Intrinsic::Type) { return true; }
 
         static std::string getEngineVersion()   { return "dummy"; }
@@ -306,6 +306,13 @@ struct CompilePerformanceTimes
         categories.push_back ({ category, {} });
         return { categories.back() };
     }
+
+    /// Adds the time of a step that wasn't measured with a PerformanceCounter,
+    /// e.g. one that ran on a background thread.
+    void addCategory (std::string_view category, Seconds time)
+    {
+        categories.push_back ({ category, time });
+    }
 };
 
 
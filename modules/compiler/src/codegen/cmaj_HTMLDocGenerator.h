@@ -610,9 +610,8 @@ private:
     {
         if (auto sourceFile = o.context.allocator.sourceFileList.findSourceFileContaining (o.context.location))
         {
-            auto fileContent = sourceFile->content;
-            CMAJ_ASSERT (! fileContent.empty());
-            auto t = choc::text::UTF8Pointer (fileContent.c_str());
+            CMAJ_ASSERT (! sourceFile->content.empty());
+            auto t = sourceFile->getUTF8();
 
             for (;;)
             {
@@ -24,7 +24,7 @@ namespace cmaj
 //==============================================================================
 struct NativeTypeLayout
 {
-    NativeTypeLayout (const AST::TypeBase& t) : type (t.skipConstAndRefModifiers()) {}
+    NativeTypeLayout (const AST::TypeBase& t) : type (t.skipConstAndRefModifiers().toChocType()) {}
 
     struct NativeChunkInfo
     {
@@ -32,15 +32,16 @@ struct NativeTypeLayout
         bool isPackedBits;
     };
 
+    /// The AST type must be the one that this layout was created for.
     template <typename GetNativeLayout>
-    void generate (const GetNativeLayout& getNativeLayout)
+    void generate (const AST::TypeBase& astType, const GetNativeLayout& getNativeLayout)
     {
-        addChunks (type, getNativeLayout, 0, 0);
+        addChunks (astType.skipConstAndRefModifiers(), getNativeLayout, 0, 0);
     }
 
     void generateWithoutPacking()
     {
-        addChunk (0, 0, static_cast<uint32_t> (type.toChocType().getValueDataSize()), 0);
+        addChunk (0, 0, static_cast<uint32_t> (type.getValueDataSize()), 0);
     }
 
     bool requiresPacking() const
@@ -103,7 +104,9 @@ struct NativeTypeLayout
         return getNativeSize();
     }
 
-    const AST::TypeBase& type;
+    /// This is a copy rather than a reference to the AST type, because a layout
+    /// may be used by code that outlives the program it was created from.
+    choc::value::Type type;
 
 private:
     struct ContiguousChunk
@@ -257,10 +260,12 @@ private:
 //==============================================================================
 struct NativeTypeLayoutCache
 {
-    ptr<const NativeTypeLayout> find (const AST::TypeBase& targetType)
+    ptr<const NativeTypeLayout> find (const AST::TypeBase& targetType) const
     {
+        auto type = targetType.skipConstAndRefModifiers().toChocType();
+
         for (auto& p : nativeTypeLayouts)
-            if (p->type.isIdentical (targetType))
+            if (p->type == type)
                 return ptr<const NativeTypeLayout> (p.get());
 
         return {};
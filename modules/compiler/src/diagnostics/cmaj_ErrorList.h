@@ -39,6 +39,8 @@ struct Errors
 DECL_COMPILE_ERROR (staticAssertionFailure,                 "Static assertion failure")
 DECL_COMPILE_ERROR (staticAssertionFailureWithMessage,      "{0}")
 DECL_COMPILE_ERROR (unimplementedFeature,                   "Language feature not yet implemented: {0}!")
+DECL_COMPILE_ERROR (cannotReadSourceFile,                   "Cannot read the file '{0}'")
+DECL_COMPILE_ERROR (cannotWriteFile,                        "Cannot write to the file '{0}'")
 
 // Low-level lexer errors
 DECL_COMPILE_ERROR (identifierTooLong,                      "Identifier too long")
@@ -52,6 +54,7 @@ DECL_COMPILE_ERROR (complexNumberSuffixNeedsFloat,          "The 'i' suffix for
 DECL_COMPILE_ERROR (errorInNumericLiteral,                  "Syntax error in numeric constant")
 DECL_COMPILE_ERROR (noOctalLiterals,                        "Octal literals are not supported")
 DECL_COMPILE_ERROR (integerLiteralTooLarge,                 "Integer literal is too large to be represented")
+DECL_COMPILE_ERROR (floatLiteralOutOfRange,                 "Floating-point literal is out of range")
 DECL_COMPILE_ERROR (integerLiteralNeedsSuffix,              "This value is too large to fit into an int32, did you mean to add an 'i64' suffix?")
 DECL_COMPILE_ERROR (noLeadingUnderscoreAllowed,             "Identifiers beginning with an underscore are reserved for system use")
 
@@ -87,6 +90,8 @@ DECL_COMPILE_ERROR (namespaceMustBeInsideNamespace,         "A namespace can onl
 DECL_COMPILE_ERROR (processorMustBeInsideNamespace,         "A processor can only be defined inside a namespace")
 DECL_COMPILE_ERROR (graphMustBeInsideNamespace,             "A graph can only be defined inside a namespace")
 DECL_COMPILE_ERROR (graphCannotContainMainOrInitFunctions,  "The main() and init() functions may only be declared inside a processor")
+DECL_COMPILE_ERROR (idleCheckMustBeInsideProcessor,         "An [[ idleCheck ]] function may only be declared inside a processor: a graph can use the [[ sleepWhenIdle ]] annotation instead")
+DECL_COMPILE_ERROR (tooManyIdleCheckFunctions,              "A processor can only have one [[ idleCheck ]] function")
 DECL_COMPILE_ERROR (onlyMemberFunctionsCanBeConst,          "Only struct member functions can be declared `const`")
 DECL_COMPILE_ERROR (namespaceCannotContainEndpoints,        "A namespace cannot contain endpoint declarations")
 DECL_COMPILE_ERROR (importsMustBeAtStart,                   "Import statements can only be declared at the start of a namespace")
@@ -207,6 +212,7 @@ DECL_COMPILE_ERROR (tooManyParameters,                      "Too many function p
 DECL_COMPILE_ERROR (duplicateFunction,                      "A function with matching parameters has already been defined")
 DECL_COMPILE_ERROR (functionHasParams,                      "The {0}() function must not have any parameters")
 DECL_COMPILE_ERROR (functionMustBeVoid,                     "The {0}() function must return 'void'")
+DECL_COMPILE_ERROR (functionMustReturnBool,                 "The {0}() function must return 'bool'")
 DECL_COMPILE_ERROR (cannotCallFunction,                     "The {0}() function cannot be called from user code")
 DECL_COMPILE_ERROR (cannotResolveFunctionOrCast,            "Could not resolve function or cast")
 DECL_COMPILE_ERROR (voidFunctionCannotReturnValue,          "A void function cannot return a value")
@@ -28,8 +28,19 @@ namespace cmaj::passes
         Pass (AST::Program& p) : AST::Visitor (p.allocator), program (p) {}
 
         AST::Program& program;
-        size_t numReplaced = 0, numFailures = 0;
-        bool throwOnErrors = false;
+        size_t numReplaced = 0, numFailures = 0, numObjectsVisited = 0;
+        bool throwOnErrors = false, skipPreResolvedFunctions = false;
+
+        void visitObject (AST::Object& o) override
+        {
+            if (skipPreResolvedFunctions)
+                if (auto f = o.getAsFunction())
+                    if (f->isPreResolved)
+                        return;
+
+            ++numObjectsVisited;
+            AST::Visitor::visitObject (o);
+        }
 
         /// Replaces an object and also registers a change
         void replaceObject (AST::Object& old, AST::Object& replacement)
@@ -117,10 +128,18 @@ namespace cmaj::passes
     //==============================================================================
     struct PassResult
     {
-        size_t numChanges = 0, numFailures = 0;
+        size_t numChanges = 0, numFailures = 0, numObjectsVisited = 0;
+
+        PassResult& operator+= (PassResult other)
+        {
+            numChanges += other.numChanges;
+            numFailures += other.numFailures;
+            numObjectsVisited += other.numObjectsVisited;
+            return *this;
+        }
 
-        PassResult& operator+= (PassResult other)           { numChanges += other.numChanges; numFailures += other.numFailures; return *this; }
         PassResult operator+ (PassResult other) const       { auto p = *this; p += other; return p; }
+        PassResult operator- (PassResult other) const       { return { numChanges - other.numChanges, numFailures - other.numFailures, numObjectsVisited - other.numObjectsVisited }; }
     };
 
     template <typename PassType>
@@ -128,9 +147,34 @@ namespace cmaj::passes
     {
         PassType pass (program);
         pass.throwOnErrors = throwOnErrors;
+        pass.skipPreResolvedFunctions = program.canSkipPreResolvedFunctions;
         pass.visitObject (program.rootNamespace);
 
-        return { pass.numReplaced, pass.numFailures };
+        return { pass.numReplaced, pass.numFailures, pass.numObjectsVisited };
+    }
+
+    /// Runs a pass over a list of modules, adding the result for each one to the
+    /// corresponding element of moduleResults
+    template <typename PassType, typename ModuleList>
+    PassResult runPass (AST::Program& program, const ModuleList& modules,
+                        std::vector<PassResult>& moduleResults, bool throwOnErrors)
+    {
+        CMAJ_ASSERT (moduleResults.size() == modules.size());
+
+        PassType pass (program);
+        pass.throwOnErrors = throwOnErrors;
+        pass.skipPreResolvedFunctions = program.canSkipPreResolvedFunctions;
+
+        auto getTotal = [&]  { return PassResult { pass.numReplaced, pass.numFailures, pass.numObjectsVisited }; };
+
+        for (size_t i = 0; i < modules.size(); ++i)
+        {
+            auto before = getTotal();
+            pass.visitObject (modules[i].get());
+            moduleResults[i] += getTotal() - before;
+        }
+
+        return getTotal();
     }
 }
 
@@ -20,11 +20,285 @@ namespace cmaj::transformations
 {
 
 //==============================================================================
-inline void addSparseStreamSupport (AST::Program& program)
+/**
+    Lets a processor skip its per-frame work while its input streams are constant.
+
+    If a processor has no mutable state, no event or value endpoints, and a main()
+    which is just a loop ending in advance(), then each frame of its output depends only
+    on the same frame of its input streams, so it'll keep producing the same output for
+    as long as its inputs hold the same values. For processors like this, the loop is
+    rewritten to keep a copy of the last frame's inputs and outputs, and to write the
+    stored outputs instead of running the loop body when the inputs haven't changed.
+
+    A constant run in a stream therefore travels down a chain of these processors
+    without any of them doing any work, which is the common case for the effects on
+    the silent voices of a polyphonic patch. The comparison isn't free, so a loop body
+    is only converted if it calls a function or contains a loop.
+*/
+struct SparseStreamSupport
 {
-    auto& mainProcessor = program.getMainProcessor();
+    static ptr<AST::LoopStatement> findLoopToCache (AST::Processor& processor)
+    {
+        if (! processor.nodes.empty())
+            return {};
+
+        auto inputs = processor.getInputEndpoints (true);
+        auto outputs = processor.getOutputEndpoints (true);
+
+        if (inputs.empty() || outputs.empty())
+            return {};
+
+        for (auto input : inputs)
+            if (! (input->isStream() && ! input->isArray() && canBeCompared (input->getSingleDataType())))
+                return {};
+
+        for (auto output : outputs)
+            if (! (output->isStream() && ! output->isArray() && canBeAccumulated (output->getSingleDataType())))
+                return {};
+
+        for (auto& v : processor.stateVariables.iterateAs<AST::VariableDeclaration>())
+            if (! (v.isCompileTimeConstant() || v.isExternal))
+                return {};
+
+        auto mainFunction = processor.findMainFunction();
+
+        if (mainFunction == nullptr)
+            return {};
+
+        // Any other function that touches an endpoint could be doing it on behalf of main()
+        for (auto& f : processor.functions.iterateAs<AST::Function>())
+            if (std::addressof (f) != mainFunction.get() && accessesEndpoints (f))
+                return {};
+
+        auto& mainBlock = *mainFunction->getMainBlock();
+
+        if (mainBlock.statements.size() != 1)
+            return {};
+
+        auto loop = AST::castTo<AST::LoopStatement> (mainBlock.statements.front());
+
+        if (loop == nullptr || ! loop->isInfinite() || loop->iterator != nullptr || ! loop->initialisers.empty())
+            return {};
+
+        auto body = AST::castTo<AST::ScopeBlock> (loop->body);
+
+        if (body == nullptr || body->statements.size() < 2)
+            return {};
+
+        auto advance = AST::castTo<AST::Advance> (body->statements.back());
+
+        if (advance == nullptr || advance->hasNode())
+            return {};
+
+        bool canBeCached = true, isWorthCaching = false;
+
+        auto isInsideBody = [&] (const AST::ObjectReference& target)
+        {
+            auto statement = AST::castToSkippingReferences<AST::Statement> (target);
+            return statement != nullptr && statement.get() != body.get() && body->containsStatement (*statement);
+        };
+
+        for (size_t i = 0; i < body->statements.size() - 1; ++i)
+        {
+            AST::castToRef<AST::Statement> (body->statements[i]).visitObjectsInScope ([&] (AST::Object& o)
+            {
+                if (AST::castTo<AST::FunctionCall> (o) != nullptr || AST::castTo<AST::LoopStatement> (o) != nullptr)
+                    isWorthCaching = true;
+                else if (AST::castTo<AST::Advance> (o) != nullptr || AST::castTo<AST::ReturnStatement> (o) != nullptr)
+                    canBeCached = false;
+                else if (auto b = AST::castTo<AST::BreakStatement> (o))
+                    canBeCached = canBeCached && isInsideBody (b->targetBlock);
+                else if (auto c = AST::castTo<AST::ContinueStatement> (o))
+                    canBeCached = canBeCached && isInsideBody (c->targetBlock);
+                else if (auto w = AST::castTo<AST::WriteToEndpoint> (o))
+                    canBeCached = canBeCached && isOutputWrite (*w, outputs);
+            });
+        }
+
+        if (canBeCached && isWorthCaching)
+            return loop;
+
+        return {};
+    }
+
+    static void addOutputCache (AST::Processor& processor, AST::LoopStatement& loop)
+    {
+        auto& body = AST::castToRef<AST::ScopeBlock> (loop.body);
+        auto& context = body.context;
+        auto& cacheIsValid = AST::createStateVariable (processor, "_sparseCacheValid", context.allocator.createBoolType(), {});
+
+        // The original loop body only gets run when the inputs change
+        auto& frameBlock = body.allocateChild<AST::ScopeBlock>();
+        auto& cachedOutputBlock = body.allocateChild<AST::ScopeBlock>();
+
+        while (body.statements.size() > 1)
+        {
+            auto& s = AST::castToRef<AST::Statement> (body.statements.front());
+            body.statements.removeObject (s);
+            frameBlock.addStatement (s);
+        }
+
+        std::unordered_map<const AST::EndpointDeclaration*, AST::VariableDeclaration*> frameOutputs;
+        AST::ObjectRefVector<AST::Statement> outputWrites;
+        int insertIndex = 0;
+
+        for (auto output : processor.getOutputEndpoints (true))
+        {
+            auto& type = output->getSingleDataType();
+            auto name = std::string (output->getName().get());
+
+            auto& cachedOutput = AST::createStateVariable (processor, "_sparseOut_" + name, type, {});
+            auto& frameOutput = AST::createLocalVariable (body, "_sparseFrame_" + name, type, {}, insertIndex++);
+            frameOutputs[output.getPointer()] = std::addressof (frameOutput);
+
+            cachedOutputBlock.addStatement (AST::createAssignment (context, AST::createVariableReference (context, frameOutput),
+                                                                   AST::createVariableReference (context, cachedOutput)));
+
+            frameBlock.addStatement (AST::createAssignment (context, AST::createVariableReference (context, cachedOutput),
+                                                            AST::createVariableReference (context, frameOutput)));
 
-    (void) mainProcessor;
+            auto& write = body.allocateChild<AST::WriteToEndpoint>();
+            write.target.createReferenceTo (output);
+            write.value.setChildObject (AST::createVariableReference (context, frameOutput));
+            outputWrites.push_back (write);
+        }
+
+        replaceOutputWrites (frameBlock, frameOutputs);
+
+        ptr<AST::Expression> inputsAreUnchanged = AST::createVariableReference (context, cacheIsValid);
+
+        for (auto input : processor.getInputEndpoints (true))
+        {
+            auto& previousInput = AST::createStateVariable (processor, "_sparseIn_" + std::string (input->getName().get()),
+                                                            input->getSingleDataType(), {});
+
+            inputsAreUnchanged = AST::createBinaryOp (context, AST::BinaryOpTypeEnum::Enum::logicalAnd, *inputsAreUnchanged,
+                                                      createIsUnchanged (body, input->getSingleDataType(),
+                                                                         createReadFromEndpoint (body, input),
+                                                                         AST::createVariableReference (context, previousInput)));
+
+            frameBlock.addStatement (AST::createAssignment (context, AST::createVariableReference (context, previousInput),
+                                                            createReadFromEndpoint (frameBlock, input)));
+        }
+
+        frameBlock.addStatement (AST::createAssignment (context, AST::createVariableReference (context, cacheIsValid),
+                                                        context.allocator.createConstantBool (true)));
+
+        body.addStatement (AST::createIfStatement (context, *inputsAreUnchanged, cachedOutputBlock, frameBlock), insertIndex++);
+
+        for (auto& write : outputWrites)
+            body.addStatement (write, insertIndex++);
+    }
+
+private:
+    /// Floats are compared by their bit patterns rather than with `==`, because 0.0 and -0.0
+    /// are equal but can give different results, e.g. when divided into something.
+    static AST::Expression& createIsUnchanged (AST::ScopeBlock& block, const AST::TypeBase& type,
+                                               AST::Expression& current, AST::Expression& previous)
+    {
+        auto& context = block.context;
+
+        if (type.isPrimitiveFloat())
+        {
+            auto intrinsics = findIntrinsicsNamespaceFromRoot (block.getRootNamespace());
+            CMAJ_ASSERT (intrinsics != nullptr);
+
+            ref<const AST::TypeBase> parameterTypes[] = { type };
+            auto reinterpretFn = intrinsics->findFunction ("reinterpretFloatToInt", parameterTypes);
+            CMAJ_ASSERT (reinterpretFn != nullptr);
+
+            return AST::createBinaryOp (context, AST::BinaryOpTypeEnum::Enum::equals,
+                                        AST::createFunctionCall (context, *reinterpretFn, current),
+                                        AST::createFunctionCall (context, *reinterpretFn, previous));
+        }
+
+        return AST::createBinaryOp (context, AST::BinaryOpTypeEnum::Enum::equals, current, previous);
+    }
+
+    static bool canBeCompared (const AST::TypeBase& type)
+    {
+        return type.isPrimitiveFloat() || type.isPrimitiveInt() || type.isPrimitiveBool();
+    }
+
+    static bool canBeAccumulated (const AST::TypeBase& type)
+    {
+        return type.isFloatOrVectorOfFloat() || type.isPrimitiveInt();
+    }
+
+    static bool accessesEndpoints (AST::Function& f)
+    {
+        bool found = false;
+
+        f.visitObjectsInScope ([&] (AST::Object& o)
+        {
+            if (AST::castTo<AST::ReadFromEndpoint> (o) != nullptr
+                 || AST::castTo<AST::WriteToEndpoint> (o) != nullptr
+                 || AST::castTo<AST::Advance> (o) != nullptr)
+                found = true;
+        });
+
+        return found;
+    }
+
+    static bool isOutputWrite (const AST::WriteToEndpoint& w, const AST::ObjectRefVector<const AST::EndpointDeclaration>& outputs)
+    {
+        if (w.targetIndex != nullptr || AST::castToValue (w.value) == nullptr)
+            return false;
+
+        if (auto endpoint = w.getEndpoint())
+            for (auto output : outputs)
+                if (output.getPointer() == endpoint.get())
+                    return true;
+
+        return false;
+    }
+
+    static AST::ReadFromEndpoint& createReadFromEndpoint (AST::ScopeBlock& block, const AST::EndpointDeclaration& endpoint)
+    {
+        auto& read = block.allocateChild<AST::ReadFromEndpoint>();
+        auto& endpointInstance = read.allocateChild<AST::EndpointInstance>();
+        endpointInstance.endpoint.createReferenceTo (endpoint);
+        read.endpointInstance.createReferenceTo (endpointInstance);
+        return read;
+    }
+
+    /// Each `out <- x` becomes `_sparseFrame_out += x`, so that multiple writes
+    /// in a frame still get summed, as they would be for the endpoint.
+    static void replaceOutputWrites (AST::ScopeBlock& block,
+                                     const std::unordered_map<const AST::EndpointDeclaration*, AST::VariableDeclaration*>& frameOutputs)
+    {
+        AST::ObjectRefVector<AST::WriteToEndpoint> writes;
+
+        block.visitObjectsInScope ([&] (AST::Object& o)
+        {
+            if (auto w = AST::castTo<AST::WriteToEndpoint> (o))
+                writes.push_back (*w);
+        });
+
+        for (auto& w : writes)
+        {
+            auto& frameOutput = *frameOutputs.at (w->getEndpoint().get());
+            auto& value = *AST::castToValue (w->value);
+
+            auto& accumulate = w->context.allocate<AST::InPlaceOperator>();
+            accumulate.op = AST::BinaryOpTypeEnum::Enum::add;
+            accumulate.target.setChildObject (AST::createVariableReference (w->context, frameOutput));
+            accumulate.source.setChildObject (AST::createCastIfNeeded (*frameOutput.getType(), value));
+
+            w->replaceWith (accumulate);
+        }
+    }
+};
+
+//==============================================================================
+inline void addSparseStreamSupport (AST::Program& program)
+{
+    program.visitAllModules (true, [] (AST::ModuleBase& module)
+    {
+        if (auto processor = AST::castTo<AST::Processor> (module))
+            if (auto loop = SparseStreamSupport::findLoopToCache (*processor))
+                SparseStreamSupport::addOutputCache (*processor, *loop);
+    });
 }
 
 }
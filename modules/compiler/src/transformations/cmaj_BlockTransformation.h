@@ -133,7 +133,8 @@ inline AST::ProcessorBase& cloneProcessor (AST::ProcessorBase& originalProcessor
 }
 
 
-inline AST::ProcessorBase& createBlockTransformProcessor (AST::ProcessorBase& originalProcessor, uint32_t maxBlockSize)
+inline AST::ProcessorBase& createBlockTransformProcessor (AST::ProcessorBase& originalProcessor, uint32_t maxBlockSize,
+                                                         const AST::ObjectRefVector<AST::Function>& nodeStages = {})
 {
     auto& blockProcessor = cloneProcessor (originalProcessor, originalProcessor.getName(), true);
     originalProcessor.setName (originalProcessor.getStringPool().get ("_" + std::string (originalProcessor.getName())));
@@ -198,73 +199,167 @@ inline AST::ProcessorBase& createBlockTransformProcessor (AST::ProcessorBase& or
         auto& currentFrame = AST::createGetStructMember (blockProcessor, stateParam,
                                                          EventHandlerUtilities::getCurrentFrameStateMemberName());
 
-        auto& loop = advance.allocateChild<AST::LoopStatement>();
-        auto& loopBlock = loop.allocateChild<AST::ScopeBlock>();
+        // Adds a loop that goes through each frame in the block, and returns its body
+        auto addFrameLoop = [&] () -> AST::ScopeBlock&
+        {
+            auto& loop = advance.allocateChild<AST::LoopStatement>();
+            auto& loopBlock = loop.allocateChild<AST::ScopeBlock>();
 
-        loop.body.referTo (loopBlock);
+            loop.body.referTo (loopBlock);
 
-        auto& breakStatement = loopBlock.allocateChild<AST::BreakStatement>();
-        breakStatement.targetBlock.referTo (loop);
+            auto& breakStatement = loopBlock.allocateChild<AST::BreakStatement>();
+            breakStatement.targetBlock.referTo (loop);
 
-        auto& ifStatement = AST::createIfStatement (loopBlock.context,
-                                                    AST::createBinaryOp (loopBlock.context,
-                                                                         AST::BinaryOpTypeEnum::Enum::equals,
-                                                                         currentFrame,
-                                                                         framesParam),
-                                                    breakStatement);
+            auto& ifStatement = AST::createIfStatement (loopBlock.context,
+                                                        AST::createBinaryOp (loopBlock.context,
+                                                                             AST::BinaryOpTypeEnum::Enum::equals,
+                                                                             currentFrame,
+                                                                             framesParam),
+                                                        breakStatement);
 
-        loopBlock.addStatement (ifStatement);
+            loopBlock.addStatement (ifStatement);
+            mainBlock.addStatement (loop);
+            return loopBlock;
+        };
 
-        if (auto updateRampsBlock = ValueStreamUtilities::addUpdateRampsCall (blockProcessor, loopBlock, stateParam))
+        auto endFrameLoop = [&] (AST::ScopeBlock& loopBlock)
         {
-            for (auto input : blockProcessor.getInputEndpoints (true))
+            loopBlock.addStatement (AST::createPreInc (loopBlock.context, currentFrame));
+
+            mainBlock.addStatement (AST::createAssignment (mainBlock.context,
+                                                           currentFrame,
+                                                           mainBlock.context.allocator.createConstantInt32 (0)));
+        };
+
+        if (! nodeStages.empty())
+        {
+            // The graph's nodes have been split into stages which each get run over the whole block
+            // before moving on to the next one, so the io for every frame has to be kept. Like the
+            // nodes' own io arrays, this goes in the state, as it would be too big for the stack.
+            auto& wrappedIoType = EventHandlerUtilities::getOrCreateIoStructType (originalProcessor);
+
+            stateType.addMember (stateType.getStringPool().get (EventHandlerUtilities::getIOFramesStateMemberName()),
+                                 AST::createArrayOfType (blockProcessor, wrappedIoType, static_cast<int32_t> (maxBlockSize)));
+
+            auto getFrameIO = [&] (AST::ScopeBlock& block) -> AST::ValueBase&
             {
-                if (input->isValue())
-                {
-                    auto& block = ValueStreamUtilities::dataTypeCanBeInterpolated (input) ? *updateRampsBlock : loopBlock;
+                return AST::createGetElement (block,
+                                              AST::createGetStructMember (block, stateParam, EventHandlerUtilities::getIOFramesStateMemberName()),
+                                              currentFrame);
+            };
 
-                    block.addStatement (AST::createAssignment (block.context,
-                                                               ValueStreamUtilities::getStateStructMember (block.context, input, AST::createGetStructMember (block.context, stateParam, "_state"), false),
-                                                               ValueStreamUtilities::getStateStructMember (block.context, input, stateParam, true)));
-                }
+            {
+                auto& loopBlock = addFrameLoop();
+
+                // The frame's io still holds whatever was written to it on the last block
+                auto& silence = AST::createLocalVariable (loopBlock, "silence", wrappedIoType, {});
+                loopBlock.addStatement (AST::createAssignment (loopBlock.context, getFrameIO (loopBlock),
+                                                               AST::createVariableReference (loopBlock.context, silence)));
+
+                for (auto input : blockProcessor.getInputEndpoints (true))
+                    if (input->isStream())
+                        loopBlock.addStatement (AST::createAssignment (loopBlock.context,
+                                                                       AST::createGetStructMember (loopBlock, getFrameIO (loopBlock), input->getName()),
+                                                                       AST::createGetElement (loopBlock,
+                                                                                              AST::createGetStructMember (loopBlock, ioParam, input->getName()),
+                                                                                              currentFrame)));
+
+                endFrameLoop (loopBlock);
             }
-        }
 
-        auto& ioVariable = AST::createLocalVariable (loopBlock, "ioCopy", EventHandlerUtilities::getOrCreateIoStructType (originalProcessor), {});
+            for (auto& stage : nodeStages)
+            {
+                auto& loopBlock = addFrameLoop();
+                auto& wrappedState = AST::createGetStructMember (loopBlock.context, stateParam, "_state");
 
-        // Populate input streams
-        for (auto input : blockProcessor.getInputEndpoints (true))
-            if (input->isStream())
                 loopBlock.addStatement (AST::createAssignment (loopBlock.context,
-                                                               AST::createGetStructMember (loopBlock,
-                                                                                           AST::createVariableReference (loopBlock.context, ioVariable),
-                                                                                           input->getName()),
-                                                               AST::createGetElement (loopBlock,
-                                                                                      AST::createGetStructMember (loopBlock, ioParam, input->getName()),
-                                                                                      currentFrame)));
-
-        // Call advance
-        if (auto mainFunction = originalProcessor.findMainFunction())
-        {
-            loopBlock.addStatement (AST::createFunctionCall (loopBlock.context,
-                                                             *mainFunction,
-                                                             AST::createGetStructMember (loopBlock.context, stateParam, "_state"),
-                                                             AST::createVariableReference (loopBlock.context, ioVariable)));
-        }
+                                                               AST::createGetStructMember (loopBlock, wrappedState, EventHandlerUtilities::getNodeFrameStateMemberName()),
+                                                               currentFrame));
 
-        // Populate outputs
-        for (auto output : blockProcessor.getOutputEndpoints (true))
-        {
-            if (output->isStream())
-                loopBlock.addStatement (AST::createAssignment (loopBlock.context,
-                                                               AST::createGetElement (loopBlock,
-                                                                                      AST::createGetStructMember (loopBlock, ioParam, output->getName()),
-                                                                                      currentFrame),
-                                                               AST::createGetStructMember (loopBlock, AST::createVariableReference (loopBlock.context, ioVariable), output->getName())));
+                auto& call = AST::createFunctionCall (loopBlock.context, stage.get());
+
+                for (auto& param : stage->iterateParameters())
+                {
+                    if (param.name == param.getStrings()._state)
+                        call.arguments.addChildObject (AST::createGetStructMember (loopBlock.context, stateParam, "_state"));
+                    else if (param.name == param.getStrings()._io)
+                        call.arguments.addChildObject (getFrameIO (loopBlock));
+                    else
+                        CMAJ_ASSERT_FALSE;
+                }
+
+                loopBlock.addStatement (call);
+                endFrameLoop (loopBlock);
+            }
+
+            {
+                auto& loopBlock = addFrameLoop();
+
+                for (auto output : blockProcessor.getOutputEndpoints (true))
+                    if (output->isStream())
+                        loopBlock.addStatement (AST::createAssignment (loopBlock.context,
+                                                                       AST::createGetElement (loopBlock,
+                                                                                              AST::createGetStructMember (loopBlock, ioParam, output->getName()),
+                                                                                              currentFrame),
+                                                                       AST::createGetStructMember (loopBlock, getFrameIO (loopBlock), output->getName())));
+
+                endFrameLoop (loopBlock);
+            }
         }
+        else
+        {
+            auto& loopBlock = addFrameLoop();
+
+            if (auto updateRampsBlock = ValueStreamUtilities::addUpdateRampsCall (blockProcessor, loopBlock, stateParam))
+            {
+                for (auto input : blockProcessor.getInputEndpoints (true))
+                {
+                    if (input->isValue())
+                    {
+                        auto& block = ValueStreamUtilities::dataTypeCanBeInterpolated (input) ? *updateRampsBlock : loopBlock;
+
+                        block.addStatement (AST::createAssignment (block.context,
+                                                                   ValueStreamUtilities::getStateStructMember (block.context, input, AST::createGetStructMember (block.context, stateParam, "_state"), false),
+                                                                   ValueStreamUtilities::getStateStructMember (block.context, input, stateParam, true)));
+                    }
+                }
+            }
+
+            auto& ioVariable = AST::createLocalVariable (loopBlock, "ioCopy", EventHandlerUtilities::getOrCreateIoStructType (originalProcessor), {});
+
+            // Populate input streams
+            for (auto input : blockProcessor.getInputEndpoints (true))
+                if (input->isStream())
+                    loopBlock.addStatement (AST::createAssignment (loopBlock.context,
+                                                                   AST::createGetStructMember (loopBlock,
+                                                                                               AST::createVariableReference (loopBlock.context, ioVariable),
+                                                                                               input->getName()),
+                                                                   AST::createGetElement (loopBlock,
+                                                                                          AST::createGetStructMember (loopBlock, ioParam, input->getName()),
+                                                                                          currentFrame)));
+
+            // Call advance
+            if (auto mainFunction = originalProcessor.findMainFunction())
+            {
+                loopBlock.addStatement (AST::createFunctionCall (loopBlock.context,
+                                                                 *mainFunction,
+                                                                 AST::createGetStructMember (loopBlock.context, stateParam, "_state"),
+                                                                 AST::createVariableReference (loopBlock.context, ioVariable)));
+            }
+
+            // Populate outputs
+            for (auto output : blockProcessor.getOutputEndpoints (true))
+            {
+                if (output->isStream())
+                    loopBlock.addStatement (AST::createAssignment (loopBlock.context,
+                                                                   AST::createGetElement (loopBlock,
+                                                                                          AST::createGetStructMember (loopBlock, ioParam, output->getName()),
+                                                                                          currentFrame),
+                                                                   AST::createGetStructMember (loopBlock, AST::createVariableReference (loopBlock.context, ioVariable), output->getName())));
+            }
 
-        loopBlock.addStatement (AST::createPreInc (loopBlock.context, currentFrame));
-        mainBlock.addStatement (loop);
+            endFrameLoop (loopBlock);
+        }
 
         for (auto output : blockProcessor.getOutputEndpoints (true))
             if (output->isValue())
@@ -275,10 +370,6 @@ inline AST::ProcessorBase& createBlockTransformProcessor (AST::ProcessorBase& or
                                                                AST::createGetStructMember (mainBlock, stateParam, memberName),
                                                                AST::createGetStructMember (mainBlock, AST::createGetStructMember (mainBlock.context, stateParam, "_state"), memberName)));
             }
-
-        mainBlock.addStatement (AST::createAssignment (mainBlock.context,
-                                                       currentFrame,
-                                                       mainBlock.context.allocator.createConstantInt32 (0)));
     }
 
     return blockProcessor;
@@ -0,0 +1,93 @@
+//
+//     ,ad888ba,                              88
+//    d8"'    "8b
+//   d8            88,dba,,adba,   ,aPP8A.A8  88     The Cmajor Toolkit
+//   Y8,           88    88    88  88     88  88
+//    Y8a.   .a8P  88    88    88  88,   ,88  88     (C)2024 Cmajor Software Ltd
+//     '"Y888Y"'   88    88    88  '"8bbP"Y8  88     https://cmajor.dev
+//                                           ,88
+//                                        888P"
+//
+//  The Cmajor project is subject to commercial or open-source licensing.
+//  You may use it under the terms of the GPLv3 (see www.gnu.org/licenses), or
+//  visit https://cmajor.dev to learn about our commercial licence options.
+//
+//  CMAJOR IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+//  EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+//  DISCLAIMED.
+namespace cmaj::transformations
+{
+
+//==============================================================================
+/// Replaces the program's main processor with a graph containing an array of
+/// instances of it, so that the graph flattener generates a single advance
+/// function which runs all of them. Each of the original endpoints is duplicated
+/// for every lane, using the ID returned by EndpointID::getInstanceLaneID().
+///
+/// This doesn't vectorise the code across lanes: each lane keeps its own copy of
+/// the processor's state struct, and the lanes are run one after another within
+/// each frame. It saves the cost of a separate performer and advance call for each
+/// instance, but any SIMD use is left to whatever the backend's optimiser finds.
+///
+/// A structure-of-arrays layout would mean turning each state variable into an array
+/// indexed by lane, and running every statement lane-wise. That only works if all the
+/// lanes follow the same path through main(), but each lane can be waiting at a
+/// different advance() call, or in a different branch, depending on its own inputs
+/// and events. Handling that would need the whole processor to be compiled with
+/// per-lane masks, which is a much bigger change than this transformation.
+static inline void createInstanceLaneGraph (AST::Program& program, uint32_t numLanes)
+{
+    auto& mainProcessor = program.getMainProcessor();
+    auto& parentNamespace = mainProcessor.getParentNamespace();
+
+    auto& graph = parentNamespace.allocateChild<AST::Graph>();
+    graph.name = graph.getStringPool().get (AST::createUniqueName ("_" + std::string (mainProcessor.getName()) + "_lanes",
+                                                                   parentNamespace.subModules));
+    parentNamespace.subModules.addReference (graph);
+
+    auto& node = graph.allocateChild<AST::GraphNode>();
+    node.nodeName = graph.getStrings().processor;
+    node.processorType.createReferenceTo (mainProcessor);
+    node.arraySize.setChildObject (graph.context.allocator.createConstantInt32 (static_cast<int32_t> (numLanes)));
+    graph.nodes.addReference (node);
+
+    for (auto& endpoint : mainProcessor.endpoints.iterateAs<AST::EndpointDeclaration>())
+    {
+        auto endpointID = EndpointID::create (endpoint.getName());
+
+        for (uint32_t lane = 0; lane < numLanes; ++lane)
+        {
+            auto& laneEndpoint = graph.allocateChild<AST::EndpointDeclaration>();
+            laneEndpoint.name = graph.getStringPool().get (endpointID.getInstanceLaneID (lane).toString());
+            laneEndpoint.isInput.set (endpoint.isInput);
+            laneEndpoint.endpointType.set (endpoint.endpointType);
+
+            for (auto& type : endpoint.dataTypes.getAsObjectList())
+                laneEndpoint.dataTypes.addReference (type);
+
+            if (auto a = AST::castTo<AST::Annotation> (endpoint.annotation))
+                laneEndpoint.annotation.referTo (*a);
+
+            if (auto size = endpoint.arraySize.getObject())
+                laneEndpoint.arraySize.referTo (*size);
+
+            graph.endpoints.addReference (laneEndpoint);
+
+            auto& outerInstance = graph.context.allocate<AST::EndpointInstance>();
+            outerInstance.endpoint.createReferenceTo (laneEndpoint);
+
+            auto& laneInstance = graph.context.allocate<AST::EndpointInstance>();
+            laneInstance.endpoint.createReferenceTo (endpoint);
+            laneInstance.node.setChildObject (AST::createGetElement (graph.context, node, static_cast<int32_t> (lane)));
+
+            auto& connection = graph.context.allocate<AST::Connection>();
+            connection.sources.addReference (endpoint.isInput ? outerInstance : laneInstance);
+            connection.dests.addReference (endpoint.isInput ? laneInstance : outerInstance);
+            graph.connections.addReference (connection);
+        }
+    }
+
+    program.setMainProcessor (graph);
+}
+
+}
@@ -138,6 +138,8 @@ struct EventHandlerUtilities
 
     static std::string getWriteEventFunctionName (const AST::EndpointDeclaration& e)    { return "_writeEvent_" + std::string (e.getName()); }
     static std::string getCurrentFrameStateMemberName()                                 { return "_currentFrame"; }
+    static std::string getNodeFrameStateMemberName()                                    { return "_nodeFrame"; }
+    static std::string getIOFramesStateMemberName()                                     { return "_ioFrames"; }
     static std::string getEventCountStateMemberName (std::string_view name)             { return std::string (name) + "_eventCount"; }
     static std::string getEventCountStateMemberName (const AST::EndpointDeclaration& e) { return getEventCountStateMemberName (e.getName()); }
     static std::string getInstanceIndexMemberName()                                     { return "_instanceIndex"; }
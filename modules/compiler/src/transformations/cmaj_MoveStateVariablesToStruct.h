@@ -178,7 +178,8 @@ struct MoveStateVariablesToStruct  : public AST::NonParameterisedObjectVisitor
         if (! processorStateType || f.getParentScope() != processor)
             return;
 
-        if (f.isSystemInitFunction() || f.isEventHandler)
+        // An [[ idleCheck ]] function is called by the parent graph in the same way as main(), so it always needs the state
+        if (f.isSystemInitFunction() || f.isEventHandler || f.isIdleFunction())
             getOrCreateFunctionStateParameter (f);
 
         // main() requires state and io variable
@@ -130,6 +130,9 @@ inline void moveVariablesToState (AST::ProcessorBase& processor)
                 parentBlock.setStatement (static_cast<size_t> (statementIndex), assignment);
             }
 
+            // The underscore marks this as a compiler-generated state variable, which isn't
+            // something that can be matched up with the state of a different build
+            v.name.set (v.getStringPool().get ("_" + std::string (v.name.get())));
             v.variableType = AST::VariableTypeEnum::Enum::state;
             processor.stateVariables.addChildObject (v);
             CMAJ_ASSERT (v.isStateVariable());
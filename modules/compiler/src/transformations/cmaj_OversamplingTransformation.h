@@ -165,15 +165,29 @@ struct OversamplingTransformation
     };
 
     //==============================================================================
-    struct SincBase : public Interpolator
+    /// Resamples by a power of 2 using a cascade of 2x stages, each of which is a
+    /// half-band lowpass filter. If no FIR design is given, the sinc filter is used,
+    /// which is a pair of IIR allpass chains. Otherwise it's the given linear-phase
+    /// HalfBandFIR design.
+    struct HalfBandBase : public Interpolator
     {
-        SincBase (AST::ProcessorBase& p, const AST::EndpointDeclaration& e, int32_t f) : Interpolator (p, e, f)
+        HalfBandBase (AST::ProcessorBase& p, const AST::EndpointDeclaration& e, int32_t f, const HalfBandFIR* fir)
+            : Interpolator (p, e, f), firDesign (fir)
         {
             CMAJ_ASSERT (frameType.isFloatOrVectorOfFloat());
 
-            sincStruct = getOrCreateSincStruct();
-            interpolateFn = getOrCreateInterpolateFn();
-            decimateFn = getOrCreateDecimateFn();
+            if (firDesign != nullptr)
+            {
+                filterStruct = getOrCreateFIRStruct();
+                interpolateFn = getOrCreateFIRInterpolateFn();
+                decimateFn = getOrCreateFIRDecimateFn();
+            }
+            else
+            {
+                filterStruct = getOrCreateSincStruct();
+                interpolateFn = getOrCreateInterpolateFn();
+                decimateFn = getOrCreateDecimateFn();
+            }
 
             interpolationStages = static_cast<int> (0.5 + std::log (f) / std::log (2.0));
         }
@@ -181,13 +195,16 @@ struct OversamplingTransformation
         void populateReset (AST::ScopeBlock& block, AST::ValueBase& stateParam) override
         {
             auto& zeroValue = block.context.allocate<AST::ConstantAggregate>();
-            zeroValue.type.createReferenceTo (getOrCreateSincStruct());
+            zeroValue.type.createReferenceTo (*filterStruct);
 
-            for (int i = 0; i < interpolationStages; i++)
+            for (int element = 0; element < getArrayElements(); element++)
             {
-                auto& filterMember = AST::createGetElement (block, AST::createGetStructMember (block.context, stateParam, getFilterStateMemberName()), i);
+                for (int i = 0; i < interpolationStages; i++)
+                {
+                    auto& filterMember = AST::createGetElement (block, getArrayElement (block, AST::createGetStructMember (block.context, stateParam, getFilterStateMemberName()), element), i);
 
-                AST::addAssignment (block, filterMember, zeroValue);
+                    AST::addAssignment (block, filterMember, zeroValue);
+                }
             }
         }
 
@@ -318,6 +335,116 @@ struct OversamplingTransformation
             return fn;
         }
 
+        /// Each FIR design needs its own state struct and functions, so their names
+        /// include the number of taps.
+        std::string getFIRName (std::string_view prefix) const
+        {
+            return std::string (prefix) + std::to_string (4 * firDesign->numTapPairs - 1) + "_";
+        }
+
+        AST::TypeBase& getOrCreateFIRStruct()
+        {
+            auto typeName = getFrameTypeName (getFIRName ("_HalfBandFIR"));
+
+            if (auto t = processor.findStruct (typeName))
+                return *t;
+
+            auto& t = AST::createStruct (processor, typeName);
+
+            // x holds the most recent inputs (or the odd-phase inputs when decimating), and
+            // e holds the even-phase inputs that are delayed to line up with the centre tap
+            t.addMember ("x", AST::createArrayOfType (processor, frameType, 2 * firDesign->numTapPairs));
+            t.addMember ("e", AST::createArrayOfType (processor, frameType, firDesign->numTapPairs));
+
+            return t;
+        }
+
+        static AST::ValueBase& getHistoryElement (AST::ScopeBlock& block, AST::ValueBase& filter, std::string_view member, int index)
+        {
+            return AST::createGetElement (block.context, AST::createGetStructMember (block.context, filter, member), index);
+        }
+
+        static void addHistoryShift (AST::ScopeBlock& block, const AST::VariableRefGenerator& filter, std::string_view member, int length, AST::ValueBase& newValue)
+        {
+            for (int i = length - 1; i > 0; --i)
+                AST::addAssignment (block, getHistoryElement (block, filter, member, i), getHistoryElement (block, filter, member, i - 1));
+
+            AST::addAssignment (block, getHistoryElement (block, filter, member, 0), newValue);
+        }
+
+        /// Applies the non-zero taps either side of the centre to the inputs in x.
+        AST::ValueBase& createFIRTapSum (AST::ScopeBlock& block, const AST::VariableRefGenerator& filter, float gain)
+        {
+            ptr<AST::ValueBase> sum;
+
+            for (int i = 0; i < firDesign->numTapPairs; ++i)
+            {
+                auto& pair = AST::createAdd (block.context,
+                                             getHistoryElement (block, filter, "x", firDesign->numTapPairs - 1 - i),
+                                             getHistoryElement (block, filter, "x", firDesign->numTapPairs + i));
+
+                auto& tap = AST::createMultiply (block.context, pair, block.context.allocator.createConstantFloat32 (gain * firDesign->coefficients[i]));
+
+                sum = sum == nullptr ? tap : AST::createAdd (block.context, *sum, tap);
+            }
+
+            return *sum;
+        }
+
+        AST::Function& getOrCreateFIRInterpolateFn()
+        {
+            auto functionName = getFrameTypeName (getFIRName ("_FIRInterpolate"));
+
+            if (auto fn = processor.findFunction (functionName, 4))
+                return *fn;
+
+            auto& fn = AST::createFunctionInModule (processor, processor.context.allocator.createVoidType(), functionName);
+
+            auto filterParam  = AST::addFunctionParameter (fn, getOrCreateFIRStruct(), "filter", true, false);
+            auto inParam      = AST::addFunctionParameter (fn, frameType, "in", false, false);
+            auto out1Param    = AST::addFunctionParameter (fn, frameType, "out1", true, false);
+            auto out2Param    = AST::addFunctionParameter (fn, frameType, "out2", true, false);
+
+            auto& mainBlock = *fn.getMainBlock();
+
+            // The even output is the input at the centre tap, and the odd one is the other
+            // polyphase branch. Zero-stuffing halves the level, so the taps are doubled.
+            addHistoryShift (mainBlock, filterParam, "x", 2 * firDesign->numTapPairs, inParam);
+
+            AST::addAssignment (mainBlock, out1Param, getHistoryElement (mainBlock, filterParam, "x", firDesign->numTapPairs));
+            AST::addAssignment (mainBlock, out2Param, createFIRTapSum (mainBlock, filterParam, 2.0f));
+
+            return fn;
+        }
+
+        AST::Function& getOrCreateFIRDecimateFn()
+        {
+            auto functionName = getFrameTypeName (getFIRName ("_FIRDecimate"));
+
+            if (auto fn = processor.findFunction (functionName, 4))
+                return *fn;
+
+            auto& fn = AST::createFunctionInModule (processor, processor.context.allocator.createVoidType(), functionName);
+
+            auto filterParam  = AST::addFunctionParameter (fn, getOrCreateFIRStruct(), "filter", true, false);
+            auto in1Param     = AST::addFunctionParameter (fn, frameType, "in1", false, false);
+            auto in2Param     = AST::addFunctionParameter (fn, frameType, "in2", false, false);
+            auto outParam     = AST::addFunctionParameter (fn, frameType, "out", true, false);
+
+            auto& mainBlock = *fn.getMainBlock();
+
+            addHistoryShift (mainBlock, filterParam, "e", firDesign->numTapPairs, in1Param);
+            addHistoryShift (mainBlock, filterParam, "x", 2 * firDesign->numTapPairs, in2Param);
+
+            auto& centre = AST::createMultiply (mainBlock.context,
+                                                getHistoryElement (mainBlock, filterParam, "e", firDesign->numTapPairs - 1),
+                                                mainBlock.context.allocator.createConstantFloat32 (0.5f));
+
+            AST::addAssignment (mainBlock, outParam, AST::createAdd (mainBlock.context, centre, createFIRTapSum (mainBlock, filterParam, 1.0f)));
+
+            return fn;
+        }
+
     protected:
         std::string getIndexStateMemberName() const
         {
@@ -329,21 +456,22 @@ struct OversamplingTransformation
             return getEndpointStateValuesName() + "_filter";
         }
 
+        const HalfBandFIR* firDesign;
         int interpolationStages;
-        ptr<AST::TypeBase> sincStruct;
+        ptr<AST::TypeBase> filterStruct;
         ptr<AST::Function> interpolateFn, decimateFn;
     };
 
     //==============================================================================
-    struct SincUpsampler   : public SincBase
+    struct HalfBandUpsampler   : public HalfBandBase
     {
-        SincUpsampler (AST::ProcessorBase& p, const AST::EndpointDeclaration& e, int32_t f) : SincBase (p, e, f)
+        HalfBandUpsampler (AST::ProcessorBase& p, const AST::EndpointDeclaration& e, int32_t f, const HalfBandFIR* fir) : HalfBandBase (p, e, f, fir)
         {
             auto& stateType = EventHandlerUtilities::getOrCreateStateStructType (processor);
 
             auto& arrayType = AST::createArrayOfType (processor, frameType, factor);
             stateType.addMember (getEndpointStateValuesName(), convertTypeWithArraySize (arrayType));
-            stateType.addMember (getFilterStateMemberName(), convertTypeWithArraySize (AST::createArrayOfType (processor, *sincStruct, interpolationStages)));
+            stateType.addMember (getFilterStateMemberName(), convertTypeWithArraySize (AST::createArrayOfType (processor, *filterStruct, interpolationStages)));
             stateType.addMember (getIndexStateMemberName(), p.context.allocator.createInt32Type());
         }
 
@@ -409,15 +537,15 @@ struct OversamplingTransformation
     };
 
     //==============================================================================
-    struct SincDownsampler   : public SincBase
+    struct HalfBandDownsampler   : public HalfBandBase
     {
-        SincDownsampler (AST::ProcessorBase& p, const AST::EndpointDeclaration& e, int32_t f) : SincBase (p, e, f)
+        HalfBandDownsampler (AST::ProcessorBase& p, const AST::EndpointDeclaration& e, int32_t f, const HalfBandFIR* fir) : HalfBandBase (p, e, f, fir)
         {
             auto& stateType = EventHandlerUtilities::getOrCreateStateStructType (processor);
 
             auto& arrayType = AST::createArrayOfType (processor, frameType, factor);
             stateType.addMember (getEndpointStateValuesName(), convertTypeWithArraySize (arrayType));
-            stateType.addMember (getFilterStateMemberName(), convertTypeWithArraySize (AST::createArrayOfType (processor, *sincStruct, interpolationStages)));
+            stateType.addMember (getFilterStateMemberName(), convertTypeWithArraySize (AST::createArrayOfType (processor, *filterStruct, interpolationStages)));
             stateType.addMember (getIndexStateMemberName(), p.context.allocator.createInt32Type());
         }
 
@@ -501,7 +629,9 @@ struct OversamplingTransformation
                 case AST::InterpolationTypeEnum::Enum::latch:   return std::make_unique<ValueLatch> (processor, endpoint, oversampleFactor);
 
                 case AST::InterpolationTypeEnum::Enum::best:
-                case AST::InterpolationTypeEnum::Enum::sinc:    return std::make_unique<SincUpsampler> (processor, endpoint, oversampleFactor);
+                case AST::InterpolationTypeEnum::Enum::sinc:    return std::make_unique<HalfBandUpsampler> (processor, endpoint, oversampleFactor, nullptr);
+                case AST::InterpolationTypeEnum::Enum::fir:     return std::make_unique<HalfBandUpsampler> (processor, endpoint, oversampleFactor, std::addressof (HalfBandFIR::getHighQuality()));
+                case AST::InterpolationTypeEnum::Enum::fastFir: return std::make_unique<HalfBandUpsampler> (processor, endpoint, oversampleFactor, std::addressof (HalfBandFIR::getLowLatency()));
 
                 default:
                     CMAJ_ASSERT_FALSE;
@@ -517,7 +647,9 @@ struct OversamplingTransformation
                 case AST::InterpolationTypeEnum::Enum::linear:  return std::make_unique<ValueLatch> (processor, endpoint, undersampleFactor);
 
                 case AST::InterpolationTypeEnum::Enum::best:
-                case AST::InterpolationTypeEnum::Enum::sinc:    return std::make_unique<SincDownsampler> (processor, endpoint, undersampleFactor);
+                case AST::InterpolationTypeEnum::Enum::sinc:    return std::make_unique<HalfBandDownsampler> (processor, endpoint, undersampleFactor, nullptr);
+                case AST::InterpolationTypeEnum::Enum::fir:     return std::make_unique<HalfBandDownsampler> (processor, endpoint, undersampleFactor, std::addressof (HalfBandFIR::getHighQuality()));
+                case AST::InterpolationTypeEnum::Enum::fastFir: return std::make_unique<HalfBandDownsampler> (processor, endpoint, undersampleFactor, std::addressof (HalfBandFIR::getLowLatency()));
 
                 default:
                     CMAJ_ASSERT_FALSE;
@@ -24,7 +24,8 @@ struct FlattenGraph
 {
     struct Renderer
     {
-        Renderer (AST::ProcessorBase& g, ProcessorInfo::GetInfo getInfo) : graph (g), getProcessorInfo (getInfo)
+        Renderer (AST::ProcessorBase& g, ProcessorInfo::GetInfo getInfo, uint32_t blockSize = 0)
+            : graph (g), getProcessorInfo (getInfo), nodeBlockSize (blockSize)
         {
             initFunction = g.findSystemInitFunction();
             mainFunction = g.findMainFunction();
@@ -42,6 +43,10 @@ struct FlattenGraph
 
 
             processorGraphOutput = mainFunction->context.allocate<AST::ScopeBlock>();
+
+            if (nodeBlockSize != 0)
+                nodeFrame = AST::createStateVariable (graph, EventHandlerUtilities::getNodeFrameStateMemberName(),
+                                                      graph.context.allocator.createInt32Type(), {});
         }
 
         EndpointInterpolationStrategy getEndpointInterpolationStrategy (AST::GraphNode& node) const
@@ -164,7 +169,17 @@ struct FlattenGraph
 
             ptr<AST::VariableReference> ioVariable;
 
-            if (! useStateForIO)
+            if (nodeBlockSize != 0)
+            {
+                // When the nodes are rendered in blocks, each node needs to keep its io for every frame
+                auto& ioFramesType = AST::createArrayOfType (graph, *getIOStruct (*processorType, arraySize),
+                                                             static_cast<int32_t> (nodeBlockSize));
+
+                auto& io = AST::createStateVariable (graph, nodeName + "_io", ioFramesType, {});
+
+                ioVariable = AST::createVariableReference (graph.context, io);
+            }
+            else if (! useStateForIO)
             {
                 ioVariable = AST::createLocalVariableRef (*mainFunction->getMainBlock(),
                                                           nodeName + "_io",
@@ -285,7 +300,10 @@ struct FlattenGraph
             for (auto& node : delayNodes)
             {
                 auto& instanceInfo = getInfoForNode (*node);
-                addRunCall (*mainFunction->getMainBlock(), *node);
+
+                if (! addStreamDelayRead (*mainFunction->getMainBlock(), *node))
+                    addRunCall (*mainFunction->getMainBlock(), *node);
+
                 instanceInfo.hasBeenRun = true;
             }
 
@@ -300,7 +318,26 @@ struct FlattenGraph
                 ensureNodeIsRendered (*node);
             }
 
-            mainFunction->getMainBlock()->addStatement (*processorGraphOutput);
+            if (nodeBlockSize != 0)
+                createNodeStageFunction ("graphOutput").getMainBlock()->addStatement (*processorGraphOutput);
+            else
+                mainFunction->getMainBlock()->addStatement (*processorGraphOutput);
+        }
+
+        static constexpr std::string_view nodeStageFunctionPrefix = "_stage_";
+
+        /// When the nodes are rendered in blocks, each node's steps and run call go into a function
+        /// of their own, which the block processor calls for every frame in the block before moving
+        /// on to the next one. This returns those functions in the order that they need to be run.
+        static AST::ObjectRefVector<AST::Function> getNodeStageFunctions (AST::ProcessorBase& processor)
+        {
+            AST::ObjectRefVector<AST::Function> stages;
+
+            for (auto& f : processor.functions.iterateAs<AST::Function>())
+                if (f.getName().get().substr (0, nodeStageFunctionPrefix.length()) == nodeStageFunctionPrefix)
+                    stages.push_back (f);
+
+            return stages;
         }
 
         struct InstanceInfo
@@ -606,9 +643,82 @@ struct FlattenGraph
             for (auto& dependency : instanceInfo.dependencies)
                 ensureNodeIsRendered (dependency);
 
+            if (nodeBlockSize != 0)
+            {
+                auto& block = *createNodeStageFunction (node.getName().get()).getMainBlock();
+
+                // The io for this frame will still hold whatever was written to it on the last block,
+                // so needs clearing before the steps accumulate into it
+                auto& silence = AST::createLocalVariable (block, "silence", getIOStruct (*node.getProcessorType(), node.getArraySize()), {});
+                block.addStatement (AST::createAssignment (block.context, getIO (instanceInfo), AST::createVariableReference (block.context, silence)));
+
+                block.addStatement (*instanceInfo.steps);
+                addRunCall (block, node);
+                return;
+            }
+
             mainFunction->getMainBlock()->addStatement (*instanceInfo.steps);
 
-            addRunCall (*mainFunction->getMainBlock(), node);
+            if (! (isDelayNode (node) && addStreamDelayWrite (*mainFunction->getMainBlock(), node)))
+                addRunCall (*mainFunction->getMainBlock(), node);
+        }
+
+        /// A delay on a stream connection is a StreamDelay node, whose output is read before any other
+        /// node runs, and whose input is written once they've all finished. Rather than running its
+        /// main() for each half, which means going through its resume points twice per frame, these
+        /// call its read() and write() functions directly. Other kinds of delay node return false.
+        bool addStreamDelayRead (AST::ScopeBlock& block, const AST::GraphNode& node)
+        {
+            auto processorType = node.getProcessorType();
+            auto readFunction = processorType->findFunction ("read", 1);
+
+            if (readFunction == nullptr)
+                return false;
+
+            auto& instanceInfo = getInfoForNode (node);
+            auto output = processorType->getOutputEndpoints (true)[0];
+
+            block.addStatement (AST::createAssignment (block.context,
+                                                       AST::createGetStructMember (block, instanceInfo.ioVariable.get(),
+                                                                                   StreamUtilities::getEndpointStateMemberName (output)),
+                                                       AST::createFunctionCall (block, *readFunction, instanceInfo.stateVariable.get())));
+            return true;
+        }
+
+        bool addStreamDelayWrite (AST::ScopeBlock& block, const AST::GraphNode& node)
+        {
+            auto processorType = node.getProcessorType();
+            auto writeFunction = processorType->findFunction ("write", 2);
+
+            if (writeFunction == nullptr)
+                return false;
+
+            auto& instanceInfo = getInfoForNode (node);
+            auto input = processorType->getInputEndpoints (true)[0];
+
+            block.addStatement (AST::createFunctionCall (block, *writeFunction, instanceInfo.stateVariable.get(),
+                                                         AST::createGetStructMember (block, instanceInfo.ioVariable.get(),
+                                                                                     StreamUtilities::getEndpointStateMemberName (input))));
+            return true;
+        }
+
+        AST::Function& createNodeStageFunction (std::string_view name)
+        {
+            auto stageName = AST::createUniqueName (std::string (nodeStageFunctionPrefix) + std::string (name), graph.functions);
+            return AST::createFunctionInModule (graph, graph.context.allocator.voidType, graph.getStringPool().get (stageName));
+        }
+
+        /// Returns the io for a node. When the nodes are rendered in blocks, this is the element
+        /// for the current frame, and as it ends up in a different function for each node, it needs
+        /// a new reference each time.
+        AST::ValueBase& getIO (const InstanceInfo& instanceInfo)
+        {
+            if (nodeFrame == nullptr)
+                return instanceInfo.ioVariable.get();
+
+            return AST::createGetElement (graph.context,
+                                          AST::createVariableReference (graph.context, instanceInfo.ioVariable->getVariable()),
+                                          AST::createVariableReference (graph.context, *nodeFrame));
         }
 
         AST::ValueBase& getStructMember (ptr<AST::ScopeBlock> block,
@@ -631,8 +741,8 @@ struct FlattenGraph
 
             auto& instanceInfo = getInfoForNode (endpointInstance.getNode());
 
-            ref<AST::ValueBase> expr = endpoint->isStream() ? instanceInfo.ioVariable
-                                                            : instanceInfo.stateVariable;
+            ref<AST::ValueBase> expr = endpoint->isStream() ? getIO (instanceInfo)
+                                                            : instanceInfo.stateVariable.get();
 
             if (nodeArraySize)
                 expr = AST::createGetElement (block, expr, index);
@@ -819,25 +929,97 @@ struct FlattenGraph
             if (auto processorMainFunction = node.getProcessorType()->findMainFunction())
             {
                 auto& instanceInfo = getInfoForNode (node);
+                auto isIdleFunction = node.getProcessorType()->findIsIdleFunction();
 
                 if (auto arraySize = node.getArraySize())
                 {
                     addLoop (block, *arraySize, [&] (AST::ScopeBlock& loopBlock, AST::ValueBase& index)
                     {
-                        addRunCall (loopBlock,
+                        addRunCall (getBlockToRunIn (loopBlock, isIdleFunction, AST::createGetElement (block, instanceInfo.stateVariable, index)),
                                     processorMainFunction,
                                     AST::createGetElement (block, instanceInfo.stateVariable, index),
-                                    AST::createGetElement (block, instanceInfo.ioVariable, index));
+                                    AST::createGetElement (block, getIO (instanceInfo), index));
                     });
                 }
                 else
                 {
-                    addRunCall (block, processorMainFunction,
-                                instanceInfo.stateVariable, instanceInfo.ioVariable);
+                    addRunCall (getBlockToRunIn (*block, isIdleFunction, instanceInfo.stateVariable),
+                                processorMainFunction,
+                                instanceInfo.stateVariable, getIO (instanceInfo));
                 }
             }
         }
 
+        /// A node whose processor has an [[ idleCheck ]] function only runs when that returns false. The
+        /// node's io struct is a local that starts as zero on each frame, so while it's asleep its
+        /// stream outputs are silent, and its event handlers still get called to wake it up.
+        static AST::ScopeBlock& getBlockToRunIn (AST::ScopeBlock& block, ptr<AST::Function> isIdleFunction, AST::ValueBase& stateVariable)
+        {
+            if (isIdleFunction == nullptr)
+                return block;
+
+            auto& runBlock = block.allocateChild<AST::ScopeBlock>();
+            auto& isIdle = AST::createFunctionCall (block, *isIdleFunction, stateVariable);
+            block.addStatement (AST::createIfStatement (block.context, AST::createLogicalNot (block.context, isIdle), runBlock));
+            return runBlock;
+        }
+
+        /// For a graph with the [[ sleepWhenIdle ]] annotation, this creates an isIdle() function
+        /// which returns true when all of its nodes that have an [[ idleCheck ]] function are idle, so
+        /// that the parent graph can put the whole graph to sleep. Any other nodes just stop where
+        /// they are until it wakes up again, so this is intended for things like a synth voice,
+        /// whose output is silent once its envelopes have finished.
+        void addIsIdleFunction()
+        {
+            std::vector<const AST::GraphNode*> nodesWhichCanBeIdle;
+
+            for (auto& node : nodesToRender)
+                if (node->getProcessorType()->findIsIdleFunction() != nullptr)
+                    nodesWhichCanBeIdle.push_back (node);
+
+            if (nodesWhichCanBeIdle.empty())
+                return;
+
+            auto& isIdleFunction = AST::createFunctionInModule (graph, graph.context.allocator.boolType, graph.getStrings().isIdleFunctionName);
+            auto& block = *isIdleFunction.getMainBlock();
+
+            auto& annotation = isIdleFunction.allocateChild<AST::Annotation>();
+            annotation.setValue (graph.getStringPool().get ("idleCheck"), graph.context.allocator.createConstantBool (true));
+            isIdleFunction.annotation.referTo (annotation);
+
+            auto addCheck = [] (AST::ScopeBlock& b, AST::Function& nodeIsIdleFunction, AST::ValueBase& nodeState)
+            {
+                auto& returnBlock = b.allocateChild<AST::ScopeBlock>();
+                AST::addReturnStatement (returnBlock, b.context.allocator.createConstantBool (false));
+
+                auto& nodeIsIdle = AST::createFunctionCall (b, nodeIsIdleFunction, nodeState);
+                b.addStatement (AST::createIfStatement (b.context, AST::createLogicalNot (b.context, nodeIsIdle), returnBlock));
+            };
+
+            for (auto node : nodesWhichCanBeIdle)
+            {
+                auto& nodeIsIdleFunction = *node->getProcessorType()->findIsIdleFunction();
+
+                // This needs its own reference to the node's state, as the one in the
+                // InstanceInfo belongs to main()
+                auto& nodeState = AST::createVariableReference (block.context, getInfoForNode (*node).stateVariable->getVariable());
+
+                if (auto arraySize = node->getArraySize())
+                {
+                    addLoop (block, *arraySize, [&] (AST::ScopeBlock& loopBlock, AST::ValueBase& index)
+                    {
+                        addCheck (loopBlock, nodeIsIdleFunction, AST::createGetElement (loopBlock, nodeState, index));
+                    });
+                }
+                else
+                {
+                    addCheck (block, nodeIsIdleFunction, nodeState);
+                }
+            }
+
+            AST::addReturnStatement (block, block.context.allocator.createConstantBool (true));
+        }
+
         static void addRunCall (ptr<AST::ScopeBlock> block, ptr<AST::Function> mainFunction,
                                 AST::ValueBase& stateVariable, AST::ValueBase& ioVariable)
         {
@@ -875,15 +1057,75 @@ struct FlattenGraph
         ProcessorInfo::GetInfo getProcessorInfo;
         ptr<AST::Function> initFunction, mainFunction;
         int32_t nextProcessorId = 1;
+        uint32_t nodeBlockSize = 0;
+        ptr<AST::VariableDeclaration> nodeFrame;
 
         std::unordered_map<const AST::GraphNode*, std::unique_ptr<InstanceInfo>> nodeInstanceInfoMap;
         std::vector<const AST::GraphNode*> nodesToRender, delayNodes;
         ptr<AST::ScopeBlock> processorGraphOutput;
     };
 
-    static void flattenGraph (AST::Graph& graph, ProcessorInfo::GetInfo getInfo, uint32_t eventBufferSize, bool isTopLevelProcessor)
+    /// Running each node over a whole block before moving on to the next one only gives the same
+    /// result as running the graph a frame at a time if nothing but streams pass between the nodes,
+    /// as an event or value would otherwise arrive too late. Delays are also ruled out, because a
+    /// feedback loop needs each frame to be finished before the next one starts. (A delay outside
+    /// a loop could copy whole blocks in and out of its buffer, but that isn't implemented.)
+    static bool canRenderNodesInBlocks (AST::Graph& graph)
     {
-        Renderer renderer (graph, getInfo);
+        if (graph.nodes.size() < 2)
+            return false;
+
+        for (auto& node : graph.nodes.iterateAs<AST::GraphNode>())
+            if (Renderer::isDelayNode (node))
+                return false;
+
+        // Value inputs get their ramps updated on every frame by the block processor
+        for (auto input : graph.getInputEndpoints (true))
+            if (input->isValue())
+                return false;
+
+        auto isNodeStream = [] (const AST::EndpointInstance& e)
+        {
+            return e.isParentEndpoint() || e.getEndpoint (true)->isStream();
+        };
+
+        for (auto& connection : graph.connections.iterateAs<AST::Connection>())
+        {
+            for (auto& source : connection.sources)
+            {
+                if (auto element = AST::castToSkippingReferences<AST::GetElement> (source))
+                {
+                    if (auto endpointInstance = AST::castToSkippingReferences<AST::EndpointInstance> (element->parent))
+                        if (! isNodeStream (*endpointInstance))
+                            return false;
+                }
+                else if (auto endpointInstance = AST::castToSkippingReferences<AST::EndpointInstance> (source))
+                {
+                    if (! isNodeStream (*endpointInstance))
+                        return false;
+                }
+                else if (auto value = AST::castToSkippingReferences<AST::ValueBase> (source))
+                {
+                    // A node's endpoint in an expression is read via its io, which won't be
+                    // indexed by frame
+                    for (auto i : GraphConnectivityModel::getUsedEndpointInstances (*value))
+                        if (! i->isParentEndpoint())
+                            return false;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    static void flattenGraph (AST::Graph& graph, ProcessorInfo::GetInfo getInfo, uint32_t eventBufferSize,
+                              bool isTopLevelProcessor, uint32_t nodeBlockSize)
+    {
+        Renderer renderer (graph, getInfo, nodeBlockSize != 0 && canRenderNodesInBlocks (graph) ? nodeBlockSize : 0);
 
         for (auto& i : graph.nodes)
             if (auto node = AST::castTo<AST::GraphNode> (i))
@@ -896,6 +1138,10 @@ struct FlattenGraph
 
         renderer.populateMainFunction();
 
+        if (auto annotation = AST::castTo<AST::Annotation> (graph.annotation))
+            if (annotation->getPropertyAs<bool> ("sleepWhenIdle"))
+                renderer.addIsIdleFunction();
+
         moveStateVariablesToStruct (graph, eventBufferSize, isTopLevelProcessor, [&] (const AST::GraphNode& node) -> MoveStateVariablesToStruct::NodeInfo
                                     {
                                         auto& info = renderer.getInfoForNode (node);
@@ -1004,7 +1250,8 @@ struct FlattenGraph
 inline void flatten (AST::Program& program, AST::ProcessorBase& processor,
                      bool isTopLevelProcessor, ProcessorInfo::GetInfo getInfo,
                      uint32_t eventBufferSize,
-                     bool useForwardBranch)
+                     bool useForwardBranch,
+                     uint32_t nodeBlockSize = 0)
 {
     // First ensure all nodes are flattened
     for (auto& n : processor.nodes)
@@ -1031,7 +1278,7 @@ inline void flatten (AST::Program& program, AST::ProcessorBase& processor,
 
     if (auto graph = processor.getAsGraph())
     {
-        FlattenGraph::flattenGraph (*graph, getInfo, eventBufferSize, isTopLevelProcessor);
+        FlattenGraph::flattenGraph (*graph, getInfo, eventBufferSize, isTopLevelProcessor, nodeBlockSize);
     }
     else
     {
@@ -1047,18 +1294,21 @@ inline void flatten (AST::Program& program, AST::ProcessorBase& processor,
 inline void flattenGraph (AST::Program& program,
                           uint32_t maxBlockSize,
                           uint32_t eventBufferSize,
-                          bool useForwardBranch)
+                          bool useForwardBranch,
+                          bool renderNodesInBlocks)
 {
     ProcessorInfoManager processorInfoManager;
 
     bool isBlockProcessor = maxBlockSize > 1;
 
     flatten (program, program.getMainProcessor(), ! isBlockProcessor,
-             processorInfoManager.getProcessorInfo(), eventBufferSize, useForwardBranch);
+             processorInfoManager.getProcessorInfo(), eventBufferSize, useForwardBranch,
+             isBlockProcessor && renderNodesInBlocks ? maxBlockSize : 0);
 
     if (isBlockProcessor)
     {
-        auto& blockProcessor = createBlockTransformProcessor (program.getMainProcessor(), maxBlockSize);
+        auto& blockProcessor = createBlockTransformProcessor (program.getMainProcessor(), maxBlockSize,
+                                                              FlattenGraph::Renderer::getNodeStageFunctions (program.getMainProcessor()));
         moveStateVariablesToStruct (blockProcessor, eventBufferSize, true);
 
         program.setMainProcessor (blockProcessor);
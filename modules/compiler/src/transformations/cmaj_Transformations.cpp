@@ -19,6 +19,7 @@
 #include <iostream>
 #include <map>
 #include <set>
+#include <unordered_set>
 
 #include "../../include/cmaj_ErrorHandling.h"
 #include "choc/text/choc_Wildcard.h"
@@ -49,6 +50,7 @@
 #include "cmaj_RemoveUnusedNodes.h"
 #include "cmaj_AddSparseStreamSupport.h"
 #include "cmaj_CloneGraphNodes.h"
+#include "cmaj_CreateInstanceLanes.h"
 #include "cmaj_BinaryModuleFormat.h"
 #include "cmaj_MergeDuplicateNamespaces.h"
 #include "cmaj_ObfuscateNames.h"
@@ -61,34 +63,98 @@
 namespace cmaj::transformations
 {
 
+template <typename PassType, typename... Args>
+static passes::PassResult runResolutionPass (AST::Program& program, std::string_view name, size_t numModules, Args&&... args)
+{
+    auto timer = program.compileProfile.measure ("pass", name, program.allocator);
+    auto result = passes::runPass<PassType> (program, args...);
+
+    auto& counts = program.resolutionStatistics.getPass (name);
+    ++counts.numRuns;
+    counts.numModulesVisited += numModules;
+    counts.numObjectsVisited += result.numObjectsVisited;
+    counts.numChanges += result.numChanges;
+    return result;
+}
+
+template <typename... Args>
+static passes::PassResult runAllResolutionPasses (AST::Program& program, size_t numModules, Args&&... args)
+{
+    passes::PassResult result;
+
+    result += runResolutionPass<passes::TypeResolver>        (program, "TypeResolver",        numModules, args...);
+    result += runResolutionPass<passes::FunctionResolver>    (program, "FunctionResolver",    numModules, args...);
+    result += runResolutionPass<passes::NameResolver>        (program, "NameResolver",        numModules, args...);
+    result += runResolutionPass<passes::ModuleSpecialiser>   (program, "ModuleSpecialiser",   numModules, args...);
+    result += runResolutionPass<passes::ProcessorResolver>   (program, "ProcessorResolver",   numModules, args...);
+    result += runResolutionPass<passes::EndpointResolver>    (program, "EndpointResolver",    numModules, args...);
+    result += runResolutionPass<passes::ConstantFolder>      (program, "ConstantFolder",      numModules, args...);
+    result += runResolutionPass<passes::StrengthReduction>   (program, "StrengthReduction",   numModules, args...);
+    result += runResolutionPass<passes::ExternalResolver>    (program, "ExternalResolver",    numModules, args...);
+
+    return result;
+}
+
+/// Runs one step of a transformation sequence as a separately-timed stage of the build
+template <typename Fn>
+static auto runStage (AST::Program& program, std::string_view name, Fn&& fn)
+{
+    auto timer = program.compileProfile.measure ("transformation", name, program.allocator);
+    return fn();
+}
+
 static void runResolutionPasses (AST::Program& program, bool throwOnErrors)
 {
+    auto timer = program.compileProfile.measure ("resolution", "runResolutionPasses", program.allocator);
+
+    // Each top-level module is a unit of work: once a round of passes leaves one unchanged
+    // and without failures, it's dropped from the worklist, and later rounds only revisit
+    // the others. Because a pass can occasionally modify or unblock something in a module
+    // other than the one it's visiting, the loop only finishes when a final round over the
+    // whole program makes no changes.
+    auto& stats = program.resolutionStatistics;
+    std::unordered_set<const AST::Object*> settledModules;
+
     for (;;)
     {
-        passes::PassResult result;
-
-        result += passes::runPass<passes::TypeResolver>             (program, throwOnErrors);
-        result += passes::runPass<passes::FunctionResolver>         (program, throwOnErrors);
-        result += passes::runPass<passes::NameResolver>             (program, throwOnErrors);
-        result += passes::runPass<passes::ModuleSpecialiser>        (program, throwOnErrors);
-        result += passes::runPass<passes::ProcessorResolver>        (program, throwOnErrors);
-        result += passes::runPass<passes::EndpointResolver>         (program, throwOnErrors);
-        result += passes::runPass<passes::ConstantFolder>           (program, throwOnErrors);
-        result += passes::runPass<passes::StrengthReduction>        (program, throwOnErrors);
-        result += passes::runPass<passes::ExternalResolver>         (program, throwOnErrors);
-
-        if (result.numChanges == 0)
+        auto allModules = program.rootNamespace.getSubModules();
+        AST::ObjectRefVector<AST::ModuleBase> worklist;
+
+        for (auto& m : allModules)
+            if (settledModules.find (std::addressof (m.get())) == settledModules.end())
+                worklist.push_back (m);
+
+        ++stats.numRounds;
+        stats.numModulesVisited += worklist.size();
+        stats.numModulesSkipped += allModules.size() - worklist.size();
+
+        std::vector<passes::PassResult> moduleResults (worklist.size());
+        auto result = runAllResolutionPasses (program, worklist.size(), worklist, moduleResults, throwOnErrors);
+
+        for (size_t i = 0; i < worklist.size(); ++i)
+            if (moduleResults[i].numChanges == 0 && moduleResults[i].numFailures == 0)
+                settledModules.insert (std::addressof (worklist[i].get()));
+
+        if (result.numChanges != 0)
+            continue;
+
+        ++stats.numRounds;
+        stats.numModulesVisited += allModules.size();
+
+        if (runAllResolutionPasses (program, allModules.size(), throwOnErrors).numChanges == 0)
             return;
+
+        settledModules.clear();
     }
 }
 
 static void runFullResolutionAndChecks (AST::Program& program, uint64_t stackSizeLimit, bool allowTopLevelSlices, bool allowExternalFunctions)
 {
     runResolutionPasses (program, false);
-    passes::DuplicateNameCheckPass::check (program);
+    runStage (program, "checkDuplicateNames", [&] { passes::DuplicateNameCheckPass::check (program); });
     runResolutionPasses (program, true);
 
-    validation::PostLink::check (program, stackSizeLimit, allowTopLevelSlices, allowExternalFunctions);
+    runStage (program, "postLinkValidation", [&] { validation::PostLink::check (program, stackSizeLimit, allowTopLevelSlices, allowExternalFunctions); });
 }
 
 void runBasicResolutionPasses (AST::Program& program)
@@ -96,6 +162,20 @@ void runBasicResolutionPasses (AST::Program& program)
     runResolutionPasses (program, false);
 }
 
+std::vector<bool> findResolvedFunctions (AST::Program& program, const AST::ObjectRefVector<AST::Function>& functions)
+{
+    std::vector<passes::PassResult> functionResults (functions.size());
+    runAllResolutionPasses (program, 0, functions, functionResults, false);
+
+    std::vector<bool> result;
+    result.reserve (functions.size());
+
+    for (auto& r : functionResults)
+        result.push_back (r.numChanges == 0 && r.numFailures == 0);
+
+    return result;
+}
+
 void prepareForResolution (AST::Program& program, uint64_t stackSizeLimit)
 {
     runResolutionPasses (program, false);
@@ -106,6 +186,12 @@ void prepareForResolution (AST::Program& program, uint64_t stackSizeLimit)
     createHoistedEndpointConnections (program);
 }
 
+void createInstanceLanes (AST::Program& program, uint32_t numLanes)
+{
+    createInstanceLaneGraph (program, numLanes);
+    runResolutionPasses (program, false);
+}
+
 void prepareForCodeGen (AST::Program& program,
                         const BuildSettings& buildSettings,
                         bool useForwardBranchesForAdvance,
@@ -118,43 +204,66 @@ void prepareForCodeGen (AST::Program& program,
 {
     CMAJ_ASSERT (buildSettings.getMaxBlockSize() != 0 && buildSettings.getEventBufferSize() != 0);
 
-    cloneGraphNodes (program);
+    program.canSkipPreResolvedFunctions = false;
+    runStage (program, "cloneGraphNodes", [&] { cloneGraphNodes (program); });
+
+    auto replaceProperties = [&]
+    {
+        return runStage (program, "replaceProcessorProperties", [&]
+        {
+            return replaceProcessorProperties (program, buildSettings.getMaxFrequency(), buildSettings.getFrequency(), useDynamicSampleRate);
+        });
+    };
 
-    auto processorReplacementState = replaceProcessorProperties (program, buildSettings.getMaxFrequency(), buildSettings.getFrequency(), useDynamicSampleRate);
+    auto processorReplacementState = replaceProperties();
 
     while (processorReplacementState.propertiesReplaced != 0)
     {
         runFullResolutionAndChecks (program, buildSettings.getMaxStackSize(), allowTopLevelSlices, allowExternalFunctions);
-        processorReplacementState = replaceProcessorProperties (program, buildSettings.getMaxFrequency(), buildSettings.getFrequency(), useDynamicSampleRate);
+        processorReplacementState = replaceProperties();
     }
 
     runFullResolutionAndChecks (program, buildSettings.getMaxStackSize(), allowTopLevelSlices, allowExternalFunctions);
-    simplifyGraphConnections (program);
+    runStage (program, "simplifyGraphConnections", [&] { simplifyGraphConnections (program); });
     runResolutionPasses (program, allowTopLevelSlices);
 
     resultLatency = program.getMainProcessor().getLatency();
 
-    determineFunctionAliasStatus (program);
-    removeUnusedNodes (program);
-    removeGenericAndParameterisedObjects (program);
-    removeUnusedEndpoints (program, isEndpointActive);
+    runStage (program, "determineFunctionAliasStatus",         [&] { determineFunctionAliasStatus (program); });
+    runStage (program, "removeUnusedNodes",                    [&] { removeUnusedNodes (program); });
+    runStage (program, "removeGenericAndParameterisedObjects", [&] { removeGenericAndParameterisedObjects (program); });
+    runStage (program, "removeUnusedEndpoints",                [&] { removeUnusedEndpoints (program, isEndpointActive); });
     runResolutionPasses (program, allowTopLevelSlices);
-    convertComplexTypes (program);
-    addFallbackIntrinsics (program, engineSupportsIntrinsic);
-    canonicaliseLoopsAndBlocks (program);
-    replaceWrapTypesAndLoopCounters (program);
-    replaceMultidimensionalArrays (program);
-    convertUnwrittenVariablesToConst (program);
-    inlineAllCallsWhichAdvance (program);
-    createSystemInitFunctions (program, processorReplacementState.sessionIDVariable, processorReplacementState.frequencyVariable);
-    convertLargeConstantsToGlobals (program);
-    flattenGraph (program, buildSettings.getMaxBlockSize(), buildSettings.getEventBufferSize(), useForwardBranchesForAdvance);
+    runStage (program, "convertComplexTypes",                  [&] { convertComplexTypes (program); });
+    runStage (program, "addFallbackIntrinsics",                [&] { addFallbackIntrinsics (program, engineSupportsIntrinsic); });
+    runStage (program, "canonicaliseLoopsAndBlocks",           [&] { canonicaliseLoopsAndBlocks (program); });
+    runStage (program, "replaceWrapTypesAndLoopCounters",      [&] { replaceWrapTypesAndLoopCounters (program); });
+    runStage (program, "replaceMultidimensionalArrays",        [&] { replaceMultidimensionalArrays (program); });
+    runStage (program, "convertUnwrittenVariablesToConst",     [&] { convertUnwrittenVariablesToConst (program); });
+    runStage (program, "inlineAllCallsWhichAdvance",           [&] { inlineAllCallsWhichAdvance (program); });
+
+    if (buildSettings.shouldUseSparseStreams())
+        runStage (program, "addSparseStreamSupport", [&] { addSparseStreamSupport (program); });
+
+    runStage (program, "createSystemInitFunctions", [&]
+    {
+        createSystemInitFunctions (program, processorReplacementState.sessionIDVariable, processorReplacementState.frequencyVariable);
+    });
+
+    runStage (program, "convertLargeConstantsToGlobals", [&] { convertLargeConstantsToGlobals (program); });
+
+    runStage (program, "flattenGraph", [&]
+    {
+        flattenGraph (program, buildSettings.getMaxBlockSize(), buildSettings.getEventBufferSize(),
+                      useForwardBranchesForAdvance, buildSettings.shouldRenderNodesInBlocks());
+    });
 }
 
 void prepareForGraphGen (AST::Program& program,
                          double frequency,
                          uint64_t stackSizeLimit)
 {
+    program.canSkipPreResolvedFunctions = false;
     cloneGraphNodes (program);
     replaceProcessorProperties (program, frequency, frequency, false);
     runFullResolutionAndChecks (program, stackSizeLimit, true, true);
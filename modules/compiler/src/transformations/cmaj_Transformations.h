@@ -40,6 +40,10 @@ namespace cmaj::transformations
                             double& resultLatency,
                             const std::function<bool(const EndpointID&)>& isEndpointActive);
 
+    /// Wraps the main processor in a graph which runs the given number of copies of it
+    /// in a single advance call, giving each copy its own set of endpoints.
+    void createInstanceLanes (AST::Program&, uint32_t numLanes);
+
     // Run passes for graph generation
     void prepareForGraphGen (AST::Program&,
                              double frequency,
@@ -49,6 +53,10 @@ namespace cmaj::transformations
     /// and stopping when it runs out of things to change.
     void runBasicResolutionPasses (AST::Program&);
 
+    /// Runs a round of resolution passes over each of these functions individually, and returns
+    /// a flag for each one to say whether it was left unchanged and without any failures.
+    std::vector<bool> findResolvedFunctions (AST::Program&, const AST::ObjectRefVector<AST::Function>&);
+
     /// Recursively finds child namespaces with the same name and merges them
     void mergeDuplicateNamespaces (AST::Namespace& parentNamespace);
 
@@ -16,6 +16,8 @@
 //  EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
 //  DISCLAIMED.
 
+#include "cmaj_HalfBandFIR.h"
+
 namespace cmaj
 {
 
@@ -113,7 +115,22 @@ struct GraphConnectivityModel
 
             visited.pop_back();
 
-            return longest + node.getProcessorType()->getLatency() / node.getClockMultiplier();
+            return longest + node.getProcessorType()->getLatency() / node.getClockMultiplier() + getResamplingLatency();
+        }
+
+        double getResamplingLatency() const
+        {
+            return HalfBandFIR::getResamplingLatency (node.getClockMultiplier(),
+                                                      getFIRDesign (inputInterpolationMode),
+                                                      getFIRDesign (outputInterpolationMode));
+        }
+
+        static const HalfBandFIR* getFIRDesign (AST::InterpolationTypeEnum::Enum mode)
+        {
+            if (mode == AST::InterpolationTypeEnum::Enum::fir)      return std::addressof (HalfBandFIR::getHighQuality());
+            if (mode == AST::InterpolationTypeEnum::Enum::fastFir)  return std::addressof (HalfBandFIR::getLowLatency());
+
+            return {};
         }
 
         void setIndirectConnectionFlag()
@@ -309,7 +326,9 @@ private:
         {
             return mode == AST::InterpolationTypeEnum::Enum::latch
                 || mode == AST::InterpolationTypeEnum::Enum::linear
-                || mode == AST::InterpolationTypeEnum::Enum::sinc;
+                || mode == AST::InterpolationTypeEnum::Enum::sinc
+                || mode == AST::InterpolationTypeEnum::Enum::fir
+                || mode == AST::InterpolationTypeEnum::Enum::fastFir;
         };
 
         if (isSpecificInterpolationMode (currentMode) || isSpecificInterpolationMode (newMode))
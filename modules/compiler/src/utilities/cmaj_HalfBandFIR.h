@@ -0,0 +1,109 @@
+//
+//     ,ad888ba,                              88
+//    d8"'    "8b
+//   d8            88,dba,,adba,   ,aPP8A.A8  88     The Cmajor Toolkit
+//   Y8,           88    88    88  88     88  88
+//    Y8a.   .a8P  88    88    88  88,   ,88  88     (C)2024 Cmajor Software Ltd
+//     '"Y888Y"'   88    88    88  '"8bbP"Y8  88     https://cmajor.dev
+//                                           ,88
+//                                        888P"
+//
+//  The Cmajor project is subject to commercial or open-source licensing.
+//  You may use it under the terms of the GPLv3 (see www.gnu.org/licenses), or
+//  visit https://cmajor.dev to learn about our commercial licence options.
+//
+//  CMAJOR IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+//  EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+//  DISCLAIMED.
+
+#pragma once
+
+namespace cmaj
+{
+
+//==============================================================================
+/**
+    A linear-phase half-band filter design, used by the `fir` and `fastFir`
+    interpolation modes, which resample a node's streams by cascading 2x stages
+    of it.
+
+    Each design is a Kaiser-windowed sinc. Every other tap of a half-band filter is
+    zero apart from the centre one, so each stage is split into two polyphase
+    branches: one is just a delay, and the other needs one multiply for each
+    symmetric pair of taps.
+
+    Unlike the IIR `sinc` mode, the delay is the same at all frequencies, so it can
+    be reported as the latency of the graph.
+*/
+struct HalfBandFIR
+{
+    /// The number of non-zero taps either side of the centre one.
+    int numTapPairs;
+
+    /// The coefficients of the non-zero taps either side of the centre, starting
+    /// with the closest pair. The centre tap is 0.5, and these add up to 0.25 so
+    /// that both branches have unity gain at DC.
+    const float* coefficients;
+
+    /// The design used by `fir`: 63 taps (beta = 9), giving about 89dB of rejection
+    /// above 0.3 of the higher sample rate, with less than 0.001dB of ripple below 0.2.
+    static const HalfBandFIR& getHighQuality()
+    {
+        static constexpr float coefficients[] =
+        {
+             0.31690625715f,    -0.10196128264f,     0.056971201048f,   -0.036531100699f,
+             0.024554192684f,   -0.016680192752f,    0.011228361768f,   -0.0073904566768f,
+             0.0047039338592f,  -0.0028635116409f,   0.0016458432235f,  -0.00087786914577f,
+             0.00042322781318f, -0.00017597176213f,  0.000056757056774f, -0.0000093892910208f
+        };
+
+        static constexpr HalfBandFIR design { 16, coefficients };
+        return design;
+    }
+
+    /// The design used by `fastFir`: 31 taps (beta = 4.6), giving about 50dB of
+    /// rejection above 0.3 of the higher sample rate, with less than 0.025dB of
+    /// ripple below 0.2. It needs half the multiplies of the `fir` design, and has
+    /// half its delay.
+    static const HalfBandFIR& getLowLatency()
+    {
+        static constexpr float coefficients[] =
+        {
+             0.31562247884f,    -0.097808410559f,    0.050542111025f,   -0.028573850091f,
+             0.015923565475f,   -0.0082109342414f,   0.0036171187244f,  -0.0011120791686f
+        };
+
+        static constexpr HalfBandFIR design { 8, coefficients };
+        return design;
+    }
+
+    /// The delay that a cascade of upsampling stages adds, in frames of the lower rate.
+    double getUpsamplingLatency (double factor) const
+    {
+        return 2.0 * numTapPairs * (1.0 - 1.0 / factor);
+    }
+
+    /// The delay that a cascade of downsampling stages adds, in frames of the lower rate.
+    double getDownsamplingLatency (double factor) const
+    {
+        return 2.0 * (numTapPairs - 1) * (1.0 - 1.0 / factor);
+    }
+
+    /// Returns the latency, in frames of the parent graph, added by resampling a node
+    /// that runs at the given multiple of the parent's rate. A null design means that
+    /// the streams in that direction don't use an FIR filter, so add no delay.
+    static double getResamplingLatency (double clockMultiplier, const HalfBandFIR* inputFilter, const HalfBandFIR* outputFilter)
+    {
+        if (clockMultiplier > 1.0)
+            return (inputFilter  != nullptr ? inputFilter->getUpsamplingLatency (clockMultiplier) : 0.0)
+                 + (outputFilter != nullptr ? outputFilter->getDownsamplingLatency (clockMultiplier) : 0.0);
+
+        if (clockMultiplier < 1.0)
+            return ((inputFilter  != nullptr ? inputFilter->getDownsamplingLatency (1.0 / clockMultiplier) : 0.0)
+                  + (outputFilter != nullptr ? outputFilter->getUpsamplingLatency (1.0 / clockMultiplier) : 0.0)) / clockMultiplier;
+
+        return 0;
+    }
+};
+
+} // namespace cmaj
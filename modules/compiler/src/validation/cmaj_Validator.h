@@ -586,6 +586,21 @@ namespace cmaj::validation
                     throwError (f, Errors::functionHasParams (f.getName()));
             }
 
+            if (f.isIdleFunction())
+            {
+                if (! f.getParentModule().isProcessor())
+                    throwError (f, Errors::idleCheckMustBeInsideProcessor());
+
+                if (AST::castToRef<AST::ProcessorBase> (f.getParentModule()).findIsIdleFunction().get() != std::addressof (f))
+                    throwError (f, Errors::tooManyIdleCheckFunctions());
+
+                if (! getAsTypeOrThrowError (f.returnType).isPrimitiveBool())
+                    throwError (f, Errors::functionMustReturnBool (f.getName()));
+
+                if (! f.parameters.empty())
+                    throwError (f, Errors::functionHasParams (f.getName()));
+            }
+
             DuplicateNameChecker nameChecker;
 
             for (auto& param : f.iterateParameters())
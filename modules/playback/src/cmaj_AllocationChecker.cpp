@@ -148,6 +148,13 @@ struct PerformerAllocationCheckWrapper  : public choc::com::ObjectWithAtomicRefC
         ScopedAllocationTracker allocationTracker;
         target->advance();
     }
+
+    void processBlock (const BlockDescriptor& block) override
+    {
+        // Going via our own methods means that the output event callbacks get
+        // the same treatment as they do in iterateOutputEvents()
+        processBlockUsingIndividualCalls (*this, block);
+    }
 };
 
 cmaj::PerformerPtr createAllocationCheckingPerformerWrapper (cmaj::PerformerPtr source)
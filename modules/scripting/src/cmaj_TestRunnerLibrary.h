@@ -631,6 +631,15 @@ R"(
     e.g.
     ## performanceTest ({ frequency:44100, minBlockSize:4, maxBlockSize: 1024, samplesToRender:100000 })
     ## performanceTest ({ frequency:44100, minBlockSize:4, maxBlockSize: 1024, samplesToRender:100000, patch: "testPatch.cmajorpatch" })
+
+    If the includeEndpointIO option is set, then each block also pushes data into all the
+    input streams and values, and copies out all the output streams and values, so that the
+    cost of the endpoint calls is included in the measurement. Adding the useProcessBlock
+    option makes it do all of this with a single processBlock() call per block.
+
+    The generatedFunctions option appends a namespace called "generated" containing that
+    many functions (see createGeneratedFunctions()), for measuring how the load time scales
+    with the size of a program.
 */
 
 function performanceTest (options)
@@ -668,7 +677,8 @@ function performanceTest (options)
     for (let i = 0; i < outputEndpoints.length; i++)
         outputEndpoints[i].handle = engine.getEndpointHandle (outputEndpoints[i].endpointID);
 
-    timingInfo.linkTime = engine.link ();
+    timingInfo.linkTime = engine.link ();)"
+R"(
 
     if (isError (timingInfo.linkTime, options))
     {
@@ -686,8 +696,7 @@ function performanceTest (options)
     {
         totalTime += timingInfo.parseTime;
         testSection.logMessage ("Parse time: " + Math.round (timingInfo.parseTime * 1000) + " ms");
-    })"
-R"(
+    }
 
     testSection.logMessage ("Load time : " + Math.round (timingInfo.loadTime * 1000) + " ms");
     testSection.logMessage ("Link time : " + Math.round (timingInfo.linkTime * 1000) + " ms");
@@ -711,7 +720,7 @@ R"(
                                           inputFrames.slice (0, blockSize));
         }
 
-        let runtime = performer.calculateRenderPerformance (blockSize, options.samplesToRender);
+        let runtime = performer.calculateRenderPerformance (blockSize, options.samplesToRender, options.includeEndpointIO, options.useProcessBlock);
         let framesPerSec = options.samplesToRender / runtime;
         let utilisation = 100.0 * options.frequency / framesPerSec;
 
@@ -721,7 +730,8 @@ R"(
     }
 
     testSection.reportSuccess();
-}
+})"
+R"TEXT(
 
 //==============================================================================
 /*
@@ -738,8 +748,7 @@ function testPatch (file, expectedError)
     const absolutePath = testSection.getAbsolutePath (file);
     const error = loadAndTestPatch (absolutePath, 44100, 128);
 
-    let newErrorLine = getErrorReportString (error);)"
-R"TEXT(
+    let newErrorLine = getErrorReportString (error);
 
     if (expectedError == null)
     {
@@ -783,7 +792,8 @@ R"TEXT(
 /*
     This test loads helper files containing input and output data that should
     be fed into a processor. It can also run tests on a patch by specifying a patch
-    to build
+    to build)TEXT"
+R"(
 
     e.g.
     ## runScript ({ sampleRate:44100, blockSize:32, samplesToRender:1000, subDir:"foo" })
@@ -809,8 +819,7 @@ function runScript (options)
     {
         testSection.reportFail (engine);
         return;
-    })TEXT"
-R"(
+    }
 
     let inputEndpoints = engine.getInputEndpoints();
     let outputEndpoints = engine.getOutputEndpoints();
@@ -840,7 +849,8 @@ R"(
         else if (inputEndpoints[i].endpointType == "value")
         {
             let expectedStreamFilename = options.subDir + "/" + inputEndpoints[i].endpointID + ".json";
-            let inputData = testSection.readEventData (expectedStreamFilename);
+            let inputData = testSection.readEventData (expectedStreamFilename);)"
+R"(
 
             if (isError (inputData))
             {
@@ -860,8 +870,7 @@ R"(
         else if (inputEndpoints[i].endpointType == "event")
         {
             let expectedStreamFilename = options.subDir + "/" + inputEndpoints[i].endpointID + ".json";
-            let inputData = testSection.readEventData (expectedStreamFilename);)"
-R"(
+            let inputData = testSection.readEventData (expectedStreamFilename);
 
             if (isError (inputData))
             {
@@ -891,7 +900,8 @@ R"(
 
     for (let i = 0; i < outputEndpoints.length; i++)
     {
-        outputEndpoints[i].handle = engine.getEndpointHandle (outputEndpoints[i].endpointID);
+        outputEndpoints[i].handle = engine.getEndpointHandle (outputEndpoints[i].endpointID);)"
+R"(
 
         if (outputEndpoints[i].endpointType == "stream")
             outputEndpoints[i].frames = { "sampleRate": options.frequency, "frameCount": 0, "data": []};
@@ -919,8 +929,7 @@ R"(
     let framesRendered = 0;
 
     let eventsToApply = [];
-    let valuesToApply = [];)"
-R"(
+    let valuesToApply = [];
 
     for (let i = 0; i < inputEndpoints.length; i++)
     {
@@ -946,7 +955,8 @@ R"(
         {
             if (inputEndpoints[i].endpointType == "event")
             {
-                let arrayLength = inputEndpoints[i].events.length;
+                let arrayLength = inputEndpoints[i].events.length;)"
+R"(
 
                 while (inputEndpoints[i].nextEvent < arrayLength && inputEndpoints[i].events[inputEndpoints[i].nextEvent].frameOffset == framesRendered)
                 {
@@ -966,8 +976,7 @@ R"(
             }
             else if (inputEndpoints[i].endpointType == "value")
             {
-                let arrayLength = inputEndpoints[i].values.length;)"
-R"(
+                let arrayLength = inputEndpoints[i].values.length;
 
                 while (inputEndpoints[i].nextValue < arrayLength && inputEndpoints[i].values[inputEndpoints[i].nextValue].frameOffset == framesRendered)
                 {
@@ -988,7 +997,8 @@ R"(
             }
         }
 
-        performer.setBlockSize (samplesThisBlock);
+        performer.setBlockSize (samplesThisBlock);)"
+R"(
 
         for (let i = 0; i < eventsToApply.length; i++)
             performer.addInputEvent (eventsToApply[i].handle, eventsToApply[i].event);
@@ -1009,8 +1019,7 @@ R"(
             }
         }
 
-        performer.advance();)"
-R"(
+        performer.advance();
 
         for (let i = 0; i < outputEndpoints.length; i++)
         {
@@ -1037,7 +1046,8 @@ R"(
                     outputEndpoints[i].events.push (outEvents[n]);
                 }
             }
-        }
+        })"
+R"(
 
         outstandingSamples -= samplesThisBlock;
         framesRendered += samplesThisBlock;
@@ -1063,8 +1073,7 @@ R"(
 
             // testSection.logMessage ("Got output data:" + JSON.stringify (outputEndpoints[i].frames));
 
-            let expectedData = testSection.readStreamData (expectedStreamFilename);)"
-R"(
+            let expectedData = testSection.readStreamData (expectedStreamFilename);
 
             if (isError (expectedData))
             {
@@ -1087,7 +1096,8 @@ R"(
         else if (outputEndpoints[i].endpointType == "value")
         {
             let expectedEventFilename = options.subDir + "/expectedOutput-" + outputEndpoints[i].endpointID + ".json";
-            let expectedData = testSection.readEventData (expectedEventFilename);
+            let expectedData = testSection.readEventData (expectedEventFilename);)"
+R"(
 
             if (isError (expectedData))
             {
@@ -1108,8 +1118,7 @@ R"(
         else if (outputEndpoints[i].endpointType == "event")
         {
             let expectedEventFilename = options.subDir + "/expectedOutput-" + outputEndpoints[i].endpointID + ".json";
-            let expectedData = testSection.readEventData (expectedEventFilename);)"
-R"(
+            let expectedData = testSection.readEventData (expectedEventFilename);
 
             if (isError (expectedData))
             {
@@ -1138,7 +1147,8 @@ R"(
         {
             totalTime += timingInfo.parseTime;
             testSection.logMessage ("Parse time: " + Math.round (timingInfo.parseTime * 1000) + " ms");
-        }
+        })"
+R"(
 
         testSection.logMessage ("Load time : " + Math.round (timingInfo.loadTime * 1000) + " ms");
         testSection.logMessage ("Link time : " + Math.round (timingInfo.linkTime * 1000) + " ms");
@@ -1169,8 +1179,7 @@ function buildEngineWithLoadedProgram (testSection, options, timingInfo, engine)
 
     if (options.patch != null)
     {
-        let patch = new PatchManifest (new File (testSection.getAbsolutePath (options.patch)));)"
-R"(
+        let patch = new PatchManifest (new File (testSection.getAbsolutePath (options.patch)));
 
         if (isError (patch.error))
             return patch.error;
@@ -1188,7 +1197,12 @@ R"(
     else
     {
         program = new Program();
-        let parseResult = program.parse (testSection.source + testSection.globalSource);
+        let source = testSection.source + testSection.globalSource;
+
+        if (options.generatedFunctions !== undefined)
+            source += createGeneratedFunctions (options.generatedFunctions);
+
+        let parseResult = program.parse (source);
 
         if (isError (parseResult, options))
             return parseResult;
@@ -1198,7 +1212,8 @@ R"(
         let externalFilename = options.subDir + "/externals.json";
         let externalData = testSection.readEventData (externalFilename);
 
-        timingInfo.loadTime = engine.load (program, externalData);
+        timingInfo.loadTime = engine.load (program, externalData);)"
+R"(
 
         if (isError (timingInfo.loadTime, options))
             return timingInfo.loadTime;
@@ -1207,6 +1222,18 @@ R"(
     return engine;
 }
 
+// Creates a namespace of functions called generated::f0, generated::f1, etc, where each one
+// calls the one at half its index, so that resolving them involves plenty of name lookups
+// in a large scope, without making the call graph too deep.
+function createGeneratedFunctions (numFunctions)
+{
+    let code = "\nnamespace generated\n{\n    int f0 (int x)  { return x; }\n";
+
+    for (let i = 1; i < numFunctions; i++)
+        code += "    int f" + i + " (int x)  { return f" + Math.floor (i / 2) + " (x) + " + i + "; }\n";
+
+    return code + "}\n";
+}
 
 function createEngine (options)
 {
@@ -1240,6 +1267,9 @@ R"(
         if (options.sessionID !== undefined)          buildSettings.sessionID = options.sessionID;
         if (options.optimisationLevel !== undefined)  buildSettings.optimisationLevel = options.optimisationLevel;
         if (options.mainProcessor !== undefined)      buildSettings.mainProcessor = options.mainProcessor;
+        if (options.instanceLanes !== undefined)      buildSettings.instanceLanes = options.instanceLanes;
+        if (options.sparseStreams !== undefined)      buildSettings.sparseStreams = options.sparseStreams;
+        if (options.renderNodesInBlocks !== undefined) buildSettings.renderNodesInBlocks = options.renderNodesInBlocks;
     }
 
     engine.setBuildSettings (buildSettings);
@@ -1269,14 +1299,14 @@ function getErrorReportString (error)
 function findTestFunctions (program)
 {
     let result = [];
-    let syntaxTree = program.getSyntaxTree ("tests");
+    let syntaxTree = program.getSyntaxTree ("tests");)"
+R"(
 
     if (syntaxTree && syntaxTree.name == "tests")
     {
         for (let i = 0; i < syntaxTree.functions.length; ++i)
         {
-            const func = syntaxTree.functions[i];)"
-R"(
+            const func = syntaxTree.functions[i];
 
             if (func.returnType.OBJECT == "PrimitiveType"
                  && func.returnType.type == "boolean"
@@ -1328,12 +1358,12 @@ function streamDataComparison (data, expectedData, maxDiffDb)
             dataFrame = [ dataFrame ];
 
         if (expectedFrame.length != dataFrame.length)
-            return "Channel count mimatch at frame " + i + ", expected " + expectedFrame.length + ", got " + dataFrame.length;
+            return "Channel count mimatch at frame " + i + ", expected " + expectedFrame.length + ", got " + dataFrame.length;)"
+R"(
 
         for (let channel = 0; channel < expectedFrame.length; channel++)
             streamDataCompareValue (comparisonStats, expectedFrame[channel], dataFrame[channel], i, channel);
-    })"
-R"(
+    }
 
     let diffDb = 20.0 * Math.log10 (comparisonStats.maxDiff / comparisonStats.maxValue);
 
@@ -1373,7 +1403,8 @@ function eventDataComparison (data, expectedData)
     }
 
     return null;
-}
+})"
+R"(
 
 // helper function to valid input data for event or value inputs
 function validateInputData (inputName, inputData, testSection, type)
@@ -1384,8 +1415,7 @@ function validateInputData (inputName, inputData, testSection, type)
         {
             testSection.reportFail (inputName + ": Failed validation, missing frameOffset attribute for item " + i);
             return false;
-        })"
-R"(
+        }
 
         if (type == "value")
         {
@@ -150,6 +150,28 @@ private:
         EndpointTypeCoercionHelperList endpointTypeCoercionHelpers;
         uint32_t currentNumFrames = 0;
 
+        // These are used by calculateRenderPerformance() to measure the cost of
+        // pushing data through the performer's endpoints as well as rendering,
+        // either with individual calls or a single processBlock() call
+        struct StreamOrValueEndpoint
+        {
+            EndpointHandle handle;
+            bool isInput, isStream;
+        };
+
+        std::vector<StreamOrValueEndpoint> streamAndValueEndpoints;
+        std::vector<uint8_t> endpointIOScratchSpace;
+        size_t maxEndpointFrameSize = 0;
+
+        void addStreamOrValueEndpoint (const EndpointDetails& details, EndpointHandle handle)
+        {
+            if (details.isEvent() || details.dataTypes.empty())
+                return;
+
+            streamAndValueEndpoints.push_back ({ handle, details.isInput, details.isStream() });
+            maxEndpointFrameSize = std::max (maxEndpointFrameSize, details.dataTypes.front().getValueDataSize());
+        }
+
         choc::value::Value setBlockSize (uint32_t frames)
         {
             performer.setBlockSize (frames);
@@ -324,13 +346,68 @@ private:
         {
             auto blockSize  = args.get<uint32_t> (1);
             auto frames     = args.get<uint32_t> (2);
+            auto includeEndpointIO = args.get<bool> (3, false);
+            auto useProcessBlock = args.get<bool> (4, false);
             auto blockCount = frames / blockSize;
 
+            if (includeEndpointIO)
+                endpointIOScratchSpace.resize (std::max (endpointIOScratchSpace.size(), blockSize * maxEndpointFrameSize));
+
+            cmaj::Performer::BlockIO blockIO;
+
+            if (includeEndpointIO && useProcessBlock)
+            {
+                auto scratch = endpointIOScratchSpace.data();
+
+                for (auto& e : streamAndValueEndpoints)
+                {
+                    if (e.isInput && e.isStream)
+                        blockIO.inputStreams.push_back ({ e.handle, scratch });
+                    else if (e.isInput)
+                        blockIO.inputValues.push_back ({ e.handle, scratch, 0 });
+                    else if (e.isStream)
+                        blockIO.outputStreams.push_back ({ e.handle, scratch });
+                    else
+                        blockIO.outputValues.push_back ({ e.handle, scratch });
+                }
+            }
+
             auto startTime = std::chrono::steady_clock::now();
             performer.setBlockSize (blockSize);
 
             for (uint32_t i = 0; i < blockCount; ++i)
-                performer.advance();
+            {
+                if (includeEndpointIO && useProcessBlock)
+                {
+                    performer.processBlock (blockIO, blockSize);
+                }
+                else if (includeEndpointIO)
+                {
+                    auto scratch = endpointIOScratchSpace.data();
+
+                    for (auto& e : streamAndValueEndpoints)
+                    {
+                        if (e.isInput && e.isStream)
+                            performer.setInputFrames (e.handle, scratch, blockSize);
+                        else if (e.isInput)
+                            performer.setInputValue (e.handle, static_cast<const void*> (scratch), 0);
+                    }
+
+                    performer.advance();
+
+                    for (auto& e : streamAndValueEndpoints)
+                    {
+                        if (! e.isInput && e.isStream)
+                            performer.copyOutputFrames (e.handle, scratch, blockSize);
+                        else if (! e.isInput)
+                            performer.copyOutputValue (e.handle, scratch);
+                    }
+                }
+                else
+                {
+                    performer.advance();
+                }
+            }
 
             auto endTime = std::chrono::steady_clock::now();
             std::chrono::duration<double> elapsed = endTime - startTime;
@@ -503,6 +580,11 @@ private:
                 for (auto& i : endpointHandles)
                     perf->endpointTypeCoercionHelpers.addMapping (i.first, i.second);
 
+                for (auto& list : { engine.getInputEndpoints(), engine.getOutputEndpoints() })
+                    for (auto& e : list)
+                        if (auto handle = endpointHandles.find (e.endpointID.toString()); handle != endpointHandles.end())
+                            perf->addStreamOrValueEndpoint (e, handle->second);
+
                 return owner.performers.createNewObject (std::move (perf));
             }
 
@@ -1003,7 +1085,7 @@ class Performer
     setInputValue (h, d, f)             { return _performerSetInputValue (this.id, h, d, f); }
     addInputEvent (h, d)                { return _performerAddInputEvent (this.id, h, d); }
     getXRuns()                          { return _performerGetXRuns (this.id); }
-    calculateRenderPerformance (bs, f)  { return _performerCalculateRenderPerformance (this.id, bs, f); }
+    calculateRenderPerformance (bs, f, io, pb)  { return _performerCalculateRenderPerformance (this.id, bs, f, io == true, pb == true); }
 }
 
 class Program
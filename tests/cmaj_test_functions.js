@@ -618,6 +618,15 @@ function testConsole (expectedConsoleMsg, options)
     e.g.
     ## performanceTest ({ frequency:44100, minBlockSize:4, maxBlockSize: 1024, samplesToRender:100000 })
     ## performanceTest ({ frequency:44100, minBlockSize:4, maxBlockSize: 1024, samplesToRender:100000, patch: "testPatch.cmajorpatch" })
+
+    If the includeEndpointIO option is set, then each block also pushes data into all the
+    input streams and values, and copies out all the output streams and values, so that the
+    cost of the endpoint calls is included in the measurement. Adding the useProcessBlock
+    option makes it do all of this with a single processBlock() call per block.
+
+    The generatedFunctions option appends a namespace called "generated" containing that
+    many functions (see createGeneratedFunctions()), for measuring how the load time scales
+    with the size of a program.
 */
 
 function performanceTest (options)
@@ -697,7 +706,7 @@ function performanceTest (options)
                                           inputFrames.slice (0, blockSize));
         }
 
-        let runtime = performer.calculateRenderPerformance (blockSize, options.samplesToRender);
+        let runtime = performer.calculateRenderPerformance (blockSize, options.samplesToRender, options.includeEndpointIO, options.useProcessBlock);
         let framesPerSec = options.samplesToRender / runtime;
         let utilisation = 100.0 * options.frequency / framesPerSec;
 
@@ -1165,7 +1174,12 @@ function buildEngineWithLoadedProgram (testSection, options, timingInfo, engine)
     else
     {
         program = new Program();
-        let parseResult = program.parse (testSection.source + testSection.globalSource);
+        let source = testSection.source + testSection.globalSource;
+
+        if (options.generatedFunctions !== undefined)
+            source += createGeneratedFunctions (options.generatedFunctions);
+
+        let parseResult = program.parse (source);
 
         if (isError (parseResult, options))
             return parseResult;
@@ -1184,6 +1198,18 @@ function buildEngineWithLoadedProgram (testSection, options, timingInfo, engine)
     return engine;
 }
 
+// Creates a namespace of functions called generated::f0, generated::f1, etc, where each one
+// calls the one at half its index, so that resolving them involves plenty of name lookups
+// in a large scope, without making the call graph too deep.
+function createGeneratedFunctions (numFunctions)
+{
+    let code = "\nnamespace generated\n{\n    int f0 (int x)  { return x; }\n";
+
+    for (let i = 1; i < numFunctions; i++)
+        code += "    int f" + i + " (int x)  { return f" + Math.floor (i / 2) + " (x) + " + i + "; }\n";
+
+    return code + "}\n";
+}
 
 function createEngine (options)
 {
@@ -1216,6 +1242,9 @@ function updateBuildSettings (engine, defaultFrequency, defaultBlockSize, ignore
         if (options.sessionID !== undefined)          buildSettings.sessionID = options.sessionID;
         if (options.optimisationLevel !== undefined)  buildSettings.optimisationLevel = options.optimisationLevel;
         if (options.mainProcessor !== undefined)      buildSettings.mainProcessor = options.mainProcessor;
+        if (options.instanceLanes !== undefined)      buildSettings.instanceLanes = options.instanceLanes;
+        if (options.sparseStreams !== undefined)      buildSettings.sparseStreams = options.sparseStreams;
+        if (options.renderNodesInBlocks !== undefined) buildSettings.renderNodesInBlocks = options.renderNodesInBlocks;
     }
 
     engine.setBuildSettings (buildSettings);
@@ -0,0 +1,265 @@
+//
+//     ,ad888ba,                              88
+//    d8"'    "8b
+//   d8            88,dba,,adba,   ,aPP8A.A8  88     The Cmajor Toolkit
+//   Y8,           88    88    88  88     88  88
+//    Y8a.   .a8P  88    88    88  88,   ,88  88     (C)2024 Cmajor Software Ltd
+//     '"Y888Y"'   88    88    88  '"8bbP"Y8  88     https://cmajor.dev
+//                                           ,88
+//                                        888P"
+//
+//  The Cmajor project is subject to commercial or open-source licensing.
+//  You may use it under the terms of the GPLv3 (see www.gnu.org/licenses), or
+//  visit https://cmajor.dev to learn about our commercial licence options.
+//
+//  CMAJOR IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+//  EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+//  DISCLAIMED.
+
+#include "juce/cmaj_JUCEHeaders.h"
+
+#include <random>
+#include "choc/text/choc_TextTable.h"
+#include "cmajor/helpers/cmaj_FileBasedCacheDatabase.h"
+
+//==============================================================================
+/// The FileBasedCacheDatabase as it was before it was sharded, which is kept here
+/// so that the two can be compared. Every store and reload takes the same lock,
+/// each reload touches the file to update its modification time, and every store
+/// triggers a scan of the folder to find the oldest files.
+struct SingleLockCacheDatabase   : public choc::com::ObjectWithAtomicRefCount<cmaj::CacheDatabaseInterface, SingleLockCacheDatabase>
+{
+    SingleLockCacheDatabase (std::filesystem::path parentFolder, size_t maxNumFilesAllowed)
+       : folder (std::move (parentFolder)), maxNumFiles (maxNumFilesAllowed)
+    {
+        purgeThread.start (0, [this] { removeOldFiles(); });
+    }
+
+    virtual ~SingleLockCacheDatabase() = default;
+
+    void store (const char* key, const void* dataToSave, uint64_t dataSize) override
+    {
+        try
+        {
+            std::lock_guard<decltype(lock)> l (lock);
+            choc::file::replaceFileWithContent (getCacheFile (key).string(),
+                                                std::string_view (static_cast<const char*> (dataToSave),
+                                                                  static_cast<std::string_view::size_type> (dataSize)));
+        }
+        catch (...) {}
+
+        purgeThread.trigger();
+    }
+
+    uint64_t reload (const char* key, void* destAddress, uint64_t destSize) override
+    {
+        std::lock_guard<decltype(lock)> l (lock);
+
+        try
+        {
+            auto file = getCacheFile (key);
+            auto size = file_size (file);
+
+            if (size == 0)
+                return 0;
+
+            if (destAddress == nullptr || destSize < size)
+                return size;
+
+            std::fstream stream (file);
+            stream.read (static_cast<char*> (destAddress), static_cast<std::streamsize> (size));
+
+            if (stream.gcount() != static_cast<std::streamsize> (size))
+                return 0;
+
+            stream.put (0);
+            stream.sync();
+            resize_file (file, size);
+
+            return size;
+        }
+        catch (...) {}
+
+        return 0;
+    }
+
+private:
+    std::filesystem::path folder;
+    size_t maxNumFiles = 0;
+    std::mutex lock;
+    choc::threading::TaskThread purgeThread;
+
+    std::filesystem::path getCacheFile (const std::string& key)    { return folder / ("cmajor_cache_" + key); }
+
+    void removeOldFiles()
+    {
+        std::lock_guard<decltype(lock)> l (lock);
+
+        struct File
+        {
+            std::filesystem::path file;
+            std::filesystem::file_time_type time;
+
+            bool operator< (const File& other) const     { return time < other.time; }
+        };
+
+        std::vector<File> files;
+
+        for (auto& f : std::filesystem::directory_iterator { folder })
+        {
+            try
+            {
+                files.push_back ({ f.path(), last_write_time (f.path()) });
+            }
+            catch (...) {}
+        }
+
+        std::sort (files.begin(), files.end());
+
+        if (files.size() > maxNumFiles)
+        {
+            for (size_t i = 0; i < files.size() - maxNumFiles; ++i)
+            {
+                try
+                {
+                    remove (files[i].file);
+                }
+                catch (...) {}
+            }
+        }
+    }
+};
+
+//==============================================================================
+struct CacheWorkload
+{
+    int numLinkers = 16, numItems = 8, iterations = 5;
+    size_t itemSize = 256 * 1024;
+
+    std::string getKey (int linker, int item) const
+    {
+        return "item_" + std::to_string (linker) + "_" + std::to_string (item);
+    }
+
+    /// Each thread behaves like an engine being linked: it asks for the size of each of its
+    /// items, stores the ones that are missing, and then reloads every item that all the
+    /// threads have stored. Returns the time taken, and the number of failed reloads.
+    std::pair<double, int> run (cmaj::CacheDatabaseInterface& cache) const
+    {
+        std::vector<std::thread> linkers;
+        std::atomic<int> numFailures { 0 };
+        std::vector<uint8_t> data (itemSize, 42);
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (int linker = 0; linker < numLinkers; ++linker)
+        {
+            linkers.emplace_back ([&, linker]
+            {
+                for (int item = 0; item < numItems; ++item)
+                {
+                    auto key = getKey (linker, item);
+
+                    if (cache.reload (key.c_str(), nullptr, 0) == 0)
+                        cache.store (key.c_str(), data.data(), data.size());
+                }
+
+                std::vector<uint8_t> loaded (itemSize);
+
+                for (int other = 0; other < numLinkers; ++other)
+                {
+                    for (int item = 0; item < numItems; ++item)
+                    {
+                        auto key = getKey (other, item);
+
+                        if (auto size = cache.reload (key.c_str(), nullptr, 0))
+                            if (cache.reload (key.c_str(), loaded.data(), loaded.size()) != size)
+                                ++numFailures;
+                    }
+                }
+            });
+        }
+
+        for (auto& t : linkers)
+            t.join();
+
+        return { std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count(), numFailures.load() };
+    }
+
+    /// Runs the workload several times, each on a new, empty folder, and returns the fastest time.
+    template <typename CreateCache>
+    double measure (const std::string& name, CreateCache&& createCache) const
+    {
+        double fastest = 0;
+
+        for (int i = 0; i < iterations; ++i)
+        {
+            auto folder = std::filesystem::temp_directory_path() / ("cmajor_cache_benchmark_" + std::to_string (std::random_device()()));
+            std::filesystem::create_directories (folder);
+
+            std::pair<double, int> result;
+
+            {
+                auto cache = createCache (folder);
+                result = run (*cache.get());
+            }
+
+            std::filesystem::remove_all (folder);
+
+            if (result.second != 0)
+                throw std::runtime_error (name + ": " + std::to_string (result.second) + " reloads failed");
+
+            if (i == 0 || result.first < fastest)
+                fastest = result.first;
+        }
+
+        return fastest;
+    }
+};
+
+//==============================================================================
+void benchmarkCache (juce::ArgumentList& args)
+{
+    CacheWorkload workload;
+
+    if (args.containsOption ("--threads"))
+        workload.numLinkers = std::max (1, args.removeValueForOption ("--threads").getIntValue());
+
+    if (args.containsOption ("--items"))
+        workload.numItems = std::max (1, args.removeValueForOption ("--items").getIntValue());
+
+    if (args.containsOption ("--itemSize"))
+        workload.itemSize = static_cast<size_t> (std::max (1, args.removeValueForOption ("--itemSize").getIntValue()));
+
+    if (args.containsOption ("--iterations"))
+        workload.iterations = std::max (1, args.removeValueForOption ("--iterations").getIntValue());
+
+    auto numItems = static_cast<size_t> (workload.numLinkers * workload.numItems);
+
+    // Both caches are given enough room for every item, so that neither has to evict anything
+    auto singleLockTime = workload.measure ("Single lock", [&] (const std::filesystem::path& folder)
+    {
+        return choc::com::create<SingleLockCacheDatabase> (folder, numItems);
+    });
+
+    auto shardedTime = workload.measure ("Sharded", [&] (const std::filesystem::path& folder)
+    {
+        cmaj::FileBasedCacheDatabase::Limits limits;
+        limits.maxTotalSizeInBytes = numItems * workload.itemSize;
+        return choc::com::create<cmaj::FileBasedCacheDatabase> (folder, limits);
+    });
+
+    auto numReloads = static_cast<double> (workload.numLinkers) * static_cast<double> (numItems);
+    auto toMs = [] (double seconds)  { return choc::text::floatToString (seconds * 1000.0, 3) + " ms"; };
+    auto toRate = [&] (double seconds)  { return std::to_string (static_cast<uint64_t> (numReloads / seconds)) + " reloads/s"; };
+
+    choc::text::TextTable table;
+    table << "Linker threads" << std::to_string (workload.numLinkers) << ""; table.newRow();
+    table << "Items per thread" << std::to_string (workload.numItems) << ""; table.newRow();
+    table << "Item size" << std::to_string (workload.itemSize) + " bytes" << ""; table.newRow();
+    table << "Single lock (fastest of " + std::to_string (workload.iterations) + ")" << toMs (singleLockTime) << toRate (singleLockTime); table.newRow();
+    table << "Sharded (fastest of " + std::to_string (workload.iterations) + ")" << toMs (shardedTime) << toRate (shardedTime); table.newRow();
+    table << "Speed-up" << choc::text::floatToString (singleLockTime / shardedTime, 2) + "x" << ""; table.newRow();
+
+    std::cout << table.toString ({}, "  ", "\n") << std::endl;
+}
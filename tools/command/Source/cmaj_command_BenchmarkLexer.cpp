@@ -0,0 +1,141 @@
+//
+//     ,ad888ba,                              88
+//    d8"'    "8b
+//   d8            88,dba,,adba,   ,aPP8A.A8  88     The Cmajor Toolkit
+//   Y8,           88    88    88  88     88  88
+//    Y8a.   .a8P  88    88    88  88,   ,88  88     (C)2024 Cmajor Software Ltd
+//     '"Y888Y"'   88    88    88  '"8bbP"Y8  88     https://cmajor.dev
+//                                           ,88
+//                                        888P"
+//
+//  The Cmajor project is subject to commercial or open-source licensing.
+//  You may use it under the terms of the GPLv3 (see www.gnu.org/licenses), or
+//  visit https://cmajor.dev to learn about our commercial licence options.
+//
+//  CMAJOR IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL WARRANTIES, WHETHER
+//  EXPRESSED OR IMPLIED, INCLUDING MERCHANTABILITY AND FITNESS FOR PURPOSE, ARE
+//  DISCLAIMED.
+
+#include "juce/cmaj_JUCEHeaders.h"
+
+#include "../../../modules/compiler/include/cmaj_ErrorHandling.h"
+#include "choc/text/choc_Files.h"
+#include "choc/text/choc_TextTable.h"
+#include "../../../modules/compiler/src/AST/cmaj_AST.h"
+#include "../../../modules/compiler/src/AST/cmaj_Lexer.h"
+
+//==============================================================================
+struct TokenCounter  : public cmaj::Lexer
+{
+    TokenCounter (cmaj::AST::Allocator& a) : allocator (a) {}
+
+    uint64_t countTokens (const cmaj::SourceFile& file)
+    {
+        uint64_t numTokens = 0;
+        setLexerInput (file.getCodeLocation());
+
+        while (! matches (cmaj::LexerToken::eof))
+        {
+            skip();
+            ++numTokens;
+        }
+
+        return numTokens;
+    }
+
+    cmaj::AST::ObjectContext getContext() const override  { return { allocator, location, nullptr }; }
+
+    cmaj::AST::Allocator& allocator;
+};
+
+static std::vector<std::filesystem::path> findCmajorFiles (juce::ArgumentList& args)
+{
+    std::vector<std::filesystem::path> files;
+
+    for (int i = 0; i < args.size(); ++i)
+    {
+        auto path = std::filesystem::path (args[i].resolveAsFile().getFullPathName().toStdString());
+
+        if (is_directory (path))
+        {
+            for (auto& f : std::filesystem::recursive_directory_iterator { path })
+                if (f.path().extension() == ".cmajor")
+                    files.push_back (f.path());
+        }
+        else if (exists (path))
+        {
+            files.push_back (path);
+        }
+    }
+
+    std::sort (files.begin(), files.end());
+    return files;
+}
+
+template <typename Fn>
+static double timeInSeconds (Fn&& fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+}
+
+//==============================================================================
+void benchmarkLexer (juce::ArgumentList& args)
+{
+    int iterations = 20;
+
+    if (args.containsOption ("--iterations"))
+        iterations = std::max (1, args.removeValueForOption ("--iterations").getIntValue());
+
+    auto files = findCmajorFiles (args);
+
+    if (files.empty())
+        throw std::runtime_error ("Expected some .cmajor files or folders to benchmark");
+
+    cmaj::AST::Allocator allocator;
+    uint64_t totalBytes = 0, totalTokens = 0;
+
+    auto loadTime = timeInSeconds ([&]
+    {
+        for (auto& f : files)
+        {
+            auto content = choc::file::loadFileAsString (f.string());
+            totalBytes += content.length();
+            allocator.sourceFileList.add (f.filename().string(), std::move (content), false);
+        }
+    });
+
+    TokenCounter lexer (allocator);
+    double fastestLexTime = 0;
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        uint64_t numTokens = 0;
+
+        auto lexTime = timeInSeconds ([&]
+        {
+            for (auto& f : allocator.sourceFileList.sourceFiles)
+                numTokens += lexer.countTokens (*f);
+        });
+
+        totalTokens = numTokens;
+
+        if (i == 0 || lexTime < fastestLexTime)
+            fastestLexTime = lexTime;
+    }
+
+    auto toMs = [] (double seconds)  { return choc::text::floatToString (seconds * 1000.0, 3) + " ms"; };
+    auto megabytes = static_cast<double> (totalBytes) / (1024.0 * 1024.0);
+
+    choc::text::TextTable table;
+    table << "Files" << std::to_string (files.size()); table.newRow();
+    table << "Bytes" << std::to_string (totalBytes); table.newRow();
+    table << "Tokens" << std::to_string (totalTokens); table.newRow();
+    table << "Load" << toMs (loadTime); table.newRow();
+    table << "Lex (fastest of " + std::to_string (iterations) + ")" << toMs (fastestLexTime); table.newRow();
+    table << "Lexer throughput" << choc::text::floatToString (megabytes / fastestLexTime, 1) + " MB/s"; table.newRow();
+    table << "Tokens per second" << std::to_string (static_cast<uint64_t> (static_cast<double> (totalTokens) / fastestLexTime)); table.newRow();
+
+    std::cout << table.toString ({}, "  ", "\n") << std::endl;
+}
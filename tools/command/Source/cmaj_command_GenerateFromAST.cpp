@@ -34,17 +34,19 @@ static void writeToOutput (const std::string& outputFile, std::string_view s)
 
 static void addSourceToProgram (cmaj::AST::Program& program, const std::set<std::filesystem::path>& files)
 {
+    std::vector<std::string> paths;
+    std::vector<cmaj::SourceFileToParse> filesToParse;
+
     for (auto& sourceFile : files)
-    {
-        auto sourceContent = choc::file::loadFileAsString (sourceFile.string());
+        paths.push_back (sourceFile.string());
 
-        auto errors = std::string (choc::com::StringPtr (program.parse (sourceFile.string().c_str(),
-                                                                        sourceContent.data(),
-                                                                        sourceContent.length())));
+    for (auto& path : paths)
+        filesToParse.push_back ({ path.c_str(), nullptr, 0, true });
 
-        if (! errors.empty())
-            throw std::runtime_error (errors);
-    }
+    auto errors = std::string (choc::com::StringPtr (program.parseFiles (filesToParse.data(), filesToParse.size())));
+
+    if (! errors.empty())
+        throw std::runtime_error (errors);
 
     cmaj::transformations::runBasicResolutionPasses (program);
 }
@@ -32,6 +32,8 @@
 #include "cmaj_command_OpenSourceLicenses.h"
 
 void runUnitTests (juce::ArgumentList&, const choc::value::Value&, cmaj::BuildSettings&);
+void benchmarkLexer (juce::ArgumentList&);
+void benchmarkCache (juce::ArgumentList&);
 
 void playFile (juce::ArgumentList&, const choc::value::Value& engineOptions,
                cmaj::BuildSettings&, const cmaj::audio_utils::AudioDeviceOptions&);
@@ -70,6 +72,11 @@ cmaj <command> [options]    Runs the given command. Options can include the foll
     -O0|1|2|3|4             Set the optimisation level to the given value
     --debug                 Turn on debug output from the performer
     --sessionID=n           Set the session id to the given value
+    --profile-compile       Add timings and resolution statistics for each compiler pass to the build log
+    --compile-trace=file    Write the timings for each compiler stage to a Chrome trace file
+    --compact-ast           Free the AST objects that are no longer used before generating code
+    --sparse-streams        Skip the work of stateless processors while their input streams are constant
+    --render-in-blocks      Run each node of the main graph over a whole block before moving on to the next
     --engine=<type>         Use the specified engine - e.g. llvm, webview, cpp
 
 Supported commands:
@@ -137,6 +144,19 @@ cmaj unit-test              Runs internal unit tests.
 
     --iterations=n          How many times to repeat the tests
 
+cmaj benchmark-lexer [opts] <files or folders>
+                            Measures how quickly the lexer can tokenise some .cmajor files
+
+    --iterations=n          How many times to repeat the measurement (default is 20)
+
+cmaj benchmark-cache [opts] Compares the file-based cache with its old single-lock version,
+                            with many threads storing and reloading items at once
+
+    --threads=n             How many simulated linkers to run at once (default is 16)
+    --items=n               How many items each linker stores (default is 8)
+    --itemSize=n            The size of each item in bytes (default is 262144)
+    --iterations=n          How many times to repeat the measurement (default is 5)
+
 )";
 
     std::cout << choc::text::replace (help, "CODE_GEN_TARGETS", getCodeGenTargetHelp())
@@ -161,6 +181,21 @@ static cmaj::BuildSettings parseBuildArgs (juce::ArgumentList& args)
     if (args.containsOption ("--sessionID"))
         buildSettings.setSessionID (args.removeValueForOption ("--sessionID").getIntValue());
 
+    if (args.removeOptionIfFound ("--profile-compile"))
+        buildSettings.setProfileCompilation (true);
+
+    if (args.containsOption ("--compile-trace"))
+        buildSettings.setCompileTraceFile (args.getFileForOptionAndRemove ("--compile-trace").getFullPathName().toStdString());
+
+    if (args.removeOptionIfFound ("--compact-ast"))
+        buildSettings.setCompactAST (true);
+
+    if (args.removeOptionIfFound ("--sparse-streams"))
+        buildSettings.setSparseStreams (true);
+
+    if (args.removeOptionIfFound ("--render-in-blocks"))
+        buildSettings.setRenderNodesInBlocks (true);
+
     return buildSettings;
 }
 
@@ -252,6 +287,8 @@ static void performCommandLineTask (juce::ArgumentList& args)
     if (isCommand (args, "test"))      return runTests (args, engine, buildSettings);
     if (isCommand (args, "create"))    return createPatch (args);
     if (isCommand (args, "unit-test")) return runUnitTests (args, engine, buildSettings);
+    if (isCommand (args, "benchmark-lexer")) return benchmarkLexer (args);
+    if (isCommand (args, "benchmark-cache")) return benchmarkCache (args);
 
     showHelp();
 }
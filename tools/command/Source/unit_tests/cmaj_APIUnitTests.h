@@ -18,7 +18,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include "cmajor/API/cmaj_Engine.h"
+#include "cmajor/helpers/cmaj_PerformerStateTransfer.h"
+#include "cmajor/helpers/cmaj_FileBasedCacheDatabase.h"
 
 namespace cmaj::api_tests
 {
@@ -65,6 +70,49 @@ namespace cmaj::api_tests
         )";
     }
 
+    /// A cache which keeps its items in memory, and records which keys were used.
+    struct MemoryCache  : public choc::com::ObjectWithAtomicRefCount<CacheDatabaseInterface, MemoryCache>
+    {
+        virtual ~MemoryCache() = default;
+
+        void store (const char* key, const void* data, uint64_t size) override
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            auto start = static_cast<const uint8_t*> (data);
+            items[key] = std::vector<uint8_t> (start, start + size);
+            storedKeys.push_back (key);
+        }
+
+        uint64_t reload (const char* key, void* dest, uint64_t destSize) override
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            auto found = items.find (key);
+
+            if (found == items.end())
+                return 0;
+
+            if (dest != nullptr && destSize >= found->second.size())
+            {
+                std::memcpy (dest, found->second.data(), found->second.size());
+                reloadedKeys.push_back (key);
+            }
+
+            return found->second.size();
+        }
+
+        /// Returns the number of keys in the list which contain the given string.
+        size_t countKeys (const std::vector<std::string>& keys, std::string_view substring)
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            return static_cast<size_t> (std::count_if (keys.begin(), keys.end(),
+                                                       [&] (const std::string& k) { return k.find (substring) != std::string::npos; }));
+        }
+
+        std::mutex mutex;
+        std::map<std::string, std::vector<uint8_t>> items;
+        std::vector<std::string> storedKeys, reloadedKeys;
+    };
+
     static void checkInvalidEngine (choc::test::TestProgress& progress)
     {
         CHOC_TEST (checkInvalidEngine);
@@ -397,6 +445,1173 @@ namespace cmaj::api_tests
         CHOC_EXPECT_EQ (output, "111111");
     }
 
+    static void checkPerformerStateTransfer (choc::test::TestProgress& progress)
+    {
+        CHOC_TEST (checkPerformerStateTransfer)
+
+        constexpr uint32_t numFrames = 16;
+
+        struct Build
+        {
+            cmaj::Engine engine = cmaj::Engine::create ({});
+            cmaj::Performer performer;
+            cmaj::EndpointHandle outHandle = {};
+        };
+
+        auto build = [&] (const std::string& source)
+        {
+            Build b;
+            cmaj::Program program;
+            cmaj::DiagnosticMessageList messages;
+
+            program.parse (messages, "", source);
+            CHOC_EXPECT_TRUE (messages.empty());
+            CHOC_EXPECT_TRUE (b.engine.load (messages, program, {}, {}));
+
+            b.outHandle = b.engine.getEndpointHandle ("out");
+
+            b.engine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0)
+                                                            .setMaxBlockSize (numFrames));
+
+            CHOC_EXPECT_TRUE (b.engine.link (messages, {}));
+            b.performer = b.engine.createPerformer();
+            CHOC_EXPECT_TRUE (b.performer);
+            return b;
+        };
+
+        auto render = [&] (Build& b)
+        {
+            std::vector<float> output (numFrames);
+            b.performer.setBlockSize (numFrames);
+            b.performer.advance();
+            b.performer.copyOutputFrames (b.outHandle, output.data(), numFrames);
+            return output;
+        };
+
+        auto original = build (R"(
+            processor Counter
+            {
+                output stream float32 out;
+                int32 count;
+
+                void main()
+                {
+                    loop
+                    {
+                        out <- float32 (count++);
+                        advance();
+                    }
+                }
+            }
+        )");
+
+        // The new version has an extra variable which moves the counter to a different place
+        auto edited = build (R"(
+            processor Counter
+            {
+                output stream float32 out;
+                float64 unusedVariable;
+                int32 count;
+
+                void main()
+                {
+                    loop
+                    {
+                        unusedVariable += 1.0;
+                        out <- 1000.0f + float32 (count++);
+                        advance();
+                    }
+                }
+            }
+        )");
+
+        for (int block = 0; block < 3; ++block)
+            render (original);
+
+        if (! original.performer.getStateMemory())
+            return; // the engine being tested can't provide its state
+
+        cmaj::PerformerStateTransfer transfer (original.performer, edited.performer);
+        CHOC_EXPECT_FALSE (transfer.isEmpty());
+        transfer.apply();
+
+        auto output = render (edited);
+
+        for (uint32_t i = 0; i < numFrames; ++i)
+            CHOC_EXPECT_NEAR (output[i], 1000.0f + static_cast<float> (3 * numFrames + i), 0.0001f);
+    }
+
+    static void checkPerformerStateTransferWithAdvanceLoop (choc::test::TestProgress& progress)
+    {
+        CHOC_TEST (checkPerformerStateTransferWithAdvanceLoop)
+
+        constexpr uint32_t numFrames = 16;
+
+        auto build = [&] (const std::string& source)
+        {
+            auto engine = cmaj::Engine::create ({});
+            cmaj::Program program;
+            cmaj::DiagnosticMessageList messages;
+
+            program.parse (messages, "", source);
+            CHOC_EXPECT_TRUE (messages.empty());
+            CHOC_EXPECT_TRUE (engine.load (messages, program, {}, {}));
+
+            engine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0)
+                                                          .setMaxBlockSize (numFrames));
+
+            CHOC_EXPECT_TRUE (engine.link (messages, {}));
+            return engine;
+        };
+
+        auto render = [&] (cmaj::Engine& engine, cmaj::Performer& performer)
+        {
+            std::vector<float> output (numFrames);
+            performer.setBlockSize (numFrames);
+            performer.advance();
+            performer.copyOutputFrames (engine.getEndpointHandle ("out"), output.data(), numFrames);
+            return output;
+        };
+
+        // In both versions, i is a local that lives across an advance() call, so it gets
+        // moved into the state, along with the index of the advance() call to resume from
+        auto originalEngine = build (R"(
+            processor Counter
+            {
+                output stream float32 out;
+                int32 count;
+
+                void main()
+                {
+                    var i = 0;
+
+                    loop
+                    {
+                        out <- float32 (count++);
+                        advance();
+                        i += 7;
+                    }
+                }
+            }
+        )");
+
+        auto editedEngine = build (R"(
+            processor Counter
+            {
+                output stream float32 out;
+                int32 count;
+
+                void main()
+                {
+                    var i = 0;
+
+                    loop
+                    {
+                        out <- 1000.0f + float32 (count++) + float32 (i);
+                        advance();
+                        i = (i + 1) % 2;
+                    }
+                }
+            }
+        )");
+
+        auto original = originalEngine.createPerformer();
+        auto edited = editedEngine.createPerformer();
+        CHOC_EXPECT_TRUE (original && edited);
+
+        for (int block = 0; block < 3; ++block)
+            render (originalEngine, original);
+
+        if (! original.getStateMemory())
+            return; // the engine being tested can't provide its state
+
+        // Only the user's variables should be exposed, not the compiler-generated ones
+        for (auto member : edited.getStateLayout())
+            CHOC_EXPECT_FALSE (choc::text::startsWith (member["name"].toString(), "_"));
+
+        cmaj::PerformerStateTransfer transfer (original, edited);
+        CHOC_EXPECT_FALSE (transfer.isEmpty());
+        transfer.apply();
+
+        // The count carries on, but the edited code starts again from the top of main(),
+        // rather than resuming after an advance() with the original's value of i
+        auto output = render (editedEngine, edited);
+
+        for (uint32_t i = 0; i < numFrames; ++i)
+            CHOC_EXPECT_NEAR (output[i], 1000.0f + static_cast<float> (3 * numFrames + i + (i % 2)), 0.0001f);
+    }
+
+    static void checkInstanceLanes (choc::test::TestProgress& progress)
+    {
+        CHOC_TEST (checkInstanceLanes)
+
+        const auto source = R"(
+            processor Accumulator
+            {
+                input stream float32 in;
+                input event float32 gain;
+                output stream float32 out;
+                float32 sum, currentGain = 1.0f;
+
+                event gain (float32 g)
+                {
+                    currentGain = g;
+                }
+
+                void main()
+                {
+                    loop
+                    {
+                        sum += in * currentGain;
+                        out <- sum;
+                        advance();
+                    }
+                }
+            }
+        )";
+
+        constexpr uint32_t numLanes = 4, blockSize = 16, numBlocks = 3;
+
+        auto engine = cmaj::Engine::create ({});
+        cmaj::Program program;
+        cmaj::DiagnosticMessageList messages;
+
+        program.parse (messages, "", source);
+        CHOC_EXPECT_TRUE (messages.empty());
+
+        // The lanes are added when the program is loaded, so the setting is needed first
+        engine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0)
+                                                      .setMaxBlockSize (blockSize)
+                                                      .setNumInstanceLanes (numLanes));
+
+        CHOC_EXPECT_TRUE (engine.load (messages, program, {}, {}));
+
+        auto getLaneHandle = [&] (const char* name, uint32_t lane)
+        {
+            return engine.getEndpointHandle (cmaj::EndpointID::create (std::string (name)).getInstanceLaneID (lane));
+        };
+
+        std::vector<cmaj::EndpointHandle> inHandles, gainHandles, outHandles;
+
+        for (uint32_t lane = 0; lane < numLanes; ++lane)
+        {
+            inHandles.push_back (getLaneHandle ("in", lane));
+            gainHandles.push_back (getLaneHandle ("gain", lane));
+            outHandles.push_back (getLaneHandle ("out", lane));
+
+            CHOC_EXPECT_TRUE (inHandles.back() != 0 && gainHandles.back() != 0 && outHandles.back() != 0);
+        }
+
+        CHOC_EXPECT_TRUE (engine.getEndpointHandle ("out") == 0);
+        CHOC_EXPECT_TRUE (engine.link (messages, {}));
+
+        auto performer = engine.createPerformer();
+        CHOC_EXPECT_TRUE (performer);
+
+        // Each lane gets a different input and gain, and a different gain change part-way
+        // through, so that any state shared or mixed up between lanes shows in the output
+        auto getInput = [] (uint32_t lane, uint32_t frame)  { return static_cast<float> (lane + 1) + 0.01f * static_cast<float> (frame); };
+        auto getGain  = [] (uint32_t lane, uint32_t block)  { return block == 0 ? 1.0f : static_cast<float> (lane * 2 + block); };
+
+        std::vector<float> expectedSums (numLanes, 0.0f), input (blockSize), output (blockSize);
+
+        for (uint32_t block = 0; block < numBlocks; ++block)
+        {
+            performer.setBlockSize (blockSize);
+
+            for (uint32_t lane = 0; lane < numLanes; ++lane)
+            {
+                for (uint32_t i = 0; i < blockSize; ++i)
+                    input[i] = getInput (lane, block * blockSize + i);
+
+                performer.setInputFrames (inHandles[lane], input.data(), blockSize);
+
+                if (block != 0)
+                    performer.addInputEvent (gainHandles[lane], 0, choc::value::createFloat32 (getGain (lane, block)));
+            }
+
+            performer.advance();
+
+            for (uint32_t lane = 0; lane < numLanes; ++lane)
+            {
+                performer.copyOutputFrames (outHandles[lane], output.data(), blockSize);
+
+                for (uint32_t i = 0; i < blockSize; ++i)
+                {
+                    expectedSums[lane] += getInput (lane, block * blockSize + i) * getGain (lane, block);
+                    CHOC_EXPECT_NEAR (output[i], expectedSums[lane], 0.001f);
+                }
+            }
+        }
+    }
+
+    static void checkProcessBlockLargerThanMaximum (choc::test::TestProgress& progress)
+    {
+        CHOC_TEST (checkProcessBlockLargerThanMaximum)
+
+        const auto source = R"(
+            processor Counter
+            {
+                input stream float32 in;
+                output stream float32 out;
+                output event int32 tick;
+
+                void main()
+                {
+                    int32 frame;
+
+                    loop
+                    {
+                        out <- in + float32 (frame);
+
+                        if (frame == 40)
+                            tick <- frame;
+
+                        ++frame;
+                        advance();
+                    }
+                }
+            }
+        )";
+
+        auto engine = cmaj::Engine::create ({});
+
+        cmaj::Program program;
+        cmaj::DiagnosticMessageList messages;
+
+        program.parse (messages, "", source);
+        CHOC_EXPECT_TRUE (messages.empty());
+        CHOC_EXPECT_TRUE (engine.load (messages, program, {}, {}));
+
+        auto inHandle = engine.getEndpointHandle ("in");
+        auto outHandle = engine.getEndpointHandle ("out");
+        auto tickHandle = engine.getEndpointHandle ("tick");
+
+        engine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0).setMaxBlockSize (16));
+        CHOC_EXPECT_TRUE (engine.link (messages, {}));
+
+        auto performer = engine.createPerformer();
+        CHOC_EXPECT_TRUE (performer);
+
+        constexpr uint32_t numFrames = 50;
+        std::vector<float> input (numFrames, 1.0f), output (numFrames);
+        std::vector<std::pair<uint32_t, int32_t>> events;
+
+        cmaj::Performer::BlockIO io;
+        io.inputStreams.push_back ({ inHandle, input.data() });
+        io.outputStreams.push_back ({ outHandle, output.data() });
+        io.outputEvents.push_back ({ tickHandle, std::addressof (events),
+                                     [] (void* context, cmaj::EndpointHandle, uint32_t, uint32_t frame, const void* data, uint32_t) -> bool
+                                     {
+                                         static_cast<std::vector<std::pair<uint32_t, int32_t>>*> (context)->push_back ({ frame, *static_cast<const int32_t*> (data) });
+                                         return true;
+                                     } });
+
+        // The block is more than three times the maximum size, so it has to be split up
+        performer.processBlock (io, numFrames);
+
+        for (uint32_t i = 0; i < numFrames; ++i)
+            CHOC_EXPECT_NEAR (output[i], static_cast<float> (i + 1), 0.0001f);
+
+        CHOC_EXPECT_EQ (events.size(), 1u);
+
+        if (events.size() == 1)
+        {
+            CHOC_EXPECT_EQ (events.front().first, 40u);
+            CHOC_EXPECT_EQ (events.front().second, 40);
+        }
+    }
+
+    static void checkTieredCompilation (choc::test::TestProgress& progress)
+    {
+        CHOC_TEST (checkTieredCompilation)
+
+        auto engine = cmaj::Engine::create ({});
+
+        cmaj::Program program;
+        cmaj::DiagnosticMessageList messages;
+
+        const auto source = R"(
+            processor Ramp
+            {
+                output stream float32 out;
+                float32 level;
+
+                void main()
+                {
+                    loop
+                    {
+                        out <- level;
+                        level += 1.0f;
+                        advance();
+                    }
+                }
+            }
+        )";
+
+        program.parse (messages, "", source);
+        CHOC_EXPECT_TRUE (messages.empty());
+        CHOC_EXPECT_TRUE (engine.load (messages, program, {}, {}));
+
+        auto outHandle = engine.getEndpointHandle ("out");
+
+        engine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0)
+                                                      .setMaxBlockSize (32)
+                                                      .setOptimisationLevel (3)
+                                                      .setTieredCompilation (true));
+
+        CHOC_EXPECT_TRUE (engine.link (messages, {}));
+
+        auto performer = engine.createPerformer();
+        CHOC_EXPECT_TRUE (performer);
+
+        std::vector<float> output (32);
+        float expected = 0;
+
+        // The output must carry on seamlessly when the optimised code takes over
+        for (int block = 0; block < 200; ++block)
+        {
+            performer.setBlockSize (32);
+            performer.advance();
+            performer.copyOutputFrames (outHandle, output.data(), 32);
+
+            for (auto sample : output)
+                CHOC_EXPECT_NEAR (sample, expected++, 0.0001f);
+
+            if (block > 100 && engine.getLastBuildLog().find ("in progress") != std::string::npos)
+                std::this_thread::sleep_for (std::chrono::milliseconds (10));
+        }
+
+        CHOC_EXPECT_TRUE (engine.getLastBuildLog().find ("Tiered compilation") != std::string::npos);
+
+        // Deleting an engine whose re-compile is still running mustn't wait for it, and the
+        // detached thread must be able to finish safely after the code has gone
+        for (int i = 0; i < 4; ++i)
+        {
+            auto shortLivedEngine = cmaj::Engine::create ({});
+            cmaj::Program shortLivedProgram;
+
+            shortLivedProgram.parse (messages, "", source);
+            CHOC_EXPECT_TRUE (shortLivedEngine.load (messages, shortLivedProgram, {}, {}));
+
+            shortLivedEngine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0)
+                                                                    .setMaxBlockSize (32)
+                                                                    .setOptimisationLevel (2)
+                                                                    .setTieredCompilation (true));
+
+            CHOC_EXPECT_TRUE (shortLivedEngine.link (messages, {}));
+            CHOC_EXPECT_TRUE (shortLivedEngine.createPerformer());
+        }
+    }
+
+    static void checkProfileGuidedOptimisation (choc::test::TestProgress& progress)
+    {
+        CHOC_TEST (checkProfileGuidedOptimisation)
+
+        const auto source = R"(
+            processor Counter
+            {
+                output stream float32 out;
+                int32 n;
+
+                void main()
+                {
+                    loop
+                    {
+                        if ((n & 15) == 0)
+                            out <- -1.0f;
+                        else
+                            out <- float32 (n);
+
+                        ++n;
+                        advance();
+                    }
+                }
+            }
+        )";
+
+        auto cache = choc::com::create<MemoryCache>();
+
+        auto render = [&] (const char* expectedLogMessage)
+        {
+            auto engine = cmaj::Engine::create ({});
+
+            cmaj::Program program;
+            cmaj::DiagnosticMessageList messages;
+
+            program.parse (messages, "", source);
+            CHOC_EXPECT_TRUE (messages.empty());
+            CHOC_EXPECT_TRUE (engine.load (messages, program, {}, {}, cache.get()));
+
+            auto outHandle = engine.getEndpointHandle ("out");
+
+            engine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0)
+                                                          .setMaxBlockSize (32)
+                                                          .setOptimisationLevel (3)
+                                                          .setProfileWarmUpFrames (1024));
+
+            CHOC_EXPECT_TRUE (engine.link (messages, cache.get()));
+
+            auto performer = engine.createPerformer();
+            CHOC_EXPECT_TRUE (performer);
+
+            std::vector<float> output (32);
+            int32_t n = 0;
+
+            // The output must carry on seamlessly when the profiled code takes over
+            for (int block = 0; block < 200; ++block)
+            {
+                performer.setBlockSize (32);
+                performer.advance();
+                performer.copyOutputFrames (outHandle, output.data(), 32);
+
+                for (auto sample : output)
+                {
+                    CHOC_EXPECT_NEAR (sample, (n & 15) == 0 ? -1.0f : static_cast<float> (n), 0.0001f);
+                    ++n;
+                }
+
+                if (block > 100 && engine.getLastBuildLog().find ("waiting") != std::string::npos)
+                    std::this_thread::sleep_for (std::chrono::milliseconds (10));
+            }
+
+            CHOC_EXPECT_TRUE (engine.getLastBuildLog().find (expectedLogMessage) != std::string::npos);
+        };
+
+        // The first run records a profile, and stores it in the cache along with the code that
+        // was re-compiled with it, which the second run should then load
+        render ("profiled re-compile");
+
+        std::string profileKey;
+
+        for (auto& item : cache->items)
+            if (choc::text::endsWith (item.first, "_profile"))
+                profileKey = item.first;
+
+        CHOC_EXPECT_FALSE (profileKey.empty());
+        CHOC_EXPECT_TRUE (cache->items.find (profileKey.substr (0, profileKey.length() - 8)) != cache->items.end());
+
+        render ("using a stored profile");
+    }
+
+    static void checkObjectCodeCache (choc::test::TestProgress& progress)
+    {
+        CHOC_TEST (checkObjectCodeCache)
+
+        const auto source = R"(
+            processor Oscillator
+            {
+                output stream float32 out;
+                input event float32 frequency;
+                float32 phase, increment = 0.01f;
+
+                event frequency (float32 f)
+                {
+                    increment = f / float32 (processor.frequency);
+                }
+
+                void main()
+                {
+                    loop
+                    {
+                        out <- sin (phase * float32 (twoPi));
+                        phase = fmod (phase + increment, 1.0f);
+                        advance();
+                    }
+                }
+            }
+        )";
+
+        auto cache = choc::com::create<MemoryCache>();
+
+        auto render = [&] (bool profileCompilation)
+        {
+            auto engine = cmaj::Engine::create ({});
+
+            cmaj::Program program;
+            cmaj::DiagnosticMessageList messages;
+
+            program.parse (messages, "", source);
+            CHOC_EXPECT_TRUE (messages.empty());
+            CHOC_EXPECT_TRUE (engine.load (messages, program, {}, {}, cache.get()));
+
+            auto outHandle = engine.getEndpointHandle ("out");
+            auto frequencyHandle = engine.getEndpointHandle ("frequency");
+
+            engine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0)
+                                                          .setMaxBlockSize (64)
+                                                          .setCacheObjectCode (true)
+                                                          .setProfileCompilation (profileCompilation));
+
+            CHOC_EXPECT_TRUE (engine.link (messages, cache.get()));
+
+            auto performer = engine.createPerformer();
+            CHOC_EXPECT_TRUE (performer);
+
+            std::vector<float> output, block (64);
+
+            for (int i = 0; i < 20; ++i)
+            {
+                if (i == 10)
+                    performer.addInputEvent (frequencyHandle, 0, choc::value::createFloat32 (1000.0f));
+
+                performer.setBlockSize (64);
+                performer.advance();
+                performer.copyOutputFrames (outHandle, block.data(), 64);
+                output.insert (output.end(), block.begin(), block.end());
+            }
+
+            return output;
+        };
+
+        // The engine and performer from each run are deleted before the next one, so that
+        // the second link can't just share the first one's code
+        auto firstOutput = render (false);
+        CHOC_EXPECT_EQ (cache->countKeys (cache->storedKeys, "_obj_"), 1u);
+        CHOC_EXPECT_EQ (cache->countKeys (cache->reloadedKeys, "_obj_"), 0u);
+
+        auto secondOutput = render (false);
+        CHOC_EXPECT_EQ (cache->countKeys (cache->storedKeys, "_obj_"), 1u);
+        CHOC_EXPECT_EQ (cache->countKeys (cache->reloadedKeys, "_obj_"), 1u);
+
+        // Settings which only affect diagnostics shouldn't stop the code being reused
+        auto profiledOutput = render (true);
+        CHOC_EXPECT_EQ (cache->countKeys (cache->storedKeys, "_obj_"), 1u);
+        CHOC_EXPECT_EQ (cache->countKeys (cache->reloadedKeys, "_obj_"), 2u);
+
+        CHOC_EXPECT_TRUE (firstOutput == secondOutput);
+        CHOC_EXPECT_TRUE (firstOutput == profiledOutput);
+    }
+
+    static void checkSharedLinkedCode (choc::test::TestProgress& progress)
+    {
+        CHOC_TEST (checkSharedLinkedCode)
+
+        // The event type contains a bool, so its data needs re-packing before it's sent
+        const auto source = R"(
+            struct Adjustment
+            {
+                float32 amount;
+                bool enabled;
+            }
+
+            processor Scaler
+            {
+                output stream float32 out;
+                input event Adjustment adjust;
+                external float32 scale;
+                float32 level, offset;
+
+                event adjust (Adjustment a)
+                {
+                    if (a.enabled)
+                        offset += a.amount;
+                }
+
+                void main()
+                {
+                    loop
+                    {
+                        out <- level * scale + offset;
+                        level += 1.0f;
+                        advance();
+                    }
+                }
+            }
+        )";
+
+        struct LinkedEngine
+        {
+            cmaj::Engine engine;
+            cmaj::Performer performer;
+            cmaj::EndpointHandle outHandle = {}, adjustHandle = {};
+        };
+
+        auto createEngine = [&] (float scale)
+        {
+            LinkedEngine e { cmaj::Engine::create ({}), {} };
+
+            cmaj::Program program;
+            cmaj::DiagnosticMessageList messages;
+
+            program.parse (messages, "", source);
+            CHOC_EXPECT_TRUE (messages.empty());
+
+            CHOC_EXPECT_TRUE (e.engine.load (messages, program,
+                                             [=] (const cmaj::ExternalVariable&) { return choc::value::createFloat32 (scale); },
+                                             {}));
+
+            e.outHandle = e.engine.getEndpointHandle ("out");
+            e.adjustHandle = e.engine.getEndpointHandle ("adjust");
+            e.engine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0).setMaxBlockSize (32));
+            CHOC_EXPECT_TRUE (e.engine.link (messages, {}));
+
+            e.performer = e.engine.createPerformer();
+            CHOC_EXPECT_TRUE (e.performer);
+            return e;
+        };
+
+        auto checkOutput = [&] (LinkedEngine& e, float scale, int numBlocks, float offset = 0)
+        {
+            std::vector<float> output (32);
+            float level = 0;
+
+            for (int block = 0; block < numBlocks; ++block)
+            {
+                e.performer.setBlockSize (32);
+                e.performer.advance();
+                e.performer.copyOutputFrames (e.outHandle, output.data(), 32);
+
+                for (auto sample : output)
+                    CHOC_EXPECT_NEAR (sample, scale * level++ + offset, 0.0001f);
+            }
+        };
+
+        // Engines with identical programs may share their code, but each performer must
+        // have its own state, and a different external value must not get shared code
+        auto e1 = createEngine (2.0f);
+        auto e2 = createEngine (2.0f);
+        auto e3 = createEngine (3.0f);
+
+        checkOutput (e1, 2.0f, 3);
+        checkOutput (e2, 2.0f, 5);
+        checkOutput (e3, 3.0f, 4);
+
+        // Deleting an engine mustn't affect the code that's still in use by the others,
+        // including the layouts used to send events of a non-primitive type
+        e1 = {};
+        auto e4 = createEngine (2.0f);
+
+        e4.performer.addInputEvent (e4.adjustHandle, 0, choc::value::createObject ("Adjustment",
+                                                                                   "amount", 0.5f,
+                                                                                   "enabled", true));
+        e4.performer.addInputEvent (e4.adjustHandle, 0, choc::value::createObject ("Adjustment",
+                                                                                   "amount", 100.0f,
+                                                                                   "enabled", false));
+        checkOutput (e4, 2.0f, 2, 0.5f);
+    }
+
+    static void checkResolvedProgramCache (choc::test::TestProgress& progress)
+    {
+        CHOC_TEST (checkResolvedProgramCache)
+
+        const auto source = R"(
+            processor Ramp
+            {
+                output stream float32 out;
+                float32 level;
+
+                void main()
+                {
+                    loop
+                    {
+                        out <- level;
+                        level += 1.0f;
+                        advance();
+                    }
+                }
+            }
+        )";
+
+        auto cache = choc::com::create<MemoryCache>();
+
+        auto render = [&]
+        {
+            auto engine = cmaj::Engine::create ({});
+
+            cmaj::Program program;
+            cmaj::DiagnosticMessageList messages;
+
+            program.parse (messages, "", source);
+            CHOC_EXPECT_TRUE (messages.empty());
+            CHOC_EXPECT_TRUE (engine.load (messages, program, {}, {}, cache.get()));
+
+            auto outHandle = engine.getEndpointHandle ("out");
+            engine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0).setMaxBlockSize (32));
+            CHOC_EXPECT_TRUE (engine.link (messages, {}));
+
+            auto performer = engine.createPerformer();
+            CHOC_EXPECT_TRUE (performer);
+
+            std::vector<float> output (32);
+            performer.setBlockSize (32);
+            performer.advance();
+            performer.copyOutputFrames (outHandle, output.data(), 32);
+            return output;
+        };
+
+        auto cold = render();
+        CHOC_EXPECT_EQ (cache->countKeys (cache->storedKeys, "resolved_"), 1u);
+        CHOC_EXPECT_EQ (cache->countKeys (cache->reloadedKeys, "resolved_"), 0u);
+
+        auto warm = render();
+        CHOC_EXPECT_EQ (cache->countKeys (cache->reloadedKeys, "resolved_"), 1u);
+        CHOC_EXPECT_TRUE (cold == warm);
+        CHOC_EXPECT_NEAR (warm[31], 31.0f, 0.0001f);
+    }
+
+    static void checkFileBasedCacheDatabase (choc::test::TestProgress& progress)
+    {
+        CHOC_TEST (checkFileBasedCacheDatabase)
+
+        auto folder = std::filesystem::temp_directory_path() / ("cmajor_cache_test_" + std::to_string (std::random_device()()));
+        std::filesystem::create_directories (folder);
+
+        auto createItem = [] (int linker, int item)
+        {
+            return std::vector<uint8_t> (static_cast<size_t> (1000 + item * 100), static_cast<uint8_t> (linker * 16 + item));
+        };
+
+        auto getKey = [] (int linker, int item)  { return "item_" + std::to_string (linker) + "_" + std::to_string (item); };
+
+        constexpr int numLinkers = 16, numItems = 8;
+
+        {
+            auto cache = choc::com::create<FileBasedCacheDatabase> (folder, FileBasedCacheDatabase::Limits());
+            std::vector<std::thread> linkers;
+            std::atomic<int> numFailures { 0 };
+
+            // Each thread behaves like an engine linking: it looks for its items, stores them, and then
+            // reloads them along with the ones stored by other threads
+            for (int linker = 0; linker < numLinkers; ++linker)
+            {
+                linkers.emplace_back ([&, linker]
+                {
+                    for (int item = 0; item < numItems; ++item)
+                    {
+                        auto data = createItem (linker, item);
+                        auto key = getKey (linker, item);
+
+                        if (cache->reload (key.c_str(), nullptr, 0) != 0)
+                            ++numFailures;
+
+                        cache->store (key.c_str(), data.data(), data.size());
+                    }
+
+                    for (int other = 0; other < numLinkers; ++other)
+                    {
+                        for (int item = 0; item < numItems; ++item)
+                        {
+                            auto key = getKey (other, item);
+
+                            if (auto size = cache->reload (key.c_str(), nullptr, 0))
+                            {
+                                std::vector<uint8_t> loaded (static_cast<size_t> (size));
+
+                                if (cache->reload (key.c_str(), loaded.data(), size) != size || loaded != createItem (other, item))
+                                    ++numFailures;
+                            }
+                        }
+                    }
+                });
+            }
+
+            for (auto& t : linkers)
+                t.join();
+
+            CHOC_EXPECT_EQ (numFailures.load(), 0);
+        }
+
+        {
+            // A new instance should pick up the same items from the saved index
+            auto cache = choc::com::create<FileBasedCacheDatabase> (folder, FileBasedCacheDatabase::Limits());
+
+            auto data = createItem (3, 5);
+            std::vector<uint8_t> loaded (data.size());
+            CHOC_EXPECT_EQ (cache->reload (getKey (3, 5).c_str(), loaded.data(), loaded.size()), data.size());
+            CHOC_EXPECT_TRUE (loaded == data);
+        }
+
+        {
+            // The older constructor only limits the number of files, which are purged in the background
+            constexpr size_t maxNumFiles = 10;
+            auto cache = choc::com::create<FileBasedCacheDatabase> (folder, maxNumFiles);
+
+            // This looks at the files rather than calling reload(), which would change the order
+            // that the purge thread is working through
+            auto countItems = [&]
+            {
+                size_t count = 0;
+
+                for (auto& f : std::filesystem::directory_iterator { folder })
+                    if (choc::text::startsWith (f.path().filename().string(), "cmajor_cache_"))
+                        ++count;
+
+                return count;
+            };
+
+            for (int i = 0; i < 200 && countItems() > maxNumFiles; ++i)
+                std::this_thread::sleep_for (std::chrono::milliseconds (10));
+
+            CHOC_EXPECT_EQ (countItems(), maxNumFiles);
+        }
+
+        std::filesystem::remove_all (folder);
+    }
+
+    static void checkParallelParsing (choc::test::TestProgress& progress)
+    {
+        CHOC_TEST (checkParallelParsing)
+
+        std::vector<std::pair<std::string, std::string>> files;
+
+        // Each function uses a labelled break, whose target is only referred to rather than
+        // owned by the AST, to check that these get copied out of the allocator that
+        // parsed each file before it's deleted
+        for (int i = 0; i < 8; ++i)
+            files.push_back ({ "file" + std::to_string (i) + ".cmajor",
+                               "namespace shared { float32 get" + std::to_string (i) + "() { var r = 0.0f; "
+                                 "outer: loop (2) { r = " + std::to_string (i) + ".0f; break outer; } return r; } }" });
+
+        files.push_back ({ "main.cmajor", R"(
+            processor Sum
+            {
+                output stream float32 out;
+
+                void main()
+                {
+                    loop
+                    {
+                        out <- shared::get0() + shared::get1() + shared::get2() + shared::get3()
+                                + shared::get4() + shared::get5() + shared::get6() + shared::get7();
+                        advance();
+                    }
+                }
+            }
+        )" });
+
+        {
+            cmaj::Program program;
+            cmaj::DiagnosticMessageList messages;
+
+            CHOC_EXPECT_TRUE (program.parse (messages, files));
+            CHOC_EXPECT_TRUE (messages.empty());
+
+            auto engine = cmaj::Engine::create ({});
+            CHOC_EXPECT_TRUE (engine.load (messages, program, {}, {}));
+
+            auto outHandle = engine.getEndpointHandle ("out");
+            engine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0).setMaxBlockSize (4));
+            CHOC_EXPECT_TRUE (engine.link (messages, {}));
+
+            auto performer = engine.createPerformer();
+            CHOC_EXPECT_TRUE (performer);
+
+            std::vector<float> output (4);
+            performer.setBlockSize (4);
+            performer.advance();
+            performer.copyOutputFrames (outHandle, output.data(), 4);
+            CHOC_EXPECT_NEAR (output[3], 28.0f, 0.0001f);
+        }
+
+        {
+            files[5].second = "namespace shared { float32 get5() { return 5.0f } }";
+
+            cmaj::Program program;
+            cmaj::DiagnosticMessageList messages;
+
+            CHOC_EXPECT_FALSE (program.parse (messages, files));
+            CHOC_EXPECT_TRUE (messages.hasErrors());
+            CHOC_EXPECT_TRUE (choc::text::contains (messages.toString(), "file5.cmajor"));
+        }
+    }
+
+    static void checkSourceFilesFromDisk (choc::test::TestProgress& progress)
+    {
+        CHOC_TEST (checkSourceFilesFromDisk)
+
+        auto folder = std::filesystem::temp_directory_path() / ("cmajor_source_test_" + std::to_string (std::random_device()()));
+        std::filesystem::create_directories (folder);
+
+        auto constants = std::string ("namespace constants { let value = 2.5e1; }\n");
+
+        auto constantsFile = (folder / "constants.cmajor").string();
+        auto processorFile = (folder / "processor.cmajor").string();
+
+        choc::file::replaceFileWithContent (constantsFile, constants);
+        choc::file::replaceFileWithContent (processorFile, R"(
+            processor Constant
+            {
+                output stream float64 out;
+
+                void main()
+                {
+                    loop
+                    {
+                        out <- constants::value;
+                        advance();
+                    }
+                }
+            }
+        )");
+
+        {
+            cmaj::Program program;
+            cmaj::DiagnosticMessageList messages;
+
+            CHOC_EXPECT_TRUE (program.parseFiles (messages, { constantsFile, processorFile }));
+            CHOC_EXPECT_TRUE (messages.empty());
+
+            // Once parsed, the program mustn't depend on the files, so truncating or
+            // rewriting them shouldn't affect it
+            choc::file::replaceFileWithContent (processorFile, {});
+            choc::file::replaceFileWithContent (constantsFile, "namespace constants { let value = 1.0; }");
+
+            auto engine = cmaj::Engine::create ({});
+            CHOC_EXPECT_TRUE (engine.load (messages, program, {}, {}));
+
+            auto outHandle = engine.getEndpointHandle ("out");
+            engine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0).setMaxBlockSize (4));
+            CHOC_EXPECT_TRUE (engine.link (messages, {}));
+
+            auto performer = engine.createPerformer();
+            CHOC_EXPECT_TRUE (performer);
+
+            std::vector<double> output (4);
+            performer.setBlockSize (4);
+            performer.advance();
+            performer.copyOutputFrames (outHandle, output.data(), 4);
+            CHOC_EXPECT_NEAR (output[3], 25.0, 0.0001);
+        }
+
+        {
+            cmaj::Program program;
+            cmaj::DiagnosticMessageList messages;
+
+            CHOC_EXPECT_FALSE (program.parseFiles (messages, { (folder / "missing.cmajor").string() }));
+            CHOC_EXPECT_TRUE (messages.hasErrors());
+        }
+
+        std::filesystem::remove_all (folder);
+    }
+
+    static void checkCompileProfile (choc::test::TestProgress& progress)
+    {
+        CHOC_TEST (checkCompileProfile)
+
+        auto traceFile = std::filesystem::temp_directory_path() / ("cmajor_trace_test_" + std::to_string (std::random_device()()) + ".json");
+
+        auto engine = cmaj::Engine::create ({});
+
+        cmaj::Program program;
+        cmaj::DiagnosticMessageList messages;
+
+        program.parse (messages, "", R"(
+            graph G
+            {
+                input stream float32 in;
+                output stream float32 out;
+                node gain = std::levels::ConstantGain (float32, 0.5f);
+                connection in -> gain -> out;
+            }
+        )");
+
+        CHOC_EXPECT_TRUE (messages.empty());
+
+        engine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0)
+                                                      .setMaxBlockSize (32)
+                                                      .setProfileCompilation (true)
+                                                      .setCompileTraceFile (traceFile.string()));
+
+        CHOC_EXPECT_TRUE (engine.load (messages, program, {}, {}));
+        CHOC_EXPECT_TRUE (engine.link (messages, {}));
+
+        auto log = engine.getLastBuildLog();
+
+        for (auto stage : { "Compile profile", "Resolution:", "TypeResolver", "convertComplexTypes", "inlineAllCallsWhichAdvance", "flattenGraph" })
+            CHOC_EXPECT_TRUE (choc::text::contains (log, stage));
+
+        {
+            // Without the setting, the log shouldn't include the profile or the resolution statistics
+            auto plainEngine = cmaj::Engine::create ({});
+            plainEngine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0).setMaxBlockSize (32));
+            CHOC_EXPECT_TRUE (plainEngine.load (messages, program, {}, {}));
+            CHOC_EXPECT_TRUE (plainEngine.link (messages, {}));
+
+            auto plainLog = plainEngine.getLastBuildLog();
+            CHOC_EXPECT_FALSE (choc::text::contains (plainLog, "Compile profile"));
+            CHOC_EXPECT_FALSE (choc::text::contains (plainLog, "Resolution:"));
+        }
+
+        auto trace = choc::json::parse (choc::file::loadFileAsString (traceFile.string()));
+        auto events = trace["traceEvents"];
+        CHOC_EXPECT_TRUE (events.isArray() && events.size() != 0);
+
+        bool foundLinkStage = false;
+
+        for (uint32_t i = 0; i < events.size(); ++i)
+        {
+            CHOC_EXPECT_EQ (events[i]["ph"].getString(), "X");
+
+            if (events[i]["name"].getString() == "link")
+                foundLinkStage = true;
+        }
+
+        CHOC_EXPECT_TRUE (foundLinkStage);
+        std::filesystem::remove (traceFile);
+    }
+
+    static void checkASTCompaction (choc::test::TestProgress& progress)
+    {
+        CHOC_TEST (checkASTCompaction)
+
+        cmaj::Program program;
+        cmaj::DiagnosticMessageList messages;
+
+        program.parse (messages, "", R"(
+            graph G
+            {
+                input stream float32 in;
+                output stream float32 out;
+                node gain = std::levels::ConstantGain (float32, 0.5f);
+                connection in -> gain -> out;
+            }
+        )");
+
+        CHOC_EXPECT_TRUE (messages.empty());
+
+        auto render = [&] (bool compact)
+        {
+            auto engine = cmaj::Engine::create ({});
+
+            engine.setBuildSettings (cmaj::BuildSettings().setFrequency (44100.0)
+                                                          .setMaxBlockSize (16)
+                                                          .setProfileCompilation (true)
+                                                          .setCompactAST (compact));
+
+            CHOC_EXPECT_TRUE (engine.load (messages, program, {}, {}));
+
+            auto inHandle = engine.getEndpointHandle ("in");
+            auto outHandle = engine.getEndpointHandle ("out");
+
+            CHOC_EXPECT_TRUE (engine.link (messages, {}));
+
+            auto log = engine.getLastBuildLog();
+            CHOC_EXPECT_TRUE (choc::text::contains (log, "AST memory"));
+            CHOC_EXPECT_EQ (choc::text::contains (log, "AST compaction: kept"), compact);
+
+            auto performer = engine.createPerformer();
+            CHOC_EXPECT_TRUE (performer);
+
+            auto inputBlock = choc::buffer::createInterleavedBuffer (1, 16, [] (choc::buffer::ChannelCount, choc::buffer::FrameCount sample) { return float (sample); });
+            auto outputBlock = choc::buffer::InterleavedBuffer<float> (1, 16);
+
+            performer.setBlockSize (16);
+            performer.setInputFrames (inHandle, inputBlock.getView());
+            performer.advance();
+            performer.copyOutputFrames (outHandle, outputBlock);
+
+            for (uint32_t i = 0; i < 16; i++)
+                CHOC_EXPECT_NEAR (float (i) * 0.5f, outputBlock.getSample (0, i), 0.0001);
+        };
+
+        // The original program must still be loadable after a compacted copy has been
+        // made from it and deleted
+        render (true);
+        render (false);
+        render (true);
+    }
+
     static void runUnitTests (choc::test::TestProgress& progress)
     {
         CHOC_CATEGORY (Performer);
@@ -405,5 +1620,19 @@ namespace cmaj::api_tests
         checkInvalidEngine (progress);
         checkGraph (progress);
         checkOutputEventWithMultipleTypes (progress);
+        checkPerformerStateTransfer (progress);
+        checkPerformerStateTransferWithAdvanceLoop (progress);
+        checkInstanceLanes (progress);
+        checkProcessBlockLargerThanMaximum (progress);
+        checkTieredCompilation (progress);
+        checkProfileGuidedOptimisation (progress);
+        checkObjectCodeCache (progress);
+        checkSharedLinkedCode (progress);
+        checkResolvedProgramCache (progress);
+        checkFileBasedCacheDatabase (progress);
+        checkParallelParsing (progress);
+        checkSourceFilesFromDisk (progress);
+        checkCompileProfile (progress);
+        checkASTCompaction (progress);
     }
 }